@@ -0,0 +1,68 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/bip_buffer.hpp>
+#include <sanhok/concurrent_queue.hpp>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace sanhok;
+
+TEST_CASE("[BipBuffer]") {
+    constexpr size_t PACKETS = 100000;
+    constexpr size_t PACKET_SIZE = 128;
+    constexpr size_t RECEIVE_BUFFER_SIZE = 65536;
+
+    BENCHMARK("std::vector per packet; 1 consumer, 1 producer, 100000 packets") {
+        ConcurrentQueue<std::vector<uint8_t>> queue {};
+
+        std::thread consumer([&] {
+            for (size_t i = 0; i < PACKETS; ++i) {
+                const auto packet = queue.pop_wait();
+                REQUIRE(packet);
+            }
+        });
+
+        std::thread producer([&] {
+            for (size_t i = 0; i < PACKETS; ++i) {
+                std::vector<uint8_t> buffer(RECEIVE_BUFFER_SIZE);
+                memset(buffer.data(), 42, PACKET_SIZE);
+                queue.push(std::move(buffer));
+            }
+        });
+
+        consumer.join();
+        producer.join();
+        REQUIRE(queue.empty());
+    };
+
+    BENCHMARK("BipBuffer in place; 1 consumer, 1 producer, 100000 packets") {
+        BipBuffer<uint8_t> buffer {1 << 20};
+        ConcurrentQueue<size_t> queue {};
+
+        std::thread consumer([&] {
+            for (size_t i = 0; i < PACKETS; ++i) {
+                const auto size = queue.pop_wait();
+                REQUIRE(size);
+                REQUIRE(buffer.read().first(*size)[0] == 42);
+                buffer.release(*size);
+            }
+        });
+
+        std::thread producer([&] {
+            for (size_t i = 0; i < PACKETS; ++i) {
+                std::span<uint8_t> reserved {};
+                while ((reserved = buffer.reserve(RECEIVE_BUFFER_SIZE)).empty()) {}
+
+                memset(reserved.data(), 42, PACKET_SIZE);
+                buffer.commit(PACKET_SIZE);
+                queue.push(PACKET_SIZE);
+            }
+        });
+
+        consumer.join();
+        producer.join();
+        REQUIRE(buffer.empty());
+    };
+}
@@ -1,11 +1,129 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <span>
 
 namespace sanhok {
+/*
+ * A lock-free bipartite circular buffer for single producer and single consumer.
+ * The producer reserves a contiguous span, writes into it and commits the used part.
+ * The consumer reads the contiguous committed span and releases what it has consumed.
+ */
 template <typename T>
 class BipBuffer {
 public:
-    explicit BipBuffer(size_t size) {}
+    explicit BipBuffer(size_t size);
+    ~BipBuffer() = default;
+    BipBuffer(const BipBuffer&) = delete;
+    BipBuffer& operator=(const BipBuffer&) = delete;
+
+    // Producer side
+    std::span<T> reserve(size_t size);
+    void commit(size_t size);
+
+    // Consumer side
+    std::span<T> read();
+    void release(size_t size);
+
+    // Drops whatever is committed; neither side may be using the buffer meanwhile
+    void reset();
+
+    size_t capacity() const { return capacity_; }
+    bool empty() const;
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<T[]> buffer_;
+
+    alignas(64) std::atomic<size_t> write_ {0};
+    std::atomic<size_t> last_ {0};
+    size_t reserve_start_ {0};
+    size_t reserve_size_ {0};
+
+    alignas(64) std::atomic<size_t> read_ {0};
 };
+
+template <typename T>
+BipBuffer<T>::BipBuffer(const size_t size)
+    : capacity_(size), buffer_(std::make_unique_for_overwrite<T[]>(size)) {}
+
+template <typename T>
+std::span<T> BipBuffer<T>::reserve(const size_t size) {
+    const size_t write = write_.load(std::memory_order_relaxed);
+    const size_t read = read_.load(std::memory_order_acquire);
+
+    size_t start;
+    if (write < read) {
+        // Already wrapped around; keep one element between write and read so that write == read means empty
+        if (write + size >= read) return {};
+        start = write;
+    } else if (write + size <= capacity_) {
+        start = write;
+    } else {
+        // Wrap around to the beginning, leaving the tail of the buffer unused
+        if (size >= read) return {};
+        start = 0;
+    }
+
+    reserve_start_ = start;
+    reserve_size_ = size;
+    return {buffer_.get() + start, size};
+}
+
+template <typename T>
+void BipBuffer<T>::commit(const size_t size) {
+    const size_t used = std::min(size, reserve_size_);
+    const size_t write = write_.load(std::memory_order_relaxed);
+    const size_t new_write = reserve_start_ + used;
+
+    if (new_write < write && write != capacity_) {
+        // Wrapped around; mark where the readable data of the tail ends
+        last_.store(write, std::memory_order_release);
+    } else if (new_write > last_.load(std::memory_order_relaxed)) {
+        last_.store(capacity_, std::memory_order_release);
+    }
+
+    reserve_size_ = 0;
+    write_.store(new_write, std::memory_order_release);
+}
+
+template <typename T>
+std::span<T> BipBuffer<T>::read() {
+    const size_t write = write_.load(std::memory_order_acquire);
+    const size_t last = last_.load(std::memory_order_acquire);
+    size_t read = read_.load(std::memory_order_relaxed);
+
+    if (read == last && write < read) {
+        read = 0;
+        read_.store(0, std::memory_order_release);
+    }
+
+    const size_t end = write < read ? last : write;
+    return {buffer_.get() + read, end - read};
+}
+
+template <typename T>
+void BipBuffer<T>::release(const size_t size) {
+    read_.fetch_add(size, std::memory_order_release);
+}
+
+template <typename T>
+void BipBuffer<T>::reset() {
+    reserve_start_ = 0;
+    reserve_size_ = 0;
+    last_.store(0, std::memory_order_relaxed);
+    read_.store(0, std::memory_order_relaxed);
+    write_.store(0, std::memory_order_release);
+}
+
+template <typename T>
+bool BipBuffer<T>::empty() const {
+    const size_t write = write_.load(std::memory_order_acquire);
+    const size_t read = read_.load(std::memory_order_acquire);
+
+    if (write < read) return write == 0 && read == last_.load(std::memory_order_acquire);
+    return read == write;
+}
 }
@@ -0,0 +1,140 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/bip_buffer.hpp>
+
+#include <cstring>
+#include <thread>
+
+using namespace sanhok;
+
+TEST_CASE("read returns committed elements", "[BipBuffer]")
+{
+    BipBuffer<int> buffer {16};
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.read().empty());
+
+    auto reserved = buffer.reserve(8);
+    REQUIRE(reserved.size() == 8);
+    for (int i = 0; i < 5; ++i) reserved[i] = i;
+    buffer.commit(5);
+
+    const auto readable = buffer.read();
+    REQUIRE(readable.size() == 5);
+    for (int i = 0; i < 5; ++i) REQUIRE(readable[i] == i);
+
+    buffer.release(5);
+    REQUIRE(buffer.empty());
+}
+
+TEST_CASE("reserve fails when there is no contiguous space", "[BipBuffer]")
+{
+    BipBuffer<int> buffer {16};
+
+    REQUIRE(buffer.reserve(17).empty());
+
+    REQUIRE(buffer.reserve(12).size() == 12);
+    buffer.commit(12);
+
+    // 4 left at the tail and nothing released at the head
+    REQUIRE(buffer.reserve(8).empty());
+    REQUIRE(buffer.reserve(4).size() == 4);
+}
+
+TEST_CASE("reserve wraps around to the released head", "[BipBuffer]")
+{
+    BipBuffer<int> buffer {16};
+
+    auto first = buffer.reserve(12);
+    first[0] = 1;
+    buffer.commit(12);
+    buffer.release(buffer.read().size());
+
+    auto second = buffer.reserve(8);
+    REQUIRE(second.size() == 8);
+    REQUIRE(second.data() == first.data());
+    second[0] = 2;
+    buffer.commit(3);
+
+    const auto readable = buffer.read();
+    REQUIRE(readable.size() == 3);
+    REQUIRE(readable[0] == 2);
+    buffer.release(3);
+    REQUIRE(buffer.empty());
+}
+
+TEST_CASE("Consumer sees the tail before the wrapped head", "[BipBuffer]")
+{
+    BipBuffer<int> buffer {16};
+
+    buffer.reserve(12);
+    buffer.commit(12);
+    buffer.release(8);
+
+    // Wraps since 12 + 6 > 16; the tail [8, 12) is still unread
+    REQUIRE(buffer.reserve(8).empty());
+    REQUIRE(buffer.reserve(6).size() == 6);
+    buffer.commit(4);
+
+    REQUIRE(buffer.read().size() == 4);
+    buffer.release(4);
+    REQUIRE(buffer.read().size() == 4);
+    buffer.release(4);
+    REQUIRE(buffer.empty());
+}
+
+TEST_CASE("Single producer and single consumer keep the order", "[BipBuffer]")
+{
+    constexpr int PACKETS = 100000;
+    BipBuffer<uint8_t> buffer {4096};
+
+    std::thread producer([&buffer] {
+        for (int i = 0; i < PACKETS; ++i) {
+            const size_t size = sizeof(int) + i % 64;
+            std::span<uint8_t> reserved {};
+            while ((reserved = buffer.reserve(size)).empty()) {}
+
+            memcpy(reserved.data(), &i, sizeof(int));
+            buffer.commit(size);
+        }
+    });
+
+    std::thread consumer([&buffer] {
+        for (int i = 0; i < PACKETS; ++i) {
+            const size_t size = sizeof(int) + i % 64;
+            std::span<uint8_t> readable {};
+            while ((readable = buffer.read()).size() < size) {}
+
+            int value;
+            memcpy(&value, readable.data(), sizeof(int));
+            REQUIRE(value == i);
+            buffer.release(size);
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    REQUIRE(buffer.empty());
+}
+
+TEST_CASE("reset drops what is committed and wrapped", "[BipBuffer]")
+{
+    BipBuffer<int> buffer {16};
+
+    buffer.reserve(12);
+    buffer.commit(12);
+    buffer.release(8);
+    buffer.reserve(6);
+    buffer.commit(6);
+
+    buffer.reset();
+    REQUIRE(buffer.empty());
+    REQUIRE(buffer.read().empty());
+
+    // The whole buffer is contiguous again
+    auto reserved = buffer.reserve(15);
+    REQUIRE(reserved.size() == 15);
+    reserved[0] = 1;
+    buffer.commit(1);
+    REQUIRE(buffer.read().size() == 1);
+    REQUIRE(buffer.read()[0] == 1);
+}
@@ -0,0 +1,50 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/buffer_pool.hpp>
+#include <sanhok/mpsc_queue.hpp>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace sanhok;
+
+namespace {
+constexpr size_t MESSAGES = 1000000;
+constexpr size_t MESSAGE_SIZE = 200;
+constexpr uint8_t BYTES[MESSAGE_SIZE] {};
+
+// Allocates messages on this thread and frees them on a handler thread, like the receive path of PeerTCP
+template <typename Message, typename Allocate>
+void hand_over(Allocate allocate) {
+    MpscQueue<Message> queue {1024};
+
+    std::thread handler([&queue] {
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            const auto message = queue.pop_wait();
+            REQUIRE(message->size() == MESSAGE_SIZE);
+        }
+    });
+
+    for (size_t i = 0; i < MESSAGES; ++i) queue.push(allocate());
+    handler.join();
+}
+}
+
+TEST_CASE("[BufferPool]") {
+    BufferPool pool {};
+
+    BENCHMARK("std::vector; 1000000 messages of 200 bytes freed on another thread") {
+        hand_over<std::vector<uint8_t>>([] {
+            return std::vector<uint8_t>(BYTES, BYTES + MESSAGE_SIZE);
+        });
+    };
+
+    BENCHMARK("MessageBuffer; 1000000 messages of 200 bytes released on another thread") {
+        hand_over<MessageBuffer>([&pool] {
+            auto message = pool.acquire(MESSAGE_SIZE);
+            std::memcpy(message.data(), BYTES, MESSAGE_SIZE);
+            return message;
+        });
+    };
+}
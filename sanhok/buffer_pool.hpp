@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace sanhok {
+class BufferPool;
+
+/*
+ * A ref-counted handle to a byte buffer from BufferPool
+ * Copies share the buffer, which goes back to the pool when the last handle is gone.
+ */
+class MessageBuffer {
+public:
+    MessageBuffer() = default;
+    ~MessageBuffer();
+    MessageBuffer(const MessageBuffer& other);
+    MessageBuffer(MessageBuffer&& other) noexcept;
+    MessageBuffer& operator=(const MessageBuffer& other);
+    MessageBuffer& operator=(MessageBuffer&& other) noexcept;
+
+    uint8_t* data() { return block_ ? block_->data() + block_->offset : nullptr; }
+    const uint8_t* data() const { return block_ ? block_->data() + block_->offset : nullptr; }
+    size_t size() const { return block_ ? block_->size : 0; }
+    size_t capacity() const { return block_ ? block_->capacity - block_->offset : 0; }
+    bool empty() const { return size() == 0; }
+    void resize(size_t size);
+
+    uint8_t* begin() { return data(); }
+    uint8_t* end() { return data() + size(); }
+    const uint8_t* begin() const { return data(); }
+    const uint8_t* end() const { return data() + size(); }
+    std::span<const uint8_t> span() const { return {data(), size()}; }
+
+    size_t use_count() const { return block_ ? block_->references.load(std::memory_order_relaxed) : 0; }
+    explicit operator bool() const { return block_ != nullptr; }
+
+    // Hands the whole allocation over as a raw pointer and takes it back, e.g. for flatbuffers::Allocator
+    uint8_t* release();
+    static MessageBuffer adopt(uint8_t* allocation, size_t offset, size_t size);
+
+private:
+    friend class BufferPool;
+
+    // Header of an allocation; the bytes of the buffer follow it
+    struct alignas(16) Block {
+        std::atomic<uint32_t> references;
+        uint32_t size_class;
+        size_t offset; // Of data() in the allocation
+        size_t size;
+        size_t capacity;
+        BufferPool* pool;
+
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+
+    explicit MessageBuffer(Block* block) : block_(block) {}
+    void reset();
+
+    Block* block_ {nullptr};
+};
+
+/*
+ * A pool of byte buffers in power-of-two size classes
+ * Released buffers go to a cache of the releasing thread and spill over to a shared list when it is full,
+ * so that buffers allocated on an I/O thread and released on a handler thread are reused without malloc/free.
+ * Sizes above max_size are allocated and freed every time. The pool has to outlive its buffers.
+ */
+class BufferPool {
+public:
+    struct Stats {
+        size_t hits; // Acquired from a cache
+        size_t misses; // Allocated
+    };
+
+    explicit BufferPool(size_t min_size, size_t max_size, size_t thread_cache_size);
+    ~BufferPool();
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    MessageBuffer acquire(size_t size);
+    Stats stats() const;
+
+    // A pool shared by the whole process
+    static BufferPool& shared();
+
+private:
+    friend class MessageBuffer;
+    using Block = MessageBuffer::Block;
+    static constexpr uint32_t UNPOOLED = UINT32_MAX;
+
+    struct ThreadCache {
+        ThreadCache(uint64_t pool_id, size_t size_classes);
+        ~ThreadCache();
+        ThreadCache(ThreadCache&& other) noexcept = default;
+        ThreadCache& operator=(ThreadCache&& other) noexcept = default;
+
+        uint64_t pool_id;
+        std::vector<std::vector<Block*>> free_lists;
+    };
+
+    static std::vector<ThreadCache>* thread_caches();
+    ThreadCache* thread_cache();
+    void release(Block* block);
+    Block* allocate(uint32_t size_class, size_t capacity);
+    static void deallocate(Block* block);
+
+    static std::atomic<uint64_t> next_id_;
+
+    const uint64_t id_;
+    const size_t min_size_;
+    const uint32_t size_classes_;
+    const size_t thread_cache_size_;
+
+    std::mutex shared_mutex_ {};
+    std::vector<std::vector<Block*>> shared_free_lists_;
+
+    alignas(64) std::atomic<size_t> hits_ {0};
+    std::atomic<size_t> misses_ {0};
+};
+
+inline MessageBuffer::~MessageBuffer() {
+    reset();
+}
+
+inline MessageBuffer::MessageBuffer(const MessageBuffer& other) : block_(other.block_) {
+    if (block_) block_->references.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline MessageBuffer::MessageBuffer(MessageBuffer&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {}
+
+inline MessageBuffer& MessageBuffer::operator=(const MessageBuffer& other) {
+    if (this == &other) return *this;
+
+    if (other.block_) other.block_->references.fetch_add(1, std::memory_order_relaxed);
+    reset();
+    block_ = other.block_;
+    return *this;
+}
+
+inline MessageBuffer& MessageBuffer::operator=(MessageBuffer&& other) noexcept {
+    if (this == &other) return *this;
+
+    reset();
+    block_ = std::exchange(other.block_, nullptr);
+    return *this;
+}
+
+// Only shrinks or grows within the capacity
+inline void MessageBuffer::resize(const size_t size) {
+    if (block_) block_->size = std::min(size, capacity());
+}
+
+// The returned allocation of capacity() bytes has to be adopted back to be released, even if it is shared
+inline uint8_t* MessageBuffer::release() {
+    if (!block_) return nullptr;
+    return std::exchange(block_, nullptr)->data();
+}
+
+// Takes back an allocation from release(), viewing size bytes from offset
+inline MessageBuffer MessageBuffer::adopt(uint8_t* allocation, const size_t offset, const size_t size) {
+    if (!allocation) return {};
+
+    MessageBuffer buffer {reinterpret_cast<Block*>(allocation) - 1};
+    buffer.block_->offset = std::min(offset, buffer.block_->capacity);
+    buffer.block_->size = std::min(size, buffer.capacity());
+    return buffer;
+}
+
+inline void MessageBuffer::reset() {
+    if (!block_) return;
+
+    if (block_->references.fetch_sub(1, std::memory_order_acq_rel) == 1) block_->pool->release(block_);
+    block_ = nullptr;
+}
+
+inline std::atomic<uint64_t> BufferPool::next_id_ {0};
+
+inline BufferPool::BufferPool(const size_t min_size = 64, const size_t max_size = 65536,
+    const size_t thread_cache_size = 64)
+    : id_(next_id_.fetch_add(1, std::memory_order_relaxed)),
+    min_size_(std::bit_ceil(std::max<size_t>(min_size, 16))),
+    size_classes_(std::countr_zero(std::bit_ceil(std::max(max_size, min_size_))) - std::countr_zero(min_size_) + 1),
+    thread_cache_size_(std::max<size_t>(thread_cache_size, 2)),
+    shared_free_lists_(size_classes_) {}
+
+inline BufferPool::~BufferPool() {
+    for (auto& free_list : shared_free_lists_) {
+        for (Block* block : free_list) deallocate(block);
+    }
+
+    // Caches of other threads free their blocks when the threads exit
+    if (const auto caches = thread_caches()) {
+        std::erase_if(*caches, [this](const ThreadCache& cache) { return cache.pool_id == id_; });
+    }
+}
+
+inline MessageBuffer BufferPool::acquire(const size_t size) {
+    const size_t capacity = std::bit_ceil(std::max(size, min_size_));
+    const auto size_class = static_cast<uint32_t>(std::countr_zero(capacity) - std::countr_zero(min_size_));
+
+    Block* block;
+    if (size_class >= size_classes_) {
+        block = allocate(UNPOOLED, size);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        // No cache once the thread is tearing its caches down, as in static destructors
+        const auto cache = thread_cache();
+        const auto free_list = cache ? &cache->free_lists[size_class] : nullptr;
+        if (free_list && free_list->empty()) {
+            // Refill half of the cache from the shared list at once
+            std::lock_guard lock {shared_mutex_};
+            auto& shared_free_list = shared_free_lists_[size_class];
+            const size_t count = std::min(shared_free_list.size(), thread_cache_size_ / 2);
+            free_list->insert(free_list->end(), shared_free_list.end() - count, shared_free_list.end());
+            shared_free_list.resize(shared_free_list.size() - count);
+        }
+
+        if (!free_list || free_list->empty()) {
+            block = allocate(size_class, capacity);
+            misses_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            block = free_list->back();
+            free_list->pop_back();
+            hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    block->references.store(1, std::memory_order_relaxed);
+    block->offset = 0;
+    block->size = size;
+    return MessageBuffer {block};
+}
+
+inline BufferPool::Stats BufferPool::stats() const {
+    return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed)};
+}
+
+inline BufferPool& BufferPool::shared() {
+    static BufferPool pool {};
+    return pool;
+}
+
+// nullptr once the caches of the thread are destroyed, which at exit is before the shared pool is
+inline std::vector<BufferPool::ThreadCache>* BufferPool::thread_caches() {
+    // Trivially destructible, so it is still readable after the caches are gone
+    thread_local bool destroyed {false};
+    struct Caches : std::vector<ThreadCache> {
+        ~Caches() { destroyed = true; }
+    };
+    thread_local Caches caches {};
+
+    return destroyed ? nullptr : &caches;
+}
+
+inline BufferPool::ThreadCache* BufferPool::thread_cache() {
+    const auto caches = thread_caches();
+    if (!caches) return nullptr;
+
+    // Usually there is a single pool, so a linear search beats hashing
+    for (auto& cache : *caches) {
+        if (cache.pool_id == id_) return &cache;
+    }
+    return &caches->emplace_back(id_, size_classes_);
+}
+
+inline void BufferPool::release(Block* block) {
+    const auto cache = block->size_class == UNPOOLED ? nullptr : thread_cache();
+    if (!cache) {
+        deallocate(block);
+        return;
+    }
+
+    auto& free_list = cache->free_lists[block->size_class];
+    if (free_list.size() >= thread_cache_size_) {
+        // Hand half of the cache over to the threads that acquire
+        std::lock_guard lock {shared_mutex_};
+        auto& shared_free_list = shared_free_lists_[block->size_class];
+        const size_t count = thread_cache_size_ / 2;
+        shared_free_list.insert(shared_free_list.end(), free_list.end() - count, free_list.end());
+        free_list.resize(free_list.size() - count);
+    }
+    free_list.push_back(block);
+}
+
+inline BufferPool::Block* BufferPool::allocate(const uint32_t size_class, const size_t capacity) {
+    void* memory = ::operator new(sizeof(Block) + capacity, std::align_val_t {alignof(Block)});
+    return new(memory) Block {{0}, size_class, 0, 0, capacity, this};
+}
+
+inline void BufferPool::deallocate(Block* block) {
+    block->~Block();
+    ::operator delete(block, std::align_val_t {alignof(Block)});
+}
+
+inline BufferPool::ThreadCache::ThreadCache(const uint64_t pool_id, const size_t size_classes)
+    : pool_id(pool_id), free_lists(size_classes) {}
+
+inline BufferPool::ThreadCache::~ThreadCache() {
+    for (auto& free_list : free_lists) {
+        for (Block* block : free_list) deallocate(block);
+    }
+}
+}
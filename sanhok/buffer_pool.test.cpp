@@ -0,0 +1,70 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/buffer_pool.hpp>
+
+#include <cstring>
+#include <thread>
+
+using namespace sanhok;
+
+TEST_CASE("[BufferPool]") {
+    BufferPool pool {64, 4096, 8};
+
+    SECTION("acquire rounds the capacity up to the size class") {
+        const auto buffer = pool.acquire(100);
+        REQUIRE(buffer.size() == 100);
+        REQUIRE(buffer.capacity() == 128);
+
+        const auto small = pool.acquire(1);
+        REQUIRE(small.capacity() == 64);
+
+        const auto unpooled = pool.acquire(5000);
+        REQUIRE(unpooled.size() == 5000);
+        REQUIRE(unpooled.capacity() == 5000);
+    }
+
+    SECTION("A released buffer is reused by the same thread") {
+        const uint8_t* data;
+        {
+            auto buffer = pool.acquire(100);
+            data = buffer.data();
+        }
+
+        const auto buffer = pool.acquire(120);
+        REQUIRE(buffer.data() == data);
+        REQUIRE(pool.stats().hits == 1);
+        REQUIRE(pool.stats().misses == 1);
+    }
+
+    SECTION("Copies share the buffer until the last one is gone") {
+        auto buffer = pool.acquire(3);
+        std::memcpy(buffer.data(), "abc", 3);
+
+        auto copy = buffer;
+        REQUIRE(buffer.use_count() == 2);
+        REQUIRE(copy.data() == buffer.data());
+
+        buffer = MessageBuffer {};
+        REQUIRE(!buffer);
+        REQUIRE(copy.use_count() == 1);
+        REQUIRE(std::memcmp(copy.data(), "abc", 3) == 0);
+
+        const auto moved = std::move(copy);
+        REQUIRE(!copy);
+        REQUIRE(moved.use_count() == 1);
+    }
+
+    SECTION("Buffers released on another thread come back through the shared list") {
+        constexpr int BUFFERS = 64;
+
+        std::vector<MessageBuffer> buffers {};
+        for (int i = 0; i < BUFFERS; ++i) buffers.push_back(pool.acquire(64));
+        REQUIRE(pool.stats().misses == BUFFERS);
+
+        std::thread([&buffers] { buffers.clear(); }).join();
+
+        // The releasing thread kept at most thread_cache_size buffers and spilled the rest
+        for (int i = 0; i < BUFFERS / 2; ++i) buffers.push_back(pool.acquire(64));
+        REQUIRE(pool.stats().hits == BUFFERS / 2);
+        REQUIRE(pool.stats().misses == BUFFERS);
+    }
+}
@@ -0,0 +1,137 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/concurrent_map.hpp>
+#include <sanhok/read_mostly_map.hpp>
+#include <sanhok/sharded_concurrent_map.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sanhok;
+
+namespace {
+constexpr int KEYS = 10000;
+constexpr int OPERATIONS = 1000000;
+
+// Every thread updates random keys with apply and re-inserts them in write_percent of the operations
+template <typename Map>
+void mixed_workload(Map& map, const int threads, const int write_percent) {
+    std::vector<std::thread> workers {};
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, threads, write_percent, t] {
+            uint32_t key = t * 7919;
+            for (int i = 0; i < OPERATIONS / threads; ++i) {
+                key = (key * 1103515245 + 12345) % KEYS;
+
+                if (i % 100 < write_percent) {
+                    map.erase(key);
+                    map.insert_or_assign(key, i);
+                } else {
+                    map.apply(key, [](int& value) {
+                        ++value;
+                    });
+                }
+            }
+        });
+    }
+
+    for (auto& worker : workers) worker.join();
+}
+
+// Reader threads look up random keys with apply while a writer re-inserts a key every 100us, like sessions
+// connecting and disconnecting under the lookups of their messages
+template <typename Map>
+void read_mostly_workload(Map& map, const int readers) {
+    std::atomic<bool> reading {true};
+    std::thread writer {[&map, &reading] {
+        for (int i = 0; reading; ++i) {
+            map.erase(i % KEYS);
+            map.insert_or_assign(i % KEYS, i);
+            std::this_thread::sleep_for(std::chrono::microseconds {100});
+        }
+    }};
+
+    std::vector<std::thread> workers {};
+    for (int t = 0; t < readers; ++t) {
+        workers.emplace_back([&map, readers, t] {
+            uint32_t key = t * 7919;
+            int sum {0};
+            for (int i = 0; i < OPERATIONS / readers; ++i) {
+                key = (key * 1103515245 + 12345) % KEYS;
+                map.apply(key, [&sum](const int& value) {
+                    sum += value;
+                });
+            }
+            Catch::Benchmark::keep_memory(&sum);
+        });
+    }
+
+    for (auto& worker : workers) worker.join();
+    reading = false;
+    writer.join();
+}
+
+template <typename Map>
+void fill(Map& map) {
+    for (int i = 0; i < KEYS; ++i) map.insert_or_assign(i, i);
+}
+}
+
+TEST_CASE("[ConcurrentMap vs ShardedConcurrentMap]") {
+    for (const int write_percent : {1, 10, 50}) {
+        for (const int threads : {1, 2, 4, 8}) {
+            const auto suffix = "; " + std::to_string(threads) + " threads, " + std::to_string(write_percent)
+                + "% writes, 1000000 operations";
+
+            BENCHMARK_ADVANCED("ConcurrentMap" + suffix)(Catch::Benchmark::Chronometer meter) {
+                ConcurrentMap<int, int> map {};
+                fill(map);
+                meter.measure([&] {
+                    mixed_workload(map, threads, write_percent);
+                });
+            };
+
+            BENCHMARK_ADVANCED("ShardedConcurrentMap<16>" + suffix)(Catch::Benchmark::Chronometer meter) {
+                ShardedConcurrentMap<int, int, 16> map {};
+                fill(map);
+                meter.measure([&] {
+                    mixed_workload(map, threads, write_percent);
+                });
+            };
+        }
+    }
+}
+
+TEST_CASE("[ConcurrentMap vs ReadMostlyMap]") {
+    for (const int readers : {1, 2, 4, 8, 16}) {
+        const auto suffix = "; " + std::to_string(readers) + " reader threads, a write every 100us, 1000000 lookups";
+
+        BENCHMARK_ADVANCED("ConcurrentMap" + suffix)(Catch::Benchmark::Chronometer meter) {
+            ConcurrentMap<int, int> map {};
+            fill(map);
+            meter.measure([&] {
+                read_mostly_workload(map, readers);
+            });
+        };
+
+        BENCHMARK_ADVANCED("ShardedConcurrentMap<16>" + suffix)(Catch::Benchmark::Chronometer meter) {
+            ShardedConcurrentMap<int, int, 16> map {};
+            fill(map);
+            meter.measure([&] {
+                read_mostly_workload(map, readers);
+            });
+        };
+
+        BENCHMARK_ADVANCED("ReadMostlyMap" + suffix)(Catch::Benchmark::Chronometer meter) {
+            ReadMostlyMap<int, int> map {};
+            fill(map);
+            meter.measure([&] {
+                read_mostly_workload(map, readers);
+            });
+        };
+    }
+}
@@ -24,6 +24,7 @@ public:
     }
 
     ValueType at(const KeyType& key) const {
+        std::shared_lock lock {mutex_};
         return map_.at(key);
     }
 
@@ -1,9 +1,72 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/benchmark/catch_benchmark.hpp>
 #include <sanhok/concurrent_queue.hpp>
+#include <sanhok/mpsc_queue.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace sanhok;
 
+namespace {
+constexpr size_t ITEMS = 1000000;
+constexpr int ITEM_VALUE = 42;
+
+template <typename Queue>
+void pop_wait_items(Queue& queue, const size_t producers) {
+    std::thread consumer([&] {
+        for (size_t i = 0; i < ITEMS; ++i) {
+            const auto v = queue.pop_wait();
+            REQUIRE(v);
+            REQUIRE(*v == ITEM_VALUE);
+        }
+    });
+
+    std::vector<std::thread> producer_threads {};
+    for (size_t p = 0; p < producers; ++p) {
+        producer_threads.emplace_back([&] {
+            for (size_t i = 0; i < ITEMS / producers; ++i) {
+                queue.push(ITEM_VALUE);
+            }
+        });
+    }
+
+    consumer.join();
+    for (auto& producer : producer_threads) producer.join();
+    REQUIRE(queue.empty());
+}
+
+void pop_bulk_items(MpscQueue<int>& queue, const size_t producers) {
+    std::thread consumer([&] {
+        std::vector<int> items {};
+        items.reserve(256);
+
+        size_t consumed {0};
+        while (consumed < ITEMS) {
+            const auto v = queue.pop_wait();
+            REQUIRE(v);
+
+            items.clear();
+            consumed += 1 + queue.try_pop_bulk(items, 255);
+        }
+    });
+
+    std::vector<std::thread> producer_threads {};
+    for (size_t p = 0; p < producers; ++p) {
+        producer_threads.emplace_back([&] {
+            for (size_t i = 0; i < ITEMS / producers; ++i) {
+                queue.push(ITEM_VALUE);
+            }
+        });
+    }
+
+    consumer.join();
+    for (auto& producer : producer_threads) producer.join();
+    REQUIRE(queue.empty());
+}
+}
+
 TEST_CASE("[ConcurrentQueue]") {
 
     BENCHMARK("pop() busy-waits; 1 consumer, 2 producers, 1000000 items") {
@@ -68,4 +131,25 @@ TEST_CASE("[ConcurrentQueue]") {
         producer2.join();
         REQUIRE(queue.empty());
     };
-}
\ No newline at end of file
+}
+
+TEST_CASE("[ConcurrentQueue vs MpscQueue]") {
+    for (const size_t producers : {1, 2, 4, 8}) {
+        const auto suffix = "; 1 consumer, " + std::to_string(producers) + " producers, 1000000 items";
+
+        BENCHMARK("ConcurrentQueue pop_wait()" + suffix) {
+            ConcurrentQueue<int> queue {};
+            pop_wait_items(queue, producers);
+        };
+
+        BENCHMARK("MpscQueue pop_wait()" + suffix) {
+            MpscQueue<int> queue {};
+            pop_wait_items(queue, producers);
+        };
+
+        BENCHMARK("MpscQueue try_pop_bulk(256)" + suffix) {
+            MpscQueue<int> queue {};
+            pop_bulk_items(queue, producers);
+        };
+    }
+}
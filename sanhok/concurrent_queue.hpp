@@ -21,6 +21,8 @@ public:
     void push(T&& value);
     std::optional<T> pop();
     std::optional<T> pop_wait();
+    template <typename Stop>
+    std::optional<T> pop_wait(Stop stop);
     bool empty() const;
     void clear();
 
@@ -82,6 +84,20 @@ std::optional<T> ConcurrentQueue<T>::pop_wait() {
     return std::make_optional(std::move(value));
 }
 
+// Waits until a value is pushed or stop() returns true; whatever makes stop() true has to clear() afterward
+template <typename T>
+template <typename Stop>
+std::optional<T> ConcurrentQueue<T>::pop_wait(Stop stop) {
+    std::unique_lock lock {mutex_};
+
+    cv_.wait(lock, [this, &stop] { return !queue_.empty() || stop(); });
+    if (queue_.empty()) return std::nullopt;
+
+    T value = std::move(queue_.front());
+    queue_.pop();
+    return std::make_optional(std::move(value));
+}
+
 template <typename T>
 bool ConcurrentQueue<T>::empty() const {
     std::lock_guard lock {mutex_};
@@ -75,6 +75,22 @@ TEST_CASE("[ConcurrentQueue]") {
         consumer.join();
     }
 
+    SECTION("pop_wait returns std::nullopt after stop and a single clear") {
+        queue.clear();
+
+        std::atomic<bool> stopped {false};
+        std::thread consumer([&] {
+            auto v = queue.pop_wait([&] { return stopped.load(); });
+            REQUIRE(v == std::nullopt);
+        });
+
+        std::this_thread::sleep_for(10ms);
+        stopped = true;
+        queue.clear();
+
+        consumer.join();
+    }
+
     SECTION("The consumer waits for the producers with condition variable") {
         queue.clear();
 
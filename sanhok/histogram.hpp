@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sanhok {
+/*
+ * A histogram of integer values in log-linear buckets, like HdrHistogram
+ * Every power of two is split into 32 buckets, so a value is reported within 1/32 of itself,
+ * and recording is a relaxed atomic increment that threads can do concurrently without locks.
+ * Values above MAX_VALUE, about 2^41, are counted as MAX_VALUE.
+ */
+class Histogram {
+public:
+    static constexpr uint64_t MAX_VALUE {(uint64_t {1} << 41) - 1};
+
+    /*
+     * Counts of a histogram at one point in time, which can be merged and queried for percentiles
+     */
+    class Snapshot {
+    public:
+        Snapshot() = default;
+
+        uint64_t count() const { return count_; }
+        uint64_t max() const { return max_; }
+        // The value below which percentile of the values fall, e.g. 0.99 for p99; 0 if there are none
+        uint64_t value_at_percentile(double percentile) const;
+
+        Snapshot& operator+=(const Snapshot& other);
+
+    private:
+        friend class Histogram;
+
+        std::vector<uint64_t> counts_ {};
+        uint64_t count_ {0};
+        uint64_t max_ {0};
+    };
+
+    Histogram() = default;
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    void record(uint64_t value);
+    Snapshot snapshot() const;
+    void reset();
+
+private:
+    static constexpr uint32_t SUB_BUCKET_BITS {5};
+    static constexpr uint64_t SUB_BUCKETS {uint64_t {1} << SUB_BUCKET_BITS};
+    static constexpr size_t BUCKETS {SUB_BUCKETS * (std::bit_width(MAX_VALUE) - SUB_BUCKET_BITS + 1)};
+
+    static size_t bucket(uint64_t value);
+    static uint64_t highest_value(size_t bucket);
+
+    std::array<std::atomic<uint64_t>, BUCKETS> counts_ {};
+    std::atomic<uint64_t> max_ {0};
+};
+
+inline void Histogram::record(uint64_t value) {
+    value = std::min(value, MAX_VALUE);
+    counts_[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+// Concurrent records may be partly seen, but every count is one that was recorded
+inline Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot {};
+    snapshot.counts_.resize(BUCKETS);
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        snapshot.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.count_ += snapshot.counts_[i];
+    }
+    snapshot.max_ = max_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+inline void Histogram::reset() {
+    for (auto& count : counts_) count.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+// Values below SUB_BUCKETS have a bucket each; above them every power of two has SUB_BUCKETS buckets
+inline size_t Histogram::bucket(const uint64_t value) {
+    if (value < SUB_BUCKETS) return value;
+
+    const uint32_t shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+inline uint64_t Histogram::highest_value(const size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+
+    const uint32_t shift = bucket / SUB_BUCKETS - 1;
+    const uint64_t lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lowest + (uint64_t {1} << shift) - 1;
+}
+
+inline uint64_t Histogram::Snapshot::value_at_percentile(const double percentile) const {
+    if (count_ == 0) return 0;
+
+    const auto rank = std::clamp<uint64_t>(
+        static_cast<uint64_t>(std::ceil(percentile * static_cast<double>(count_))), 1, count_);
+    uint64_t seen {0};
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) return std::min(highest_value(i), max_);
+    }
+    return max_;
+}
+
+inline Histogram::Snapshot& Histogram::Snapshot::operator+=(const Snapshot& other) {
+    if (counts_.size() < other.counts_.size()) counts_.resize(other.counts_.size());
+    for (size_t i = 0; i < other.counts_.size(); ++i) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+    return *this;
+}
+}
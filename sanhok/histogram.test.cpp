@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/histogram.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace sanhok;
+
+TEST_CASE("[Histogram]") {
+    Histogram histogram {};
+
+    SECTION("An empty histogram has no percentiles") {
+        const auto snapshot = histogram.snapshot();
+        REQUIRE(snapshot.count() == 0);
+        REQUIRE(snapshot.value_at_percentile(0.5) == 0);
+    }
+
+    SECTION("Small values are exact") {
+        for (uint64_t value = 1; value <= 20; ++value) histogram.record(value);
+
+        const auto snapshot = histogram.snapshot();
+        REQUIRE(snapshot.count() == 20);
+        REQUIRE(snapshot.value_at_percentile(0.5) == 10);
+        REQUIRE(snapshot.value_at_percentile(1.0) == 20);
+        REQUIRE(snapshot.max() == 20);
+    }
+
+    SECTION("Percentiles are within 1/32 of the values") {
+        for (uint64_t value = 1; value <= 100000; ++value) histogram.record(value * 1000);
+
+        const auto snapshot = histogram.snapshot();
+        for (const double percentile : {0.5, 0.9, 0.99, 0.999}) {
+            const auto expected = static_cast<double>(percentile * 100000 * 1000);
+            const auto value = static_cast<double>(snapshot.value_at_percentile(percentile));
+            REQUIRE(value >= expected);
+            REQUIRE(value <= expected * (1 + 1.0 / 32));
+        }
+        REQUIRE(snapshot.value_at_percentile(1.0) == 100000 * 1000);
+    }
+
+    SECTION("Values above MAX_VALUE are clamped") {
+        histogram.record(UINT64_MAX);
+        REQUIRE(histogram.snapshot().max() == Histogram::MAX_VALUE);
+        REQUIRE(histogram.snapshot().value_at_percentile(1.0) == Histogram::MAX_VALUE);
+    }
+
+    SECTION("Snapshots merge and reset clears") {
+        Histogram other {};
+        histogram.record(10);
+        other.record(1000);
+
+        auto snapshot = histogram.snapshot();
+        snapshot += other.snapshot();
+        REQUIRE(snapshot.count() == 2);
+        REQUIRE(snapshot.value_at_percentile(0.5) == 10);
+        REQUIRE(snapshot.max() == 1000);
+
+        histogram.reset();
+        REQUIRE(histogram.snapshot().count() == 0);
+        REQUIRE(histogram.snapshot().max() == 0);
+    }
+
+    SECTION("Threads record concurrently") {
+        constexpr size_t THREADS = 4;
+        constexpr size_t RECORDS = 100000;
+
+        std::vector<std::thread> threads {};
+        for (size_t t = 0; t < THREADS; ++t) {
+            threads.emplace_back([&histogram, t] {
+                for (size_t i = 0; i < RECORDS; ++i) histogram.record(t * RECORDS + i);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+
+        const auto snapshot = histogram.snapshot();
+        REQUIRE(snapshot.count() == THREADS * RECORDS);
+        REQUIRE(snapshot.max() == THREADS * RECORDS - 1);
+    }
+}
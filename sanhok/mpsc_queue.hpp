@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace sanhok {
+/*
+ * A lock-free bounded queue for single consumer and multiple producers
+ * It has the same interface as ConcurrentQueue; push waits for the consumer while the queue is full.
+ */
+template <typename T>
+class MpscQueue {
+public:
+    explicit MpscQueue(size_t capacity = 1024);
+    ~MpscQueue();
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(const T& value);
+    void push(T&& value);
+    bool try_push(const T& value);
+    bool try_push(T&& value);
+    std::optional<T> pop();
+    std::optional<T> pop_wait();
+    size_t try_pop_bulk(std::vector<T>& out, size_t max);
+    bool empty() const;
+    void clear();
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) std::byte storage[sizeof(T)];
+    };
+
+    template <typename U>
+    bool emplace(U&& value);
+    std::optional<T> pop_unguarded();
+    void notify_consumer();
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> buffer_;
+
+    alignas(64) std::atomic<size_t> enqueue_pos_ {0};
+    alignas(64) std::atomic<size_t> dequeue_pos_ {0};
+
+    // Serializes the consumer with clear(), which may be called from any thread
+    std::atomic_flag consuming_ {};
+    std::atomic<bool> waiting_ {false};
+    std::atomic<uint32_t> signal_ {0};
+    std::atomic<uint32_t> cleared_ {0};
+};
+
+template <typename T>
+MpscQueue<T>::MpscQueue(const size_t capacity)
+    : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1), buffer_(std::make_unique<Cell[]>(mask_ + 1)) {
+    for (size_t i = 0; i <= mask_; ++i) {
+        buffer_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+MpscQueue<T>::~MpscQueue() {
+    clear();
+}
+
+template <typename T>
+void MpscQueue<T>::push(const T& value) {
+    while (!emplace(value)) std::this_thread::yield();
+}
+
+template <typename T>
+void MpscQueue<T>::push(T&& value) {
+    while (!emplace(std::move(value))) std::this_thread::yield();
+}
+
+template <typename T>
+bool MpscQueue<T>::try_push(const T& value) {
+    return emplace(value);
+}
+
+template <typename T>
+bool MpscQueue<T>::try_push(T&& value) {
+    return emplace(std::move(value));
+}
+
+template <typename T>
+template <typename U>
+bool MpscQueue<T>::emplace(U&& value) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+
+    while (true) {
+        cell = &buffer_[pos & mask_];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // Full
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::construct_at(reinterpret_cast<T*>(cell->storage), std::forward<U>(value));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    notify_consumer();
+    return true;
+}
+
+template <typename T>
+void MpscQueue<T>::notify_consumer() {
+    // Pairs with the fence in pop_wait so that either the consumer sees the value or the producer sees it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Only the first producer after the consumer went to sleep pays for the wake-up
+    if (!waiting_.load(std::memory_order_relaxed) || !waiting_.exchange(false, std::memory_order_relaxed)) return;
+
+    signal_.fetch_add(1, std::memory_order_release);
+    signal_.notify_one();
+}
+
+template <typename T>
+std::optional<T> MpscQueue<T>::pop() {
+    if (consuming_.test_and_set(std::memory_order_acquire)) return std::nullopt;
+
+    auto value = pop_unguarded();
+    consuming_.clear(std::memory_order_release);
+    return value;
+}
+
+template <typename T>
+std::optional<T> MpscQueue<T>::pop_unguarded() {
+    const size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell& cell = buffer_[pos & mask_];
+    if (cell.sequence.load(std::memory_order_acquire) != pos + 1) return std::nullopt;
+
+    T* value_ptr = reinterpret_cast<T*>(cell.storage);
+    std::optional<T> value {std::move(*value_ptr)};
+    std::destroy_at(value_ptr);
+
+    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+    dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+    return value;
+}
+
+template <typename T>
+std::optional<T> MpscQueue<T>::pop_wait() {
+    while (true) {
+        if (auto value = pop()) return value;
+
+        const uint32_t signal = signal_.load(std::memory_order_acquire);
+        const uint32_t cleared = cleared_.load(std::memory_order_acquire);
+        waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (auto value = pop()) {
+            waiting_.store(false, std::memory_order_relaxed);
+            return value;
+        }
+
+        signal_.wait(signal, std::memory_order_acquire);
+        waiting_.store(false, std::memory_order_relaxed);
+
+        if (cleared_.load(std::memory_order_acquire) != cleared) return std::nullopt;
+    }
+}
+
+template <typename T>
+size_t MpscQueue<T>::try_pop_bulk(std::vector<T>& out, const size_t max) {
+    if (consuming_.test_and_set(std::memory_order_acquire)) return 0;
+
+    size_t count {0};
+    while (count < max) {
+        auto value = pop_unguarded();
+        if (!value) break;
+
+        out.push_back(std::move(*value));
+        ++count;
+    }
+
+    consuming_.clear(std::memory_order_release);
+    return count;
+}
+
+template <typename T>
+bool MpscQueue<T>::empty() const {
+    const size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    return buffer_[pos & mask_].sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+template <typename T>
+void MpscQueue<T>::clear() {
+    while (consuming_.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+    while (pop_unguarded()) {}
+    consuming_.clear(std::memory_order_release);
+
+    cleared_.fetch_add(1, std::memory_order_release);
+    signal_.fetch_add(1, std::memory_order_release);
+    signal_.notify_all();
+}
+}
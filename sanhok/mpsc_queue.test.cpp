@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/mpsc_queue.hpp>
+
+#include <chrono>
+#include <thread>
+
+using namespace sanhok;
+using namespace std::chrono_literals;
+
+TEST_CASE("[MpscQueue]") {
+    constexpr size_t ITEM_COUNT = 10000;
+    constexpr int ITEM_VALUE = 42;
+    MpscQueue<int> queue {64};
+
+    SECTION("pop returns std::nullopt from the empty queue") {
+        queue.clear();
+
+        const auto v = queue.pop();
+        REQUIRE(v == std::nullopt);
+    }
+
+    SECTION("try_push fails on the full queue") {
+        queue.clear();
+
+        for (size_t i = 0; i < queue.capacity(); ++i) {
+            REQUIRE(queue.try_push(ITEM_VALUE));
+        }
+        REQUIRE(!queue.try_push(ITEM_VALUE));
+
+        REQUIRE(queue.pop() == ITEM_VALUE);
+        REQUIRE(queue.try_push(ITEM_VALUE));
+    }
+
+    SECTION("try_pop_bulk pops up to max in order") {
+        queue.clear();
+
+        for (int i = 0; i < 10; ++i) queue.push(i);
+
+        std::vector<int> out {};
+        REQUIRE(queue.try_pop_bulk(out, 4) == 4);
+        REQUIRE(queue.try_pop_bulk(out, 100) == 6);
+        REQUIRE(queue.try_pop_bulk(out, 100) == 0);
+
+        REQUIRE(out.size() == 10);
+        for (int i = 0; i < 10; ++i) REQUIRE(out[i] == i);
+        REQUIRE(queue.empty());
+    }
+
+    SECTION("The consumer busy-waits for the producers") {
+        queue.clear();
+
+        std::thread consumer([&] {
+            size_t i {0};
+            while (i < ITEM_COUNT) {
+                if (queue.empty())
+                    continue;
+
+                auto v = queue.pop();
+                REQUIRE(v);
+                REQUIRE(*v == ITEM_VALUE);
+                ++i;
+            }
+        });
+
+        std::thread producer1([&] {
+            for (size_t i = 0; i < ITEM_COUNT / 2; ++i) queue.push(ITEM_VALUE);
+        });
+
+        std::thread producer2([&] {
+            for (size_t i = 0; i < ITEM_COUNT / 2; ++i) queue.push(ITEM_VALUE);
+        });
+
+        consumer.join();
+        producer1.join();
+        producer2.join();
+
+        REQUIRE(queue.empty());
+    }
+
+    SECTION("pop_wait returns std::nullopt after clear") {
+        queue.clear();
+
+        std::atomic<bool> is_returned {false};
+        std::thread consumer([&] {
+            auto v = queue.pop_wait();
+            REQUIRE(v == std::nullopt);
+            is_returned = true;
+        });
+
+        while (!is_returned) queue.clear();
+        REQUIRE(queue.empty());
+
+        consumer.join();
+    }
+
+    SECTION("The consumer waits for the producers and keeps the order of each producer") {
+        queue.clear();
+
+        std::thread consumer([&] {
+            int last[2] {-1, -1};
+            for (size_t i = 0; i < ITEM_COUNT; ++i) {
+                auto v = queue.pop_wait();
+                REQUIRE(v);
+
+                const int producer = *v % 2;
+                REQUIRE(*v / 2 > last[producer]);
+                last[producer] = *v / 2;
+            }
+        });
+
+        std::thread producer1([&] {
+            for (int i = 0; i < static_cast<int>(ITEM_COUNT / 2); ++i) queue.push(i * 2);
+        });
+
+        std::thread producer2([&] {
+            for (int i = 0; i < static_cast<int>(ITEM_COUNT / 2); ++i) queue.push(i * 2 + 1);
+        });
+
+        consumer.join();
+        producer1.join();
+        producer2.join();
+
+        REQUIRE(queue.empty());
+    }
+}
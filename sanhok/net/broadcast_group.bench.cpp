@@ -0,0 +1,107 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/broadcast_group.hpp>
+#include <sanhok/net/builder_pool.hpp>
+#include <sanhok/net/listener_tcp.hpp>
+#include <tests/hello.hpp>
+
+#include <chrono>
+#include <thread>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+using namespace std::chrono_literals;
+
+namespace {
+constexpr unsigned short LISTEN_PORT {50120};
+constexpr size_t PEERS = 1000;
+constexpr size_t MESSAGES = 100;
+
+/*
+ * PEERS connections over loopback; the server side of each is in the broadcast group
+ * Messages are sent from the benchmark thread while the io_context runs on its own thread, like a game loop.
+ */
+class FanOut {
+public:
+    FanOut() {
+        listener_.start();
+
+        for (size_t i = 0; i < PEERS; ++i) {
+            clients_.push_back(std::make_unique<PeerTCP>(ctx_, tcp::socket {ctx_}, [this](MessageBuffer&&) {
+                ++received_;
+            }));
+            clients_.back()->set_handler_dispatch(HandlerDispatch::inline_io());
+            co_spawn(ctx_, [client = clients_.back().get()]()->boost::asio::awaitable<void> {
+                co_await client->connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LISTEN_PORT));
+                client->run();
+            }, boost::asio::detached);
+        }
+
+        while (group_.size() < PEERS) ctx_.run_for(1ms);
+        listener_.stop();
+
+        io_thread_ = std::thread([this] { ctx_.run(); });
+    }
+
+    ~FanOut() {
+        work_guard_.reset();
+        ctx_.stop();
+        io_thread_.join();
+
+        for (const auto& server : servers_) group_.remove(*server);
+        for (const auto& client : clients_) client->disconnect();
+        for (const auto& server : servers_) server->disconnect();
+    }
+
+    template <typename Send>
+    void send(Send send) {
+        received_ = 0;
+        for (size_t i = 0; i < MESSAGES; ++i) {
+            auto builder = builder_pool_.acquire();
+            builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString(std::string(64, 'a'))));
+            send(BuilderPool::release(*builder));
+        }
+
+        while (received_ < PEERS * MESSAGES) std::this_thread::sleep_for(100us);
+    }
+
+    BroadcastGroup& group() { return group_; }
+    const std::vector<std::unique_ptr<PeerTCP>>& servers() const { return servers_; }
+
+private:
+    boost::asio::io_context ctx_ {};
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard_ {make_work_guard(ctx_)};
+    std::thread io_thread_ {};
+    BuilderPool builder_pool_ {};
+    BroadcastGroup group_ {};
+    std::vector<std::unique_ptr<PeerTCP>> servers_ {};
+    std::vector<std::unique_ptr<PeerTCP>> clients_ {};
+    std::atomic<size_t> received_ {0};
+
+    ListenerTCP listener_ {
+        ctx_, LISTEN_PORT,
+        [this](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            servers_.push_back(std::make_unique<PeerTCP>(ctx, std::move(socket),
+                std::function<void(std::vector<uint8_t>&&)> {}));
+            group_.add(*servers_.back());
+        }
+    };
+};
+}
+
+TEST_CASE("[BroadcastGroup]") {
+    FanOut fan_out {};
+
+    BENCHMARK("send_message per peer; 100 messages to 1000 peers") {
+        fan_out.send([&fan_out](const MessageBuffer& message) {
+            for (const auto& server : fan_out.servers()) server->send_message(message);
+        });
+    };
+
+    BENCHMARK("BroadcastGroup; 100 messages to 1000 peers") {
+        fan_out.send([&fan_out](MessageBuffer&& message) {
+            fan_out.group().broadcast(std::move(message));
+        });
+    };
+}
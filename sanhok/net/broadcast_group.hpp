@@ -0,0 +1,145 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <sanhok/net/peer_tcp.hpp>
+#include <sanhok/net/send_buffer.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace sanhok::net {
+/*
+ * A set of PeerTCP to send the same message to
+ * The peers are grouped by their io_context. A broadcast appends the message to each io_context's pending
+ * messages and posts a batch there unless one is pending already; the batch writes every pending message to
+ * each peer on the io thread, straight to the socket in one gather write for a peer that is not writing yet.
+ * The calling thread does no work per peer, and broadcasts in a burst share the writes.
+ * A peer has to be removed before it is destroyed; remove() returns once no batch is sending to it anymore,
+ * so it must not be called from the QueueLimits callbacks of a peer in the group.
+ */
+class BroadcastGroup final : boost::noncopyable {
+public:
+    BroadcastGroup() = default;
+    ~BroadcastGroup() = default;
+
+    void add(PeerTCP& peer);
+    void remove(PeerTCP& peer);
+    void broadcast(std::shared_ptr<flatbuffers::DetachedBuffer> message);
+    void broadcast(MessageBuffer message);
+
+    size_t size() const;
+
+private:
+    using Peers = std::vector<PeerTCP*>;
+
+    // Shared with the posted batches, which may run after the group is gone
+    struct ContextPeers {
+        boost::asio::io_context* ctx;
+        std::shared_ptr<const Peers> peers; // Replaced on every change; a running batch keeps the one it took
+        std::mutex mutex {};
+        std::vector<SendBuffer> pending {}; // Broadcast since the last batch took them
+        bool batch_posted {false};
+        std::atomic<size_t> running {0}; // Batches sending to the peers they took
+    };
+
+    void broadcast(SendBuffer&& message);
+    static void send_batch(ContextPeers& context);
+
+    mutable std::mutex mutex_ {};
+    std::vector<std::shared_ptr<ContextPeers>> contexts_ {};
+};
+
+inline void BroadcastGroup::add(PeerTCP& peer) {
+    std::lock_guard lock {mutex_};
+
+    auto it = std::ranges::find(contexts_, &peer.context(), [](const auto& context) { return context->ctx; });
+    if (it == contexts_.end()) {
+        contexts_.push_back(std::make_shared<ContextPeers>(&peer.context(), std::make_shared<const Peers>()));
+        it = std::prev(contexts_.end());
+    }
+
+    ContextPeers& context = **it;
+    std::lock_guard context_lock {context.mutex};
+    if (std::ranges::find(*context.peers, &peer) != context.peers->end()) return;
+
+    auto peers = std::make_shared<Peers>(*context.peers);
+    peers->push_back(&peer);
+    context.peers = std::move(peers);
+}
+
+inline void BroadcastGroup::remove(PeerTCP& peer) {
+    std::shared_ptr<ContextPeers> context {};
+    {
+        std::lock_guard lock {mutex_};
+
+        auto it = std::ranges::find(contexts_, &peer.context(), [](const auto& context) { return context->ctx; });
+        if (it == contexts_.end()) return;
+        context = *it;
+
+        std::lock_guard context_lock {context->mutex};
+        auto peers = std::make_shared<Peers>(*context->peers);
+        if (std::erase(*peers, &peer) == 0) return;
+        if (peers->empty()) contexts_.erase(it);
+        context->peers = std::move(peers);
+    }
+
+    // A batch that took the peers before the change may still be sending to this one
+    for (size_t running = context->running.load(); running > 0; running = context->running.load()) {
+        context->running.wait(running);
+    }
+}
+
+inline void BroadcastGroup::broadcast(std::shared_ptr<flatbuffers::DetachedBuffer> message) {
+    broadcast(SendBuffer {std::move(message)});
+}
+
+inline void BroadcastGroup::broadcast(MessageBuffer message) {
+    broadcast(SendBuffer {std::move(message)});
+}
+
+inline void BroadcastGroup::broadcast(SendBuffer&& message) {
+    if (!message) return;
+
+    std::lock_guard lock {mutex_};
+    for (const auto& context : contexts_) {
+        std::lock_guard context_lock {context->mutex};
+        context->pending.push_back(message);
+        if (std::exchange(context->batch_posted, true)) continue;
+        post(*context->ctx, [context] { send_batch(*context); });
+    }
+}
+
+// Takes the peers when it runs rather than when posted, so that a removed peer is never sent to
+inline void BroadcastGroup::send_batch(ContextPeers& context) {
+    std::shared_ptr<const Peers> peers {};
+    std::vector<SendBuffer> messages {};
+    {
+        std::lock_guard lock {context.mutex};
+        peers = context.peers;
+        messages.swap(context.pending);
+        context.batch_posted = false;
+        ++context.running;
+    }
+
+    for (PeerTCP* peer : *peers) peer->send_shared(messages);
+
+    if (--context.running == 0) context.running.notify_all();
+}
+
+inline size_t BroadcastGroup::size() const {
+    std::lock_guard lock {mutex_};
+
+    size_t size {0};
+    for (const auto& context : contexts_) {
+        std::lock_guard context_lock {context->mutex};
+        size += context->peers->size();
+    }
+    return size;
+}
+}
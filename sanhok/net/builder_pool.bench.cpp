@@ -0,0 +1,50 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/builder_pool.hpp>
+#include <sanhok/net/send_buffer.hpp>
+#include <tests/hello.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+
+namespace {
+constexpr size_t MESSAGES = 100000;
+constexpr size_t IN_FLIGHT = 64;
+const std::string TEXT(100, 'a');
+
+// Keeps IN_FLIGHT messages queued like a send queue, dropping the oldest as if its write completed
+template <typename Build>
+void build_messages(Build build) {
+    std::vector<SendBuffer> queue {};
+    queue.reserve(IN_FLIGHT);
+
+    for (size_t i = 0; i < MESSAGES; ++i) {
+        if (queue.size() == IN_FLIGHT) queue.clear();
+        queue.push_back(build());
+    }
+}
+}
+
+TEST_CASE("[BuilderPool]") {
+    BuilderPool builder_pool {};
+
+    BENCHMARK("FlatBufferBuilder, DetachedBuffer and make_shared; 100000 Hello of 100 characters") {
+        build_messages([] {
+            flatbuffers::FlatBufferBuilder builder {256};
+            builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(TEXT)));
+            return SendBuffer {std::make_shared<flatbuffers::DetachedBuffer>(builder.Release())};
+        });
+    };
+
+    BENCHMARK("BuilderPool and MessageBuffer; 100000 Hello of 100 characters") {
+        build_messages([&builder_pool] {
+            auto builder = builder_pool.acquire();
+            builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString(TEXT)));
+            return SendBuffer {BuilderPool::release(*builder)};
+        });
+    };
+}
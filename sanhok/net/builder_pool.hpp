@@ -0,0 +1,90 @@
+#pragma once
+
+#include <flatbuffers/flatbuffers.h>
+#include <sanhok/buffer_pool.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sanhok::net {
+/*
+ * A flatbuffers::Allocator drawing from a BufferPool
+ */
+class PooledAllocator final : public flatbuffers::Allocator {
+public:
+    explicit PooledAllocator(BufferPool& buffer_pool) : buffer_pool_(buffer_pool) {}
+
+    uint8_t* allocate(const size_t size) override { return buffer_pool_.acquire(size).release(); }
+    void deallocate(uint8_t* p, size_t) override { MessageBuffer::adopt(p, 0, 0); }
+
+private:
+    BufferPool& buffer_pool_;
+};
+
+/*
+ * Recycles FlatBufferBuilders whose buffers come from a BufferPool
+ * A finished message is taken out of a builder with release() as a MessageBuffer,
+ * which PeerTCP and PeerUDP send without copying and return to the pool when the write completes.
+ * Builders allocate through the BuilderPool and go back to it, so it has to outlive them. Released messages only
+ * hold their BufferPool, which has to outlive both.
+ */
+class BuilderPool {
+public:
+    struct Recycler {
+        void operator()(flatbuffers::FlatBufferBuilder* builder) const { pool->recycle(builder); }
+        BuilderPool* pool;
+    };
+    using Builder = std::unique_ptr<flatbuffers::FlatBufferBuilder, Recycler>;
+
+    explicit BuilderPool(BufferPool& buffer_pool, size_t initial_size, size_t max_builders);
+    ~BuilderPool() = default;
+    BuilderPool(const BuilderPool&) = delete;
+    BuilderPool& operator=(const BuilderPool&) = delete;
+
+    Builder acquire();
+    static MessageBuffer release(flatbuffers::FlatBufferBuilder& builder);
+
+private:
+    void recycle(flatbuffers::FlatBufferBuilder* builder);
+
+    PooledAllocator allocator_;
+    const size_t initial_size_;
+    const size_t max_builders_;
+
+    std::mutex mutex_ {};
+    std::vector<std::unique_ptr<flatbuffers::FlatBufferBuilder>> builders_ {};
+};
+
+inline BuilderPool::BuilderPool(BufferPool& buffer_pool = BufferPool::shared(), const size_t initial_size = 1024,
+    const size_t max_builders = 64)
+    : allocator_(buffer_pool), initial_size_(initial_size), max_builders_(max_builders) {}
+
+inline BuilderPool::Builder BuilderPool::acquire() {
+    {
+        std::lock_guard lock {mutex_};
+        if (!builders_.empty()) {
+            auto builder = std::move(builders_.back());
+            builders_.pop_back();
+            return Builder {builder.release(), Recycler {this}};
+        }
+    }
+
+    return Builder {new flatbuffers::FlatBufferBuilder(initial_size_, &allocator_, false), Recycler {this}};
+}
+
+// Takes the finished message out of a builder of a BuilderPool; the builder can be reused afterward
+inline MessageBuffer BuilderPool::release(flatbuffers::FlatBufferBuilder& builder) {
+    size_t allocated, offset;
+    uint8_t* allocation = builder.ReleaseRaw(allocated, offset);
+    return MessageBuffer::adopt(allocation, offset, allocated - offset);
+}
+
+inline void BuilderPool::recycle(flatbuffers::FlatBufferBuilder* builder) {
+    std::unique_ptr<flatbuffers::FlatBufferBuilder> owned {builder};
+    owned->Clear();
+
+    std::lock_guard lock {mutex_};
+    if (builders_.size() < max_builders_) builders_.push_back(std::move(owned));
+}
+}
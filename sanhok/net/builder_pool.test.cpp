@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/builder_pool.hpp>
+#include <tests/hello.hpp>
+
+#include <string>
+#include <string_view>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+
+TEST_CASE("[BuilderPool]") {
+    constexpr std::string_view MESSAGE = "Hello";
+
+    BufferPool buffer_pool {};
+    BuilderPool builder_pool {buffer_pool, 256};
+
+    const auto build = [&builder_pool, &MESSAGE] {
+        auto builder = builder_pool.acquire();
+        builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString(MESSAGE)));
+        return BuilderPool::release(*builder);
+    };
+
+    SECTION("release takes the finished message out of the builder") {
+        const auto message = build();
+
+        flatbuffers::Verifier verifier {message.data(), message.size()};
+        REQUIRE(VerifySizePrefixedHelloBuffer(verifier));
+        REQUIRE(GetSizePrefixedHello(message.data())->hello()->str() == MESSAGE);
+        REQUIRE(message.size() == flatbuffers::GetSizePrefixedBufferLength(message.data()));
+    }
+
+    SECTION("Builders and their buffers are recycled") {
+        const flatbuffers::FlatBufferBuilder* first;
+        {
+            auto builder = builder_pool.acquire();
+            first = builder.get();
+        }
+        REQUIRE(builder_pool.acquire().get() == first);
+
+        const uint8_t* data;
+        {
+            const auto message = build();
+            data = message.data();
+        }
+        const auto misses = buffer_pool.stats().misses;
+
+        const auto message = build();
+        REQUIRE(message.data() == data);
+        REQUIRE(buffer_pool.stats().misses == misses);
+    }
+
+    SECTION("A message outgrowing the initial size hands the buffers it grew out of back to the pool") {
+        const std::string long_message(4000, 'a');
+        const auto build_long = [&builder_pool, &long_message] {
+            auto builder = builder_pool.acquire();
+            builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString(long_message)));
+            return BuilderPool::release(*builder);
+        };
+
+        {
+            const auto message = build_long();
+            REQUIRE(message.size() == flatbuffers::GetSizePrefixedBufferLength(message.data()));
+            REQUIRE(GetSizePrefixedHello(message.data())->hello()->str() == long_message);
+        }
+        const auto misses = buffer_pool.stats().misses;
+
+        // Every buffer of the second build is one the first build gave back
+        const auto message = build_long();
+        REQUIRE(GetSizePrefixedHello(message.data())->hello()->str() == long_message);
+        REQUIRE(buffer_pool.stats().misses == misses);
+    }
+
+    SECTION("A builder dropped unfinished hands its buffer back to the pool") {
+        BuilderPool unpooled {buffer_pool, 256, 0};
+        const auto build_unfinished = [&unpooled, &MESSAGE] {
+            auto builder = unpooled.acquire();
+            builder->CreateString(MESSAGE);
+        };
+
+        build_unfinished();
+        const auto misses = buffer_pool.stats().misses;
+        build_unfinished();
+        REQUIRE(buffer_pool.stats().misses == misses);
+    }
+
+    SECTION("release and adopt keep the offset and size of a message") {
+        auto message = build();
+        const uint8_t* data = message.data();
+        const size_t size = message.size();
+
+        uint8_t* allocation = message.release();
+        REQUIRE(!message);
+        REQUIRE(data > allocation);
+
+        auto adopted = MessageBuffer::adopt(allocation, data - allocation, size);
+        REQUIRE(adopted.data() == data);
+        REQUIRE(adopted.size() == size);
+        REQUIRE(adopted.use_count() == 1);
+        REQUIRE(GetSizePrefixedHello(adopted.data())->hello()->str() == MESSAGE);
+
+        const auto copy = adopted;
+        REQUIRE(adopted.use_count() == 2);
+    }
+}
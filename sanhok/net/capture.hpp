@@ -0,0 +1,261 @@
+#pragma once
+
+#include <boost/core/noncopyable.hpp>
+#include <sanhok/net/log.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sanhok::net {
+enum class CaptureProtocol : uint32_t {
+    TCP = 1,
+    UDP = 2,
+};
+
+// A frame as received: a size-prefixed message of PeerTCP or a packet of PeerUDP
+struct CaptureFrame {
+    std::chrono::nanoseconds timestamp; // Since the capture was opened
+    uint64_t peer_id;
+    CaptureProtocol protocol;
+    std::span<const uint8_t> data;
+};
+
+/*
+ * An append-only capture of received frames in a memory-mapped file, shared by any number of peers
+ * The file is sized and its pages faulted in on open, so that appending is a reservation with one atomic add
+ * and a copy of the frame into the mapping, without a syscall on the I/O thread. Frames that don't fit anymore
+ * are counted and dropped, as are empty ones. Close it after the peers appending to it are gone.
+ *
+ * The file is a CaptureHeader and then records back to back, each a CaptureRecord, the frame and padding to
+ * 8 bytes. A record is complete once its size is set, so a capture cut short ends at the first zero size.
+ */
+class CaptureFile final : boost::noncopyable {
+public:
+    static constexpr char MAGIC[8] {'S', 'N', 'K', 'C', 'A', 'P', '0', '1'};
+
+    struct CaptureHeader {
+        char magic[8];
+        uint64_t records_size; // Bytes of records, set on close
+    };
+
+    struct CaptureRecord {
+        uint64_t timestamp;
+        uint64_t peer_id;
+        uint32_t size; // Of the frame; written last
+        CaptureProtocol protocol;
+    };
+
+    CaptureFile() = default;
+    ~CaptureFile();
+
+    // Creates or truncates the file with room for capacity bytes of records
+    bool open(const std::string& path, size_t capacity);
+    void close();
+    void append(uint64_t peer_id, CaptureProtocol protocol, std::span<const uint8_t> frame);
+
+    bool is_open() const { return map_ != nullptr; }
+    // Bytes of records appended
+    size_t size() const { return std::min(end_.load(std::memory_order_relaxed), capacity_); }
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static constexpr size_t record_size(const size_t frame_size) {
+        return (sizeof(CaptureRecord) + frame_size + 7) & ~size_t {7};
+    }
+
+private:
+    int fd_ {-1};
+    uint8_t* map_ {nullptr};
+    size_t capacity_ {0};
+    std::chrono::steady_clock::time_point opened_at_ {};
+
+    std::atomic<size_t> end_ {0};
+    std::atomic<size_t> dropped_ {0};
+};
+
+/*
+ * Reads the frames of a capture in the order they were appended, straight from a read-only mapping
+ */
+class CaptureReader final : boost::noncopyable {
+public:
+    CaptureReader() = default;
+    ~CaptureReader();
+
+    bool open(const std::string& path);
+    void close();
+    // The frame refers to the mapping and stays valid until close
+    std::optional<CaptureFrame> next();
+    void rewind() { offset_ = sizeof(CaptureFile::CaptureHeader); }
+
+    bool is_open() const { return map_ != nullptr; }
+
+private:
+    uint8_t* map_ {nullptr};
+    size_t size_ {0};
+    size_t offset_ {0};
+};
+
+inline CaptureFile::~CaptureFile() {
+    close();
+}
+
+inline bool CaptureFile::open(const std::string& path, const size_t capacity) {
+    if (is_open()) {
+        SANHOK_LOG_ERROR("[CaptureFile] Already open");
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        SANHOK_LOG_ERROR("[CaptureFile] Error opening {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    capacity_ = capacity;
+    const size_t file_size = sizeof(CaptureHeader) + capacity_;
+    if (::ftruncate(fd_, static_cast<off_t>(file_size)) != 0) {
+        SANHOK_LOG_ERROR("[CaptureFile] Error sizing {} to {} bytes: {}", path, file_size, std::strerror(errno));
+        close();
+        return false;
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* map = ::mmap(nullptr, file_size, PROT_READ | PROT_WRITE, flags, fd_, 0);
+    if (map == MAP_FAILED) {
+        SANHOK_LOG_ERROR("[CaptureFile] Error mapping {}: {}", path, std::strerror(errno));
+        close();
+        return false;
+    }
+
+    map_ = static_cast<uint8_t*>(map);
+    std::memcpy(map_, MAGIC, sizeof(MAGIC));
+    end_ = 0;
+    dropped_ = 0;
+    opened_at_ = std::chrono::steady_clock::now();
+    return true;
+}
+
+inline void CaptureFile::close() {
+    if (map_) {
+        const size_t records_size = size();
+        std::memcpy(map_ + offsetof(CaptureHeader, records_size), &records_size, sizeof(records_size));
+        ::munmap(map_, sizeof(CaptureHeader) + capacity_);
+        map_ = nullptr;
+
+        // Gives back the room that was never used
+        if (::ftruncate(fd_, static_cast<off_t>(sizeof(CaptureHeader) + records_size)) != 0) {
+            SANHOK_LOG_WARN("[CaptureFile] Error truncating: {}", std::strerror(errno));
+        }
+    }
+
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+inline void CaptureFile::append(const uint64_t peer_id, const CaptureProtocol protocol,
+    const std::span<const uint8_t> frame) {
+    // A zero size marks the end of the records
+    if (frame.empty()) return;
+
+    const size_t size = record_size(frame.size());
+    const size_t offset = end_.fetch_add(size, std::memory_order_relaxed);
+    if (offset + size > capacity_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint8_t* record = map_ + sizeof(CaptureHeader) + offset;
+    const CaptureRecord header {
+        static_cast<uint64_t>((std::chrono::steady_clock::now() - opened_at_).count()), peer_id, 0, protocol,
+    };
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(CaptureRecord), frame.data(), frame.size());
+    std::atomic_ref {reinterpret_cast<CaptureRecord*>(record)->size}.store(static_cast<uint32_t>(frame.size()),
+        std::memory_order_release);
+}
+
+inline CaptureReader::~CaptureReader() {
+    close();
+}
+
+inline bool CaptureReader::open(const std::string& path) {
+    if (is_open()) {
+        SANHOK_LOG_ERROR("[CaptureReader] Already open");
+        return false;
+    }
+
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        SANHOK_LOG_ERROR("[CaptureReader] Error opening {}: {}", path, std::strerror(errno));
+        return false;
+    }
+
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(CaptureFile::CaptureHeader)) {
+        SANHOK_LOG_ERROR("[CaptureReader] {} is not a capture", path);
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        SANHOK_LOG_ERROR("[CaptureReader] Error mapping {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(map);
+
+    if (std::memcmp(map_, CaptureFile::MAGIC, sizeof(CaptureFile::MAGIC)) != 0) {
+        SANHOK_LOG_ERROR("[CaptureReader] {} is not a capture", path);
+        close();
+        return false;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    ::madvise(map_, size_, MADV_SEQUENTIAL);
+#endif
+    rewind();
+    return true;
+}
+
+inline void CaptureReader::close() {
+    if (!map_) return;
+
+    ::munmap(map_, size_);
+    map_ = nullptr;
+    size_ = 0;
+}
+
+inline std::optional<CaptureFrame> CaptureReader::next() {
+    if (!map_ || offset_ + sizeof(CaptureFile::CaptureRecord) > size_) return std::nullopt;
+
+    CaptureFile::CaptureRecord record {};
+    std::memcpy(&record, map_ + offset_, sizeof(record));
+    if (record.size == 0 || offset_ + CaptureFile::record_size(record.size) > size_) return std::nullopt;
+
+    const CaptureFrame frame {
+        std::chrono::nanoseconds {record.timestamp}, record.peer_id, record.protocol,
+        {map_ + offset_ + sizeof(record), record.size},
+    };
+    offset_ += CaptureFile::record_size(record.size);
+    return frame;
+}
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/capture.hpp>
+
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sanhok::net;
+
+namespace {
+std::span<const uint8_t> bytes(const std::string& text) {
+    return {reinterpret_cast<const uint8_t*>(text.data()), text.size()};
+}
+
+std::string text(const std::span<const uint8_t> data) {
+    return {reinterpret_cast<const char*>(data.data()), data.size()};
+}
+}
+
+TEST_CASE("[CaptureFile]") {
+    const std::string path = (std::filesystem::temp_directory_path() / "sanhok_capture.test").string();
+
+    CaptureFile capture {};
+    CaptureReader reader {};
+
+    SECTION("Frames are read back in order with their peer and protocol") {
+        REQUIRE(capture.open(path, 4096));
+        capture.append(1, CaptureProtocol::TCP, bytes("Hello"));
+        capture.append(2, CaptureProtocol::UDP, bytes("World!"));
+        capture.append(1, CaptureProtocol::TCP, {});
+        REQUIRE(capture.size() == CaptureFile::record_size(5) + CaptureFile::record_size(6));
+        capture.close();
+        REQUIRE(std::filesystem::file_size(path) == sizeof(CaptureFile::CaptureHeader) + capture.size());
+
+        REQUIRE(reader.open(path));
+        const auto first = reader.next();
+        REQUIRE(first);
+        REQUIRE(first->peer_id == 1);
+        REQUIRE(first->protocol == CaptureProtocol::TCP);
+        REQUIRE(text(first->data) == "Hello");
+
+        const auto second = reader.next();
+        REQUIRE(second);
+        REQUIRE(second->peer_id == 2);
+        REQUIRE(second->protocol == CaptureProtocol::UDP);
+        REQUIRE(text(second->data) == "World!");
+        REQUIRE(second->timestamp >= first->timestamp);
+        REQUIRE(!reader.next());
+
+        reader.rewind();
+        REQUIRE(text(reader.next()->data) == "Hello");
+    }
+
+    SECTION("Frames that don't fit are dropped") {
+        REQUIRE(capture.open(path, CaptureFile::record_size(5) * 2));
+        for (int i = 0; i < 3; ++i) capture.append(1, CaptureProtocol::UDP, bytes("Hello"));
+        REQUIRE(capture.dropped() == 1);
+        capture.close();
+
+        REQUIRE(reader.open(path));
+        int frames {0};
+        while (reader.next()) ++frames;
+        REQUIRE(frames == 2);
+    }
+
+    SECTION("Peers on several threads append to one capture") {
+        constexpr int THREADS = 4;
+        constexpr int FRAMES = 1000;
+        REQUIRE(capture.open(path, CaptureFile::record_size(8) * THREADS * FRAMES));
+
+        std::vector<std::thread> threads {};
+        for (int t = 0; t < THREADS; ++t) {
+            threads.emplace_back([&capture, t] {
+                for (int i = 0; i < FRAMES; ++i) capture.append(t, CaptureProtocol::TCP, bytes(std::to_string(10000000 + i)));
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        capture.close();
+
+        REQUIRE(reader.open(path));
+        std::vector<int> next(THREADS, 0);
+        while (const auto frame = reader.next()) {
+            REQUIRE(std::stoi(text(frame->data)) == 10000000 + next[frame->peer_id]++);
+        }
+        REQUIRE(next == std::vector<int>(THREADS, FRAMES));
+    }
+
+    reader.close();
+    std::filesystem::remove(path);
+}
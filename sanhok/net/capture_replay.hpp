@@ -0,0 +1,141 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <sanhok/buffer_pool.hpp>
+#include <sanhok/net/capture.hpp>
+#include <sanhok/net/log.hpp>
+#include <sanhok/net/peer_tcp.hpp>
+#include <sanhok/net/peer_udp.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+namespace sanhok::net {
+/*
+ * Sends the frames of a capture to a server, through a PeerTCP or a PeerUDP per captured peer
+ * At the recorded pace each frame waits as long after the start of the replay as it came after the first frame,
+ * however late that was in the capture; as fast as possible, the frames go out back to back, with a turn of the
+ * io_context every few frames so that the peers write.
+ * Run it on the io_context of the peers and keep it alive until their sends are done.
+ */
+class CaptureReplay final : boost::noncopyable {
+public:
+    enum class Pace {
+        Recorded,
+        AsFastAsPossible,
+    };
+
+    CaptureReplay(boost::asio::io_context& ctx, CaptureReader& reader, Pace pace);
+    ~CaptureReplay();
+
+    // Takes the endpoints by value, as the coroutine may outlive the arguments
+    boost::asio::awaitable<void> replay(tcp::endpoint tcp_endpoint, udp::endpoint udp_endpoint);
+
+    size_t frames() const { return frames_; }
+    size_t bytes() const { return bytes_; }
+    // Frames of peers that failed to connect
+    size_t skipped() const { return skipped_; }
+
+private:
+    static constexpr size_t FRAMES_PER_TURN {64};
+
+    boost::asio::awaitable<PeerTCP*> tcp_peer(uint64_t peer_id, const tcp::endpoint& endpoint);
+    PeerUDP* udp_peer(uint64_t peer_id, const udp::endpoint& endpoint);
+
+    boost::asio::io_context& ctx_;
+    CaptureReader& reader_;
+    const Pace pace_;
+
+    // nullptr for a peer that failed to connect
+    std::unordered_map<uint64_t, std::unique_ptr<PeerTCP>> tcp_peers_ {};
+    std::unordered_map<uint64_t, std::unique_ptr<PeerUDP>> udp_peers_ {};
+
+    size_t frames_ {0};
+    size_t bytes_ {0};
+    size_t skipped_ {0};
+};
+
+inline CaptureReplay::CaptureReplay(boost::asio::io_context& ctx, CaptureReader& reader,
+    const Pace pace = Pace::Recorded)
+    : ctx_(ctx), reader_(reader), pace_(pace) {}
+
+inline CaptureReplay::~CaptureReplay() {
+    for (const auto& [_, peer] : tcp_peers_) {
+        if (peer) peer->disconnect();
+    }
+    for (const auto& [_, peer] : udp_peers_) {
+        if (peer) peer->close();
+    }
+}
+
+inline boost::asio::awaitable<void> CaptureReplay::replay(const tcp::endpoint tcp_endpoint,
+    const udp::endpoint udp_endpoint) {
+    using Clock = std::chrono::steady_clock;
+
+    reader_.rewind();
+    boost::asio::steady_timer timer {ctx_};
+    const auto started_at = Clock::now();
+    std::optional<std::chrono::nanoseconds> first_timestamp {};
+
+    while (const auto frame = reader_.next()) {
+        if (pace_ == Pace::Recorded) {
+            if (!first_timestamp) first_timestamp = frame->timestamp;
+            if (const auto due_at = started_at + (frame->timestamp - *first_timestamp); due_at > Clock::now()) {
+                timer.expires_at(due_at);
+                co_await timer.async_wait(as_tuple(boost::asio::use_awaitable));
+            }
+        } else if (frames_ % FRAMES_PER_TURN == FRAMES_PER_TURN - 1) {
+            co_await post(ctx_, boost::asio::use_awaitable);
+        }
+
+        auto message = BufferPool::shared().acquire(frame->data.size());
+        std::memcpy(message.data(), frame->data.data(), frame->data.size());
+
+        if (frame->protocol == CaptureProtocol::TCP) {
+            PeerTCP* peer = co_await tcp_peer(frame->peer_id, tcp_endpoint);
+            if (!peer) {
+                ++skipped_;
+                continue;
+            }
+            peer->send_message(std::move(message));
+        } else {
+            udp_peer(frame->peer_id, udp_endpoint)->send_packet(std::move(message));
+        }
+
+        ++frames_;
+        bytes_ += frame->data.size();
+    }
+}
+
+inline boost::asio::awaitable<PeerTCP*> CaptureReplay::tcp_peer(const uint64_t peer_id,
+    const tcp::endpoint& endpoint) {
+    if (const auto it = tcp_peers_.find(peer_id); it != tcp_peers_.end()) co_return it->second.get();
+
+    auto peer = std::make_unique<PeerTCP>(ctx_, tcp::socket {ctx_}, [](MessageBuffer&&) {});
+    peer->set_handler_dispatch(HandlerDispatch::inline_io());
+    if (!co_await peer->connect(endpoint)) {
+        SANHOK_LOG_ERROR("[CaptureReplay] Error connecting peer {} to {}:{}", peer_id,
+            endpoint.address().to_string(), endpoint.port());
+        peer.reset();
+    } else {
+        peer->run();
+    }
+
+    co_return tcp_peers_.emplace(peer_id, std::move(peer)).first->second.get();
+}
+
+inline PeerUDP* CaptureReplay::udp_peer(const uint64_t peer_id, const udp::endpoint& endpoint) {
+    auto& peer = udp_peers_[peer_id];
+    if (peer) return peer.get();
+
+    peer = std::make_unique<PeerUDP>(ctx_, udp::endpoint {endpoint.protocol(), 0}, [](std::span<const uint8_t>) {});
+    peer->set_handler_dispatch(HandlerDispatch::inline_io());
+    peer->connect(endpoint);
+    peer->open();
+    return peer.get();
+}
+}
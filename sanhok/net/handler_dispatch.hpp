@@ -0,0 +1,35 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+namespace sanhok::net {
+/*
+ * Where PeerTCP and PeerUDP run their message handlers
+ */
+class HandlerDispatch final {
+public:
+    enum class Mode {
+        DedicatedThread, // A thread per peer waiting on its receive queue
+        Inline, // The io_context thread that received the message
+        Executor, // A shared executor, e.g. boost::asio::thread_pool, keeping the order per peer with a strand
+    };
+
+    static HandlerDispatch dedicated_thread() { return HandlerDispatch {Mode::DedicatedThread, {}}; }
+    static HandlerDispatch inline_io() { return HandlerDispatch {Mode::Inline, {}}; }
+
+    template <typename Executor>
+    static HandlerDispatch on(const Executor& executor) {
+        return HandlerDispatch {Mode::Executor, boost::asio::any_io_executor {executor}};
+    }
+
+    Mode mode() const { return mode_; }
+    const boost::asio::any_io_executor& executor() const { return executor_; }
+
+private:
+    HandlerDispatch(const Mode mode, boost::asio::any_io_executor executor)
+        : mode_(mode), executor_(std::move(executor)) {}
+
+    Mode mode_;
+    boost::asio::any_io_executor executor_;
+};
+}
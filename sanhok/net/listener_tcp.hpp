@@ -2,7 +2,9 @@
 
 #include <boost/asio.hpp>
 #include <boost/core/noncopyable.hpp>
-#include <spdlog/spdlog.h>
+#include <sanhok/net/log.hpp>
+#include <sanhok/net/metrics.hpp>
+#include <sanhok/net/socket_options.hpp>
 
 namespace sanhok::net {
 using boost::asio::ip::tcp;
@@ -10,26 +12,41 @@ using boost::asio::ip::tcp;
 class ListenerTCP final : boost::noncopyable {
 public:
     ListenerTCP(boost::asio::io_context& ctx, unsigned short port,
-        std::function<void(boost::asio::io_context&, tcp::socket&&)>&& on_acceptance);
-    ~ListenerTCP() = default;
+        std::function<void(boost::asio::io_context&, tcp::socket&&)>&& on_acceptance,
+        std::function<boost::asio::io_context&()>&& select_context, bool reuse_port);
+    ~ListenerTCP();
 
     void start();
     void stop();
 
+    boost::asio::io_context& context() const { return ctx_; }
+    const ListenerMetrics& metrics() const { return metrics_; }
+
 private:
+    static tcp::acceptor open_acceptor(boost::asio::io_context& ctx, unsigned short port, bool reuse_port);
     boost::asio::awaitable<void> listen();
 
     boost::asio::io_context& ctx_;
     tcp::acceptor acceptor_;
     std::function<void(boost::asio::io_context&, tcp::socket&&)> on_acceptance_;
+    std::function<boost::asio::io_context&()> select_context_; // Where accepted sockets run; ctx_ if empty
 
     std::atomic<bool> listening_ {false};
+
+    [[no_unique_address]] ListenerMetrics metrics_ {};
 };
 
 inline ListenerTCP::ListenerTCP(boost::asio::io_context& ctx, const unsigned short port,
-    std::function<void(boost::asio::io_context&, tcp::socket&&)>&& on_acceptance)
-    : ctx_(ctx), acceptor_(ctx, tcp::endpoint(tcp::v4(), port)),
-    on_acceptance_(std::move(on_acceptance)) {}
+    std::function<void(boost::asio::io_context&, tcp::socket&&)>&& on_acceptance,
+    std::function<boost::asio::io_context&()>&& select_context = {}, const bool reuse_port = false)
+    : ctx_(ctx), acceptor_(open_acceptor(ctx, port, reuse_port)),
+    on_acceptance_(std::move(on_acceptance)), select_context_(std::move(select_context)) {
+    MetricsRegistry::instance().add(metrics_);
+}
+
+inline ListenerTCP::~ListenerTCP() {
+    MetricsRegistry::instance().remove(metrics_);
+}
 
 inline void ListenerTCP::start() {
     listening_ = true;
@@ -42,24 +59,46 @@ inline void ListenerTCP::stop() {
     try {
         acceptor_.close();
     } catch (const boost::system::system_error& e) {
-        spdlog::error("[ListenerTCP] Error closing: {}", e.what());
+        SANHOK_LOG_ERROR("[ListenerTCP] Error closing: {}", e.what());
     }
 }
 
+inline tcp::acceptor ListenerTCP::open_acceptor(boost::asio::io_context& ctx, const unsigned short port,
+    const bool reuse_port) {
+    const tcp::endpoint endpoint {tcp::v4(), port};
+
+    tcp::acceptor acceptor {ctx};
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(tcp::acceptor::reuse_address(true));
+    if (reuse_port) {
+        // Lets an acceptor per io_context bind the same port; the kernel spreads connections over them
+        acceptor.set_option(ReusePort(true));
+    }
+    acceptor.bind(endpoint);
+    acceptor.listen();
+
+    return acceptor;
+}
+
 inline boost::asio::awaitable<void> ListenerTCP::listen() {
-    spdlog::info("[ListenerTCP] Starts accepting on {}:{}", acceptor_.local_endpoint().address().to_string(),
+    SANHOK_LOG_INFO("[ListenerTCP] Starts accepting on {}:{}", acceptor_.local_endpoint().address().to_string(),
         acceptor_.local_endpoint().port());
 
     while (listening_) {
-        tcp::socket socket {ctx_};
+        boost::asio::io_context& socket_ctx = select_context_ ? select_context_() : ctx_;
+        tcp::socket socket {socket_ctx};
 
         if (const auto [ec] = co_await acceptor_.async_accept(socket, as_tuple(boost::asio::use_awaitable)); ec) {
-            spdlog::error("[ListenerTCP] Error on accepting: {}", ec.what());
+            SANHOK_LOG_ERROR("[ListenerTCP] Error on accepting: {}", ec.what());
+            if (ec != boost::asio::error::operation_aborted) metrics_.accept_errors.add();
             continue;
         }
 
-        spdlog::info("[ListenerTCP] Accepts from {}:{}", socket.remote_endpoint().address().to_string(), socket.remote_endpoint().port());
-        on_acceptance_(ctx_, std::move(socket));
+        metrics_.accepts.add();
+        // Per connection, so it is debug; compiled away unless SANHOK_LOG_LEVEL goes down to it
+        SANHOK_LOG_DEBUG("[ListenerTCP] Accepts from {}:{}", socket.remote_endpoint().address().to_string(),
+            socket.remote_endpoint().port());
+        on_acceptance_(socket_ctx, std::move(socket));
     }
 }
 }
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <boost/core/noncopyable.hpp>
+#include <spdlog/async.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Levels below it compile away along with their arguments; one of SPDLOG_LEVEL_*
+#ifndef SANHOK_LOG_LEVEL
+#define SANHOK_LOG_LEVEL SPDLOG_LEVEL_INFO
+#endif
+
+// Evaluates and formats the arguments only when the logger of libnet takes the level
+#define SANHOK_LOG(level, ...) \
+    do { \
+        if (spdlog::logger& sanhok_logger = ::sanhok::net::Log::logger(); sanhok_logger.should_log(level)) { \
+            sanhok_logger.log(level, __VA_ARGS__); \
+        } \
+    } while (false)
+
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_TRACE
+#define SANHOK_LOG_TRACE(...) SANHOK_LOG(spdlog::level::trace, __VA_ARGS__)
+#else
+#define SANHOK_LOG_TRACE(...) (void)0
+#endif
+
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define SANHOK_LOG_DEBUG(...) SANHOK_LOG(spdlog::level::debug, __VA_ARGS__)
+#else
+#define SANHOK_LOG_DEBUG(...) (void)0
+#endif
+
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+#define SANHOK_LOG_INFO(...) SANHOK_LOG(spdlog::level::info, __VA_ARGS__)
+#else
+#define SANHOK_LOG_INFO(...) (void)0
+#endif
+
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+#define SANHOK_LOG_WARN(...) SANHOK_LOG(spdlog::level::warn, __VA_ARGS__)
+#else
+#define SANHOK_LOG_WARN(...) (void)0
+#endif
+
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_ERROR
+#define SANHOK_LOG_ERROR(...) SANHOK_LOG(spdlog::level::err, __VA_ARGS__)
+#else
+#define SANHOK_LOG_ERROR(...) (void)0
+#endif
+
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define SANHOK_LOG_CRITICAL(...) SANHOK_LOG(spdlog::level::critical, __VA_ARGS__)
+#else
+#define SANHOK_LOG_CRITICAL(...) (void)0
+#endif
+
+namespace sanhok::net {
+/*
+ * The logger libnet logs to through the SANHOK_LOG_* macros, the default spdlog logger unless set
+ * Set it before starting servers. A replaced logger stays alive, as I/O threads may still be logging to it.
+ */
+class Log final : boost::noncopyable {
+public:
+    static spdlog::logger& logger();
+    static void set_logger(std::shared_ptr<spdlog::logger> logger);
+
+    // Hands messages to a thread of its own through a bounded queue, writing to the sinks of the current logger.
+    // A full queue overwrites its oldest message, so I/O threads never wait on a sink.
+    static void set_async(size_t queue_size);
+    // Messages overwritten in the queue of the async logger
+    static size_t dropped();
+
+private:
+    Log() = default;
+    static Log& instance();
+
+    std::atomic<spdlog::logger*> logger_ {nullptr};
+
+    std::mutex mutex_ {};
+    std::vector<std::shared_ptr<spdlog::logger>> loggers_ {};
+    std::vector<std::shared_ptr<spdlog::details::thread_pool>> thread_pools_ {};
+};
+
+inline spdlog::logger& Log::logger() {
+    if (spdlog::logger* logger = instance().logger_.load(std::memory_order_acquire)) return *logger;
+    return *spdlog::default_logger_raw();
+}
+
+inline void Log::set_logger(std::shared_ptr<spdlog::logger> logger) {
+    Log& log = instance();
+    std::lock_guard lock {log.mutex_};
+
+    log.logger_.store(logger.get(), std::memory_order_release);
+    log.loggers_.push_back(std::move(logger));
+}
+
+inline void Log::set_async(const size_t queue_size = 8192) {
+    spdlog::logger& current = logger();
+    auto thread_pool = std::make_shared<spdlog::details::thread_pool>(queue_size, 1);
+    auto async_logger = std::make_shared<spdlog::async_logger>(current.name(), current.sinks().begin(),
+        current.sinks().end(), thread_pool, spdlog::async_overflow_policy::overrun_oldest);
+    async_logger->set_level(current.level());
+
+    {
+        Log& log = instance();
+        std::lock_guard lock {log.mutex_};
+        log.thread_pools_.push_back(std::move(thread_pool));
+    }
+    set_logger(std::move(async_logger));
+}
+
+inline size_t Log::dropped() {
+    Log& log = instance();
+    std::lock_guard lock {log.mutex_};
+    return log.thread_pools_.empty() ? 0 : log.thread_pools_.back()->overrun_counter();
+}
+
+inline Log& Log::instance() {
+    static Log log {};
+    return log;
+}
+}
@@ -0,0 +1,66 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/log.hpp>
+#include <spdlog/sinks/base_sink.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace sanhok::net;
+using namespace std::chrono_literals;
+
+namespace {
+// Counts messages, blocking on each one while held
+class HeldSink final : public spdlog::sinks::base_sink<std::mutex> {
+public:
+    std::atomic<bool> held {false};
+    std::atomic<size_t> count {0};
+
+protected:
+    void sink_it_(const spdlog::details::log_msg&) override {
+        while (held) std::this_thread::yield();
+        ++count;
+    }
+
+    void flush_() override {}
+};
+}
+
+TEST_CASE("[Log]") {
+    auto sink = std::make_shared<HeldSink>();
+    Log::set_logger(std::make_shared<spdlog::logger>("libnet", sink));
+
+    SECTION("Skips the arguments of levels that aren't logged") {
+        int evaluated {0};
+        SANHOK_LOG_TRACE("{}", ++evaluated);
+        SANHOK_LOG_DEBUG("{}", ++evaluated);
+#if SANHOK_LOG_LEVEL <= SPDLOG_LEVEL_INFO
+        Log::logger().set_level(spdlog::level::warn);
+        SANHOK_LOG_INFO("{}", ++evaluated);
+        SANHOK_LOG_WARN("{}", ++evaluated);
+        REQUIRE(evaluated == 1);
+        REQUIRE(sink->count == 1);
+#else
+        REQUIRE(evaluated == 0);
+#endif
+    }
+
+    SECTION("Async logging doesn't wait on a blocked sink") {
+        Log::set_async(16);
+
+        sink->held = true;
+        const auto started_at = std::chrono::steady_clock::now();
+        for (int i = 0; i < 1000; ++i) SANHOK_LOG(spdlog::level::err, "[Log] Message {}", i);
+        REQUIRE(std::chrono::steady_clock::now() - started_at < 1s);
+        REQUIRE(Log::dropped() > 0);
+
+        sink->held = false;
+        Log::logger().flush();
+        for (int i = 0; i < 100 && sink->count + Log::dropped() < 1000; ++i) std::this_thread::sleep_for(10ms);
+        REQUIRE(sink->count + Log::dropped() == 1000);
+    }
+
+    Log::set_logger(spdlog::default_logger());
+}
@@ -0,0 +1,61 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/message_dispatcher.hpp>
+#include <tests/ping_traits.hpp>
+#include <tests/pong_traits.hpp>
+
+#include <functional>
+#include <vector>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+
+namespace {
+constexpr size_t MESSAGES = 100000;
+
+struct Counter {
+    void operator()(const Ping& ping) { bytes += ping.ping()->size(); }
+    void operator()(const Pong& pong) { bytes += pong.pong()->size(); }
+
+    size_t bytes {0};
+};
+
+// Pings and pongs alternating
+std::vector<std::vector<uint8_t>> make_messages() {
+    std::vector<std::vector<uint8_t>> messages {};
+    for (size_t i = 0; i < 2; ++i) {
+        flatbuffers::FlatBufferBuilder builder {64};
+        if (i == 0) FinishPingBuffer(builder, CreatePing(builder, builder.CreateString("ping")));
+        else FinishPongBuffer(builder, CreatePong(builder, builder.CreateString("pong")));
+        messages.emplace_back(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+    }
+    return messages;
+}
+}
+
+TEST_CASE("Dispatch messages by file identifier", "[MessageDispatcher]") {
+    const auto messages = make_messages();
+
+    BENCHMARK("std::function with identifier checks") {
+        Counter counter {};
+        const std::function<void(std::span<const uint8_t>)> handler = [&counter](std::span<const uint8_t> message) {
+            flatbuffers::Verifier verifier {message.data(), message.size()};
+            if (PingBufferHasIdentifier(message.data())) {
+                if (VerifyPingBuffer(verifier)) counter(*GetPing(message.data()));
+            } else if (PongBufferHasIdentifier(message.data())) {
+                if (VerifyPongBuffer(verifier)) counter(*GetPong(message.data()));
+            }
+        };
+
+        for (size_t i = 0; i < MESSAGES; ++i) handler(messages[i % messages.size()]);
+        return counter.bytes;
+    };
+
+    BENCHMARK("MessageDispatcher") {
+        auto dispatcher = make_message_dispatcher<Ping, Pong>(Counter {});
+
+        for (size_t i = 0; i < MESSAGES; ++i) dispatcher.dispatch(messages[i % messages.size()]);
+        return dispatcher.handler().bytes;
+    };
+}
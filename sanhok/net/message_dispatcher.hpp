@@ -0,0 +1,118 @@
+#pragma once
+
+#include <flatbuffers/flatbuffers.h>
+#include <sanhok/buffer_pool.hpp>
+#include <sanhok/net/log.hpp>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace sanhok::net {
+/*
+ * The file_identifier of a flatbuffers root type
+ * skymarlin_compile_schemas generates the specializations into <schema>_traits.hpp for every schema that has one:
+ *     static constexpr std::string_view identifier;
+ */
+template <typename Root>
+struct MessageTraits;
+
+/*
+ * Calls handler(const Root&) for the root type whose file_identifier a buffer has
+ * The root types are resolved at compile time into a table of the identifiers sorted, with a function per type
+ * that verifies the buffer once and calls the handler directly.
+ * It is a message handler of PeerTCP, or dispatch() can be called with any buffer that is not size-prefixed.
+ */
+template <typename Handler, typename... Roots>
+class MessageDispatcher {
+public:
+    static_assert(sizeof...(Roots) > 0, "MessageDispatcher needs a root type");
+    static_assert((std::invocable<Handler&, const Roots&> && ...), "Handler has to take every root type");
+
+    explicit MessageDispatcher(Handler handler) : handler_(std::move(handler)) {}
+
+    // Returns false if the buffer has none of the identifiers or fails verification
+    bool dispatch(std::span<const uint8_t> buffer);
+    void operator()(MessageBuffer&& message) { dispatch(message.span()); }
+
+    Handler& handler() { return handler_; }
+
+private:
+    using Call = bool (*)(Handler&, std::span<const uint8_t>);
+
+    struct Entry {
+        uint32_t identifier;
+        Call call;
+    };
+
+    static constexpr uint32_t pack(const char* identifier);
+    template <typename Root>
+    static bool call(Handler& handler, std::span<const uint8_t> buffer);
+
+    static constexpr std::array<Entry, sizeof...(Roots)> TABLE = [] {
+        static_assert(((MessageTraits<Roots>::identifier.size() == flatbuffers::kFileIdentifierLength) && ...),
+            "A file_identifier has 4 characters");
+
+        std::array<Entry, sizeof...(Roots)> table {Entry {pack(MessageTraits<Roots>::identifier.data()), &call<Roots>}...};
+        std::ranges::sort(table, {}, &Entry::identifier);
+        return table;
+    }();
+    static_assert(std::ranges::adjacent_find(TABLE, {}, &Entry::identifier) == TABLE.end(),
+        "Root types have the same file_identifier");
+
+    Handler handler_;
+};
+
+template <typename... Roots, typename Handler>
+MessageDispatcher<std::decay_t<Handler>, Roots...> make_message_dispatcher(Handler&& handler) {
+    return MessageDispatcher<std::decay_t<Handler>, Roots...> {std::forward<Handler>(handler)};
+}
+
+template <typename Handler, typename... Roots>
+bool MessageDispatcher<Handler, Roots...>::dispatch(const std::span<const uint8_t> buffer) {
+    // The root offset precedes the identifier
+    if (buffer.size() < sizeof(flatbuffers::uoffset_t) + flatbuffers::kFileIdentifierLength) {
+        SANHOK_LOG_WARN("[MessageDispatcher] Message of {} bytes is too short", buffer.size());
+        return false;
+    }
+
+    const char* identifier = flatbuffers::GetBufferIdentifier(buffer.data());
+    const uint32_t key = pack(identifier);
+    const auto it = std::ranges::lower_bound(TABLE, key, {}, &Entry::identifier);
+    if (it == TABLE.end() || it->identifier != key) {
+        SANHOK_LOG_WARN("[MessageDispatcher] Unknown file identifier {}",
+            std::string_view {identifier, flatbuffers::kFileIdentifierLength});
+        return false;
+    }
+    return it->call(handler_, buffer);
+}
+
+template <typename Handler, typename... Roots>
+constexpr uint32_t MessageDispatcher<Handler, Roots...>::pack(const char* identifier) {
+    uint32_t key {0};
+    for (size_t i = 0; i < flatbuffers::kFileIdentifierLength; ++i) {
+        key = key << 8 | static_cast<uint8_t>(identifier[i]);
+    }
+    return key;
+}
+
+template <typename Handler, typename... Roots>
+template <typename Root>
+bool MessageDispatcher<Handler, Roots...>::call(Handler& handler, const std::span<const uint8_t> buffer) {
+    // The identifier is already matched
+    flatbuffers::Verifier verifier {buffer.data(), buffer.size()};
+    if (!verifier.VerifyBuffer<Root>(nullptr)) {
+        SANHOK_LOG_WARN("[MessageDispatcher] Message with file identifier {} fails verification",
+            MessageTraits<Root>::identifier);
+        return false;
+    }
+
+    handler(*flatbuffers::GetRoot<Root>(buffer.data()));
+    return true;
+}
+}
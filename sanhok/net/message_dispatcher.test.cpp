@@ -0,0 +1,74 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/message_dispatcher.hpp>
+#include <tests/hello.hpp>
+#include <tests/ping_traits.hpp>
+#include <tests/pong_traits.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+
+namespace {
+struct Handler {
+    void operator()(const Ping& ping) { pings.push_back(ping.ping()->str()); }
+    void operator()(const Pong& pong) { pongs.push_back(pong.pong()->str()); }
+
+    std::vector<std::string> pings {};
+    std::vector<std::string> pongs {};
+};
+
+template <typename Finish>
+std::vector<uint8_t> build(Finish finish) {
+    flatbuffers::FlatBufferBuilder builder {64};
+    finish(builder);
+    return {builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize()};
+}
+}
+
+TEST_CASE("[MessageDispatcher]") {
+    auto dispatcher = make_message_dispatcher<Ping, Pong>(Handler {});
+
+    const auto ping = build([](flatbuffers::FlatBufferBuilder& builder) {
+        FinishPingBuffer(builder, CreatePing(builder, builder.CreateString("ping")));
+    });
+    const auto pong = build([](flatbuffers::FlatBufferBuilder& builder) {
+        FinishPongBuffer(builder, CreatePong(builder, builder.CreateString("pong")));
+    });
+
+    SECTION("Calls the handler of the root type") {
+        REQUIRE(dispatcher.dispatch(ping));
+        REQUIRE(dispatcher.dispatch(pong));
+        REQUIRE(dispatcher.dispatch(ping));
+
+        REQUIRE(dispatcher.handler().pings == std::vector<std::string> {"ping", "ping"});
+        REQUIRE(dispatcher.handler().pongs == std::vector<std::string> {"pong"});
+    }
+
+    SECTION("Rejects a buffer without a known identifier") {
+        const auto hello = build([](flatbuffers::FlatBufferBuilder& builder) {
+            builder.Finish(CreateHello(builder, builder.CreateString("hello")));
+        });
+
+        REQUIRE(!dispatcher.dispatch(hello));
+        REQUIRE(dispatcher.handler().pings.empty());
+        REQUIRE(dispatcher.handler().pongs.empty());
+    }
+
+    SECTION("Rejects a truncated buffer") {
+        REQUIRE(!dispatcher.dispatch(std::span {ping}.first(6)));
+        REQUIRE(!dispatcher.dispatch(std::span {ping}.first(ping.size() - 4)));
+        REQUIRE(dispatcher.handler().pings.empty());
+    }
+
+    SECTION("Takes MessageBuffers as a PeerTCP message handler") {
+        BufferPool pool {};
+        auto message = pool.acquire(pong.size());
+        std::ranges::copy(pong, message.begin());
+
+        dispatcher(std::move(message));
+        REQUIRE(dispatcher.handler().pongs == std::vector<std::string> {"pong"});
+    }
+}
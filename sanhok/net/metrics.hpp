@@ -0,0 +1,394 @@
+#pragma once
+
+#include <sanhok/histogram.hpp>
+#include <sanhok/net/log.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace sanhok::net {
+#ifdef SANHOK_METRICS
+constexpr bool METRICS_ENABLED {true};
+#else
+constexpr bool METRICS_ENABLED {false};
+#endif
+
+#ifdef SANHOK_METRICS
+#define SANHOK_METRIC(Type, name) Type name {}
+#else
+// A shared empty object, so that a struct of metrics is empty too
+#define SANHOK_METRIC(Type, name) static inline Type name {}
+#endif
+
+/*
+ * A monotonic counter updated with relaxed atomics
+ * Without SANHOK_METRICS it is empty and every update compiles away.
+ */
+class Counter {
+public:
+    void add([[maybe_unused]] const uint64_t n = 1) {
+#ifdef SANHOK_METRICS
+        value_.fetch_add(n, std::memory_order_relaxed);
+#endif
+    }
+
+    uint64_t load() const {
+#ifdef SANHOK_METRICS
+        return value_.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+#ifdef SANHOK_METRICS
+private:
+    std::atomic<uint64_t> value_ {0};
+#endif
+};
+
+/*
+ * A level that goes up and down, e.g. a queue depth, keeping its high watermark
+ */
+class Gauge {
+public:
+    void add([[maybe_unused]] const int64_t n = 1) {
+#ifdef SANHOK_METRICS
+        const int64_t value = value_.fetch_add(n, std::memory_order_relaxed) + n;
+        int64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+#endif
+    }
+
+    void sub([[maybe_unused]] const int64_t n = 1) {
+#ifdef SANHOK_METRICS
+        value_.fetch_sub(n, std::memory_order_relaxed);
+#endif
+    }
+
+    int64_t load() const {
+#ifdef SANHOK_METRICS
+        return value_.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+    int64_t max() const {
+#ifdef SANHOK_METRICS
+        return max_.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+#ifdef SANHOK_METRICS
+private:
+    std::atomic<int64_t> value_ {0};
+    std::atomic<int64_t> max_ {0};
+#endif
+};
+
+/*
+ * A point in time at a stage of a message, taken only with SANHOK_METRICS
+ */
+class Timestamp {
+public:
+    static Timestamp now() {
+#ifdef SANHOK_METRICS
+        return Timestamp {std::chrono::steady_clock::now()};
+#else
+        return {};
+#endif
+    }
+
+#ifdef SANHOK_METRICS
+    std::chrono::steady_clock::time_point time {};
+#endif
+};
+
+/*
+ * Stages of messages whose latencies are recorded
+ */
+enum class LatencyStage {
+    QueueWait, // From reading a message off the socket to calling its handler
+    Handler, // Of calling the handler
+    Send, // From queueing a message to the completion of its write
+};
+
+/*
+ * The nanoseconds between two stages of messages, recorded into the histograms of MetricsRegistry
+ * It holds nothing itself, as a histogram per peer would take tens of KB.
+ */
+template <LatencyStage Stage>
+class Latency {
+public:
+    void record(Timestamp from, Timestamp to = Timestamp::now()) const;
+};
+
+/*
+ * Counters and latencies of PeerTCP and PeerUDP
+ */
+struct PeerMetrics {
+    struct Snapshot {
+        uint64_t messages_in;
+        uint64_t messages_out;
+        uint64_t bytes_in;
+        uint64_t bytes_out;
+        uint64_t datagrams_out; // Sent by PeerUDP; fewer than messages_out when UDP_SEGMENT coalesces them
+        uint64_t send_errors;
+        uint64_t receive_errors;
+        uint64_t dropped; // By PeerUDP without room in its receive buffer or by the overflow policy of PeerTCP
+        int64_t send_queue_depth;
+        int64_t send_queue_max_depth;
+        int64_t receive_queue_depth; // Received and not handled yet
+        int64_t receive_queue_max_depth;
+
+        Snapshot& operator+=(const Snapshot& other);
+    };
+
+    // Histograms of nanoseconds, merged over every peer; they are not in Snapshot as they are much bigger to copy
+    struct Latencies {
+        Histogram::Snapshot queue_wait;
+        Histogram::Snapshot handler;
+        Histogram::Snapshot send;
+
+        Latencies& operator+=(const Latencies& other);
+    };
+
+    Snapshot snapshot() const;
+
+    SANHOK_METRIC(Counter, messages_in);
+    SANHOK_METRIC(Counter, messages_out);
+    SANHOK_METRIC(Counter, bytes_in);
+    SANHOK_METRIC(Counter, bytes_out);
+    SANHOK_METRIC(Counter, datagrams_out);
+    SANHOK_METRIC(Counter, send_errors);
+    SANHOK_METRIC(Counter, receive_errors);
+    SANHOK_METRIC(Counter, dropped);
+    SANHOK_METRIC(Gauge, send_queue_depth);
+    SANHOK_METRIC(Gauge, receive_queue_depth);
+    // Shared by every peer, see MetricsRegistry::latencies_total()
+    static constexpr Latency<LatencyStage::QueueWait> queue_wait {};
+    static constexpr Latency<LatencyStage::Handler> handler {};
+    static constexpr Latency<LatencyStage::Send> send {};
+};
+
+/*
+ * Counters of ListenerTCP; the accept rate is the difference of two snapshots over their interval
+ */
+struct ListenerMetrics {
+    struct Snapshot {
+        uint64_t accepts;
+        uint64_t accept_errors;
+    };
+
+    Snapshot snapshot() const { return {accepts.load(), accept_errors.load()}; }
+
+    SANHOK_METRIC(Counter, accepts);
+    SANHOK_METRIC(Counter, accept_errors);
+};
+
+/*
+ * Enumerates the metrics of every live peer and listener
+ * They register themselves on construction and unregister on destruction, which are the only locked operations;
+ * without SANHOK_METRICS nothing is registered.
+ * Latencies of all peers go to histograms sharded by thread, so that threads rarely share their counters, and
+ * are merged from the shards without the lock.
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    void add(std::string_view kind, const PeerMetrics& metrics);
+    void remove(const PeerMetrics& metrics);
+    void add(const ListenerMetrics& metrics);
+    void remove(const ListenerMetrics& metrics);
+
+    // function(std::string_view kind, const PeerMetrics::Snapshot&) for every live peer
+    template <typename Function>
+    void for_each_peer(Function function) const;
+    PeerMetrics::Snapshot peers_total() const;
+    void record_latency(LatencyStage stage, uint64_t nanoseconds);
+    PeerMetrics::Latencies latencies_total() const;
+    // Logs percentiles of latencies_total()
+    void log_latencies() const;
+    ListenerMetrics::Snapshot listeners_total() const;
+    size_t peer_count() const;
+
+private:
+    struct PeerEntry {
+        std::string_view kind;
+        const PeerMetrics* metrics;
+    };
+
+    MetricsRegistry() = default;
+
+    mutable std::mutex mutex_ {};
+    std::vector<PeerEntry> peers_ {};
+    std::vector<const ListenerMetrics*> listeners_ {};
+
+#ifdef SANHOK_METRICS
+    static constexpr size_t LATENCY_SHARDS {16};
+
+    // A histogram per LatencyStage
+    struct LatencyShard {
+        std::array<Histogram, 3> stages {};
+    };
+
+    static size_t latency_shard();
+
+    std::array<LatencyShard, LATENCY_SHARDS> latency_shards_ {};
+#endif
+};
+
+template <LatencyStage Stage>
+void Latency<Stage>::record([[maybe_unused]] const Timestamp from, [[maybe_unused]] const Timestamp to) const {
+#ifdef SANHOK_METRICS
+    MetricsRegistry::instance().record_latency(Stage, std::max<int64_t>((to.time - from.time).count(), 0));
+#endif
+}
+
+inline PeerMetrics::Snapshot& PeerMetrics::Snapshot::operator+=(const Snapshot& other) {
+    messages_in += other.messages_in;
+    messages_out += other.messages_out;
+    bytes_in += other.bytes_in;
+    bytes_out += other.bytes_out;
+    datagrams_out += other.datagrams_out;
+    send_errors += other.send_errors;
+    receive_errors += other.receive_errors;
+    dropped += other.dropped;
+    send_queue_depth += other.send_queue_depth;
+    send_queue_max_depth = std::max(send_queue_max_depth, other.send_queue_max_depth);
+    receive_queue_depth += other.receive_queue_depth;
+    receive_queue_max_depth = std::max(receive_queue_max_depth, other.receive_queue_max_depth);
+    return *this;
+}
+
+inline PeerMetrics::Latencies& PeerMetrics::Latencies::operator+=(const Latencies& other) {
+    queue_wait += other.queue_wait;
+    handler += other.handler;
+    send += other.send;
+    return *this;
+}
+
+inline PeerMetrics::Snapshot PeerMetrics::snapshot() const {
+    return {
+        messages_in.load(), messages_out.load(), bytes_in.load(), bytes_out.load(), datagrams_out.load(),
+        send_errors.load(), receive_errors.load(), dropped.load(),
+        send_queue_depth.load(), send_queue_depth.max(), receive_queue_depth.load(), receive_queue_depth.max(),
+    };
+}
+
+inline MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry {};
+    return registry;
+}
+
+inline void MetricsRegistry::add(const std::string_view kind, const PeerMetrics& metrics) {
+    if constexpr (!METRICS_ENABLED) return;
+
+    std::lock_guard lock {mutex_};
+    peers_.push_back({kind, &metrics});
+}
+
+inline void MetricsRegistry::remove(const PeerMetrics& metrics) {
+    if constexpr (!METRICS_ENABLED) return;
+
+    std::lock_guard lock {mutex_};
+    std::erase_if(peers_, [&metrics](const PeerEntry& entry) { return entry.metrics == &metrics; });
+}
+
+inline void MetricsRegistry::add(const ListenerMetrics& metrics) {
+    if constexpr (!METRICS_ENABLED) return;
+
+    std::lock_guard lock {mutex_};
+    listeners_.push_back(&metrics);
+}
+
+inline void MetricsRegistry::remove(const ListenerMetrics& metrics) {
+    if constexpr (!METRICS_ENABLED) return;
+
+    std::lock_guard lock {mutex_};
+    std::erase(listeners_, &metrics);
+}
+
+template <typename Function>
+void MetricsRegistry::for_each_peer(Function function) const {
+    std::lock_guard lock {mutex_};
+    for (const auto& [kind, metrics] : peers_) function(kind, metrics->snapshot());
+}
+
+inline PeerMetrics::Snapshot MetricsRegistry::peers_total() const {
+    PeerMetrics::Snapshot total {};
+    for_each_peer([&total](std::string_view, const PeerMetrics::Snapshot& snapshot) { total += snapshot; });
+    return total;
+}
+
+inline void MetricsRegistry::record_latency([[maybe_unused]] const LatencyStage stage,
+    [[maybe_unused]] const uint64_t nanoseconds) {
+#ifdef SANHOK_METRICS
+    latency_shards_[latency_shard()].stages[static_cast<size_t>(stage)].record(nanoseconds);
+#endif
+}
+
+inline PeerMetrics::Latencies MetricsRegistry::latencies_total() const {
+    PeerMetrics::Latencies total {};
+#ifdef SANHOK_METRICS
+    for (const auto& shard : latency_shards_) {
+        total += {
+            shard.stages[static_cast<size_t>(LatencyStage::QueueWait)].snapshot(),
+            shard.stages[static_cast<size_t>(LatencyStage::Handler)].snapshot(),
+            shard.stages[static_cast<size_t>(LatencyStage::Send)].snapshot(),
+        };
+    }
+#endif
+    return total;
+}
+
+inline void MetricsRegistry::log_latencies() const {
+    const auto total = latencies_total();
+    const auto log = [](const std::string_view stage, const Histogram::Snapshot& latency) {
+        const auto us = [&latency](const double percentile) {
+            return static_cast<double>(latency.value_at_percentile(percentile)) / 1000;
+        };
+        SANHOK_LOG_INFO("[MetricsRegistry] {} latency of {} messages: p50 {:.1f}us, p99 {:.1f}us, p999 {:.1f}us, max {:.1f}us",
+            stage, latency.count(), us(0.5), us(0.99), us(0.999), static_cast<double>(latency.max()) / 1000);
+    };
+
+    log("Queue wait", total.queue_wait);
+    log("Handler", total.handler);
+    log("Send", total.send);
+}
+
+inline ListenerMetrics::Snapshot MetricsRegistry::listeners_total() const {
+    std::lock_guard lock {mutex_};
+
+    ListenerMetrics::Snapshot total {};
+    for (const ListenerMetrics* metrics : listeners_) {
+        const auto snapshot = metrics->snapshot();
+        total.accepts += snapshot.accepts;
+        total.accept_errors += snapshot.accept_errors;
+    }
+    return total;
+}
+
+inline size_t MetricsRegistry::peer_count() const {
+    std::lock_guard lock {mutex_};
+    return peers_.size();
+}
+
+#ifdef SANHOK_METRICS
+// Threads take the shards in turn
+inline size_t MetricsRegistry::latency_shard() {
+    static std::atomic<size_t> next_shard {0};
+    static thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % LATENCY_SHARDS;
+    return shard;
+}
+#endif
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/listener_tcp.hpp>
+#include <sanhok/net/peer_tcp.hpp>
+#include <tests/hello.hpp>
+
+#include <chrono>
+#include <cstring>
+
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+using namespace std::chrono_literals;
+
+namespace {
+constexpr unsigned short LISTEN_PORT {50100};
+
+std::shared_ptr<flatbuffers::DetachedBuffer> make_message(const size_t text_size) {
+    flatbuffers::FlatBufferBuilder builder {64 + text_size};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(std::string(text_size, 'a'))));
+    return std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+}
+
+// Sends the messages in bursts over loopback and waits until the server handled all of them
+void send_bursts(const size_t messages, const size_t burst, const size_t text_size, const size_t max_messages) {
+    boost::asio::io_context ctx {};
+    std::atomic<size_t> received {0};
+    std::vector<std::unique_ptr<PeerTCP>> servers {};
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&servers, &received](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            auto server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&received](std::vector<uint8_t>&&) {
+                ++received;
+            });
+            server->run();
+            servers.push_back(std::move(server));
+        }
+    };
+    listener.start();
+
+    const auto message = make_message(text_size);
+    PeerTCP client {ctx, tcp::socket {ctx}, {}};
+    client.set_send_coalescing(SIZE_MAX, max_messages);
+
+    co_spawn(ctx, [&]()->boost::asio::awaitable<void> {
+        co_await client.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LISTEN_PORT));
+        client.set_no_delay(true);
+
+        for (size_t sent = 0; sent < messages; sent += burst) {
+            for (size_t i = 0; i < burst; ++i) client.send_message(message);
+            co_await boost::asio::post(ctx, boost::asio::use_awaitable);
+        }
+    }, boost::asio::detached);
+
+    while (received < messages) ctx.run_for(1ms);
+
+    listener.stop();
+    client.disconnect();
+    ctx.run_for(1ms);
+    servers.clear();
+}
+}
+
+TEST_CASE("[PeerTCP]") {
+    constexpr size_t MESSAGES = 100000;
+    constexpr size_t BURST = 50;
+    constexpr size_t TEXT_SIZE = 32;
+
+    BENCHMARK("One write per message; 100000 Hello of 32 characters in bursts of 50") {
+        send_bursts(MESSAGES, BURST, TEXT_SIZE, 1);
+    };
+
+    BENCHMARK("Coalesced gather writes; 100000 Hello of 32 characters in bursts of 50") {
+        send_bursts(MESSAGES, BURST, TEXT_SIZE, 64);
+    };
+}
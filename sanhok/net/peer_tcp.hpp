@@ -3,85 +3,248 @@
 #include <boost/asio.hpp>
 #include <boost/core/noncopyable.hpp>
 #include <flatbuffers/flatbuffers.h>
+#include <sanhok/buffer_pool.hpp>
 #include <sanhok/concurrent_queue.hpp>
-#include <spdlog/spdlog.h>
+#include <sanhok/net/capture.hpp>
+#include <sanhok/net/handler_dispatch.hpp>
+#include <sanhok/net/log.hpp>
+#include <sanhok/net/metrics.hpp>
+#include <sanhok/net/queue_limits.hpp>
+#include <sanhok/net/send_buffer.hpp>
+#include <sanhok/net/timing_wheel.hpp>
+#include <sanhok/net/uring_receiver.hpp>
+
+#include <cstring>
+#include <optional>
+#include <span>
+#include <variant>
+#include <vector>
 
 namespace sanhok::net {
 using boost::asio::ip::tcp;
 
+class BroadcastGroup;
+
 class PeerTCP final : boost::noncopyable {
 public:
     PeerTCP(boost::asio::io_context& ctx, tcp::socket&& socket,
-        std::function<void(std::vector<uint8_t>&&)>&& message_handler);
+        std::function<void(std::vector<uint8_t>&&)>&& message_handler, size_t receive_buffer_size);
+    // Receives messages in buffers from BufferPool::shared() without copying them into vectors
+    template <typename MessageHandler>
+        requires (std::invocable<MessageHandler, MessageBuffer&&>
+            && !std::invocable<MessageHandler, std::vector<uint8_t>&&>)
+    PeerTCP(boost::asio::io_context& ctx, tcp::socket&& socket, MessageHandler&& message_handler,
+        size_t receive_buffer_size = 65536);
     ~PeerTCP();
 
     void run();
     boost::asio::awaitable<bool> connect(const tcp::endpoint& remote_endpoint);
     void disconnect();
     void send_message(std::shared_ptr<flatbuffers::DetachedBuffer> message);
+    void send_message(MessageBuffer message);
     void set_no_delay(bool delay);
+    void set_send_coalescing(size_t max_bytes, size_t max_messages);
+    void set_handler_dispatch(HandlerDispatch dispatch);
+    void set_send_limits(QueueLimits limits);
+    void set_receive_limits(QueueLimits limits);
+    void set_max_message_size(size_t max_size);
+    void set_provided_buffers(size_t count, size_t buffer_size);
+    void set_idle_timeout(TimingWheel& wheel, std::chrono::steady_clock::duration timeout);
+    void set_capture(CaptureFile& capture, uint64_t peer_id);
 
     bool is_connected() const { return is_connected_; }
+    boost::asio::io_context& context() const { return ctx_; }
+    const PeerMetrics& metrics() const { return metrics_; }
     tcp::endpoint local_endpoint() const { return socket_.local_endpoint(); }
     tcp::endpoint remote_endpoint() const { return socket_.remote_endpoint(); }
 
 private:
+    friend class BroadcastGroup;
+
+    // A received message without its size prefix, copied into the type the handler takes
+    using MessageBody = std::variant<MessageBuffer, std::vector<uint8_t>>;
+
+    struct ReceivedMessage {
+        MessageBody message;
+        [[no_unique_address]] Timestamp received_at;
+    };
+
+    struct QueuedMessage {
+        SendBuffer message;
+        [[no_unique_address]] Timestamp queued_at;
+    };
+
+    void send(SendBuffer&& message);
+    void send_shared(std::span<const SendBuffer> messages);
+    boost::asio::awaitable<void> write_queue();
+    boost::asio::awaitable<void> write_rest(SendBuffer message, size_t written, Timestamp queued_at);
+    bool make_room_to_send(size_t size);
     boost::asio::awaitable<void> receive_message();
+    void compact_receive_buffer();
+    void parse_messages(Timestamp received_at);
+    boost::asio::awaitable<void> wait_for_receive_room();
+    void wake_receive();
+    bool make_room_to_receive(size_t size);
+    static size_t body_size(const MessageBody& message);
+    void dispatch_message(MessageBody&& message, Timestamp received_at);
+    void rearm_idle_timer();
+    void handle_message(MessageBody&& message, Timestamp received_at);
+    void join_worker();
 
     boost::asio::io_context& ctx_;
     tcp::socket socket_;
     std::atomic<bool> is_connected_;
-
-    ConcurrentQueue<std::vector<uint8_t>> receive_queue_;
-    ConcurrentQueue<std::shared_ptr<flatbuffers::DetachedBuffer>> send_queue_ {};
+    std::atomic<bool> is_running_ {false};
+
+    std::vector<uint8_t> receive_buffer_;
+    size_t receive_begin_ {0}; // Start of the bytes not parsed into messages yet
+    size_t receive_end_ {0}; // End of the bytes read from the socket
+    BufferPool& buffer_pool_ {BufferPool::shared()};
+    ConcurrentQueue<ReceivedMessage> receive_queue_;
+    ConcurrentQueue<QueuedMessage> send_queue_ {};
     std::atomic<bool> is_sending_ {false};
+    size_t send_coalescing_bytes_ {262144};
+    size_t send_coalescing_messages_ {64};
+    std::vector<QueuedMessage> sending_messages_ {};
+    std::vector<boost::asio::const_buffer> sending_buffers_ {};
     std::thread worker_;
-    std::function<void(std::vector<uint8_t>&&)> message_handler_;
+    std::function<void(MessageBuffer&&)> message_handler_;
+    std::function<void(std::vector<uint8_t>&&)> vector_handler_ {}; // Takes the messages instead, if set
+
+    HandlerDispatch dispatch_ {HandlerDispatch::dedicated_thread()};
+    std::optional<boost::asio::strand<boost::asio::any_io_executor>> handler_strand_ {};
+    std::atomic<size_t> pending_handlers_ {0};
+
+    QueueLimits send_limits_ {};
+    QueueLimits receive_limits_ {};
+    // Of a received message, size prefix included; the receive buffer grows to fit one
+    size_t max_message_size_ {16 << 20};
+    QueueBytes send_bytes_ {send_limits_}; // Queued and being written
+    QueueBytes receive_bytes_ {receive_limits_, [this] { wake_receive(); }}; // Received and not handled yet
+    // Expires never; cancelled to wake the receive loop when receive_bytes_ falls to the low watermark
+    const std::shared_ptr<boost::asio::steady_timer> receive_room_ {std::make_shared<boost::asio::steady_timer>(ctx_)};
+    std::atomic<bool> receive_waiting_ {false};
+
+#ifdef SANHOK_IO_URING
+    boost::asio::awaitable<void> receive_provided();
+
+    // Receives through io_uring into provided buffers; disabled when 0
+    size_t provided_buffers_ {0};
+    size_t provided_buffer_size_ {0};
+    std::optional<UringReceiver> uring_receiver_ {};
+#endif
+
+    // Disconnects when nothing is received for idle_timeout_
+    std::optional<WheelTimer> idle_timer_ {};
+    std::chrono::steady_clock::duration idle_timeout_ {};
+
+    // Appends every received message to capture_ under capture_peer_id_
+    CaptureFile* capture_ {nullptr};
+    uint64_t capture_peer_id_ {0};
+
+    [[no_unique_address]] PeerMetrics metrics_ {};
 };
 
 
 inline PeerTCP::PeerTCP(boost::asio::io_context& ctx, tcp::socket&& socket,
-    std::function<void(std::vector<uint8_t>&&)>&& message_handler)
-    : ctx_(ctx), socket_(std::move(socket)), is_connected_(socket_.is_open()), message_handler_(std::move(message_handler)) {}
+    std::function<void(std::vector<uint8_t>&&)>&& message_handler, const size_t receive_buffer_size = 65536)
+    : PeerTCP(ctx, std::move(socket), [](MessageBuffer&&) {}, receive_buffer_size) {
+    // Messages are copied into vectors straight from the receive buffer, not through a pooled buffer
+    vector_handler_ = std::move(message_handler);
+}
+
+template <typename MessageHandler>
+    requires (std::invocable<MessageHandler, MessageBuffer&&>
+        && !std::invocable<MessageHandler, std::vector<uint8_t>&&>)
+PeerTCP::PeerTCP(boost::asio::io_context& ctx, tcp::socket&& socket, MessageHandler&& message_handler,
+    const size_t receive_buffer_size)
+    : ctx_(ctx), socket_(std::move(socket)), is_connected_(socket_.is_open()),
+    receive_buffer_(std::max(receive_buffer_size, sizeof(flatbuffers::uoffset_t))),
+    message_handler_(std::forward<MessageHandler>(message_handler)) {
+    // Lets send_shared() try a write without blocking the io_context thread; async operations are unaffected
+    boost::system::error_code ec;
+    if (socket_.is_open()) socket_.non_blocking(true, ec);
+
+    MetricsRegistry::instance().add("PeerTCP", metrics_);
+}
 
 inline PeerTCP::~PeerTCP() {
+    // Waits for its handler, which disconnects
+    idle_timer_.reset();
     disconnect();
+    join_worker();
 
-    if (worker_.joinable()) worker_.join();
+    // Handlers posted to a shared executor still refer to this peer
+    for (size_t pending = pending_handlers_.load(); pending > 0; pending = pending_handlers_.load()) {
+        pending_handlers_.wait(pending);
+    }
+
+    MetricsRegistry::instance().remove(metrics_);
 }
 
 inline void PeerTCP::run() {
+    if (is_running_.exchange(true)) return;
+
+#ifdef SANHOK_IO_URING
+    if (provided_buffers_ > 0 && !uring_receiver_) {
+        uring_receiver_.emplace(ctx_, socket_.native_handle(), provided_buffer_size_, provided_buffers_);
+        if (!uring_receiver_->open()) {
+            SANHOK_LOG_WARN("[PeerTCP] Falling back to receiving without io_uring");
+            uring_receiver_.reset();
+        }
+    }
+#endif
+
+    rearm_idle_timer();
+
     // Start receiving messages
     co_spawn(ctx_, [this]()->boost::asio::awaitable<void> {
         while (is_connected_) {
+            if (receive_limits_.overflow == QueueLimits::Overflow::Block && receive_bytes_.saturated()) {
+                co_await wait_for_receive_room();
+            }
+#ifdef SANHOK_IO_URING
+            if (uring_receiver_) {
+                co_await receive_provided();
+                continue;
+            }
+#endif
             co_await receive_message();
         }
     }, boost::asio::detached);
 
-    // Start handling messages
-    worker_ = std::thread([this] {
-        while (is_connected_) {
-            auto message = receive_queue_.pop_wait();
-            if (!message) return;
-            message_handler_(std::move(*message));
-        }
-    });
-    worker_.detach();
+    switch (dispatch_.mode()) {
+    case HandlerDispatch::Mode::DedicatedThread:
+        // Start handling messages
+        worker_ = std::thread([this] {
+            while (auto message = receive_queue_.pop_wait([this] { return !is_connected_; })) {
+                handle_message(std::move(message->message), message->received_at);
+            }
+        });
+        break;
+    case HandlerDispatch::Mode::Executor:
+        handler_strand_.emplace(dispatch_.executor());
+        break;
+    case HandlerDispatch::Mode::Inline:
+        break;
+    }
 }
 
 inline boost::asio::awaitable<bool> PeerTCP::connect(const tcp::endpoint& remote_endpoint) {
     if (is_connected_) {
-        spdlog::error("[PeerTCP] Socket is already connected");
+        SANHOK_LOG_ERROR("[PeerTCP] Socket is already connected");
         co_return false;
     }
 
     const auto [ec] = co_await socket_.async_connect(remote_endpoint, as_tuple(boost::asio::use_awaitable));
     if (ec) {
-        spdlog::error("[PeerTCP] Error connecting to {}:{}", remote_endpoint.address().to_string(),
+        SANHOK_LOG_ERROR("[PeerTCP] Error connecting to {}:{}", remote_endpoint.address().to_string(),
             remote_endpoint.port());
         co_return false;
     }
 
+    boost::system::error_code non_blocking_ec;
+    socket_.non_blocking(true, non_blocking_ec);
     is_connected_ = true;
     co_return true;
 }
@@ -89,7 +252,18 @@ inline boost::asio::awaitable<bool> PeerTCP::connect(const tcp::endpoint& remote
 inline void PeerTCP::disconnect() {
     if (!is_connected_.exchange(false)) return;
 
+    while (auto message = receive_queue_.pop()) {
+        receive_bytes_.sub(body_size(message->message));
+        metrics_.receive_queue_depth.sub();
+    }
     receive_queue_.clear();
+    send_bytes_.notify();
+    wake_receive();
+    if (idle_timer_) idle_timer_->cancel();
+
+#ifdef SANHOK_IO_URING
+    if (uring_receiver_) uring_receiver_->close();
+#endif
 
     try {
         socket_.shutdown(tcp::socket::shutdown_both);
@@ -97,63 +271,463 @@ inline void PeerTCP::disconnect() {
         //TODO: Process remaining send queue?
         socket_.close();
     } catch (const boost::system::system_error& e) {
-        spdlog::error("[PeerTCP] Error shutting down socket: {}", e.what());
+        SANHOK_LOG_ERROR("[PeerTCP] Error shutting down socket: {}", e.what());
     }
 }
 
 inline void PeerTCP::send_message(std::shared_ptr<flatbuffers::DetachedBuffer> message) {
+    send(std::move(message));
+}
+
+inline void PeerTCP::send_message(MessageBuffer message) {
+    send(std::move(message));
+}
+
+inline void PeerTCP::send(SendBuffer&& message) {
     if (!message || !is_connected_) return;
+    if (send_bytes_.overflows(message.size()) && !make_room_to_send(message.size())) return;
 
-    send_queue_.push(std::move(message));
+    send_bytes_.add(message.size());
+    send_queue_.push({std::move(message), Timestamp::now()});
+    metrics_.send_queue_depth.add();
 
     // Send all messages in send_queue_
     if (is_sending_.exchange(true)) return;
-    co_spawn(ctx_, [this]()->boost::asio::awaitable<void> {
+    co_spawn(ctx_, write_queue(), boost::asio::detached);
+}
+
+// Sends messages shared by the peers of a BroadcastGroup, on the io_context thread
+// An idle peer writes them straight to the socket in one gather write instead of queueing them and spawning
+// its write loop; the loop only takes over from the first message the socket doesn't take whole.
+inline void PeerTCP::send_shared(const std::span<const SendBuffer> messages) {
+    if (!is_connected_ || messages.empty()) return;
+
+    // Behind a write in progress
+    if (!socket_.non_blocking() || is_sending_.exchange(true)) {
+        for (const auto& message : messages) send(SendBuffer {message});
+        return;
+    }
+    // Behind messages pushed by threads that left the write loop to this call
+    if (!send_queue_.empty()) {
+        for (const auto& message : messages) send(SendBuffer {message});
+        co_spawn(ctx_, write_queue(), boost::asio::detached);
+        return;
+    }
+
+    const auto queued_at = Timestamp::now();
+    for (const auto& message : messages) sending_buffers_.push_back(message.buffer());
+    boost::system::error_code ec;
+    const size_t written = socket_.write_some(sending_buffers_, ec);
+    sending_buffers_.clear();
+    if (ec && ec != boost::asio::error::would_block) {
+        SANHOK_LOG_ERROR("[PeerTCP] Error sending message: {}", ec.what());
+        metrics_.send_errors.add();
+        disconnect();
+        return;
+    }
+
+    size_t sent {0};
+    size_t sent_bytes {0};
+    while (sent < messages.size() && sent_bytes + messages[sent].size() <= written) {
+        sent_bytes += messages[sent++].size();
+        metrics_.send.record(queued_at);
+    }
+    metrics_.messages_out.add(sent);
+    metrics_.bytes_out.add(sent_bytes);
+
+    if (sent < messages.size()) {
+        for (const auto& message : messages.subspan(sent + 1)) send(SendBuffer {message});
+        co_spawn(ctx_, write_rest(SendBuffer {messages[sent]}, written - sent_bytes, queued_at),
+            boost::asio::detached);
+        return;
+    }
+
+    is_sending_ = false;
+
+    // Keep sending if a message was pushed meanwhile
+    if (!send_queue_.empty() && !is_sending_.exchange(true)) co_spawn(ctx_, write_queue(), boost::asio::detached);
+}
+
+// Writes what the socket didn't take of a message from send_shared(), then the queued messages
+inline boost::asio::awaitable<void> PeerTCP::write_rest(SendBuffer message, const size_t written,
+    const Timestamp queued_at) {
+    const size_t rest = message.size() - written;
+    send_bytes_.add(rest);
+    const auto [ec, rest_written] = co_await async_write(socket_, message.buffer() + written,
+        as_tuple(boost::asio::use_awaitable));
+    metrics_.send.record(queued_at);
+    send_bytes_.sub(rest);
+
+    if (ec) {
+        SANHOK_LOG_ERROR("[PeerTCP] Error sending message: {}", ec.what());
+        metrics_.send_errors.add();
+        disconnect();
+        co_return;
+    }
+    metrics_.messages_out.add();
+    metrics_.bytes_out.add(written + rest_written);
+
+    co_await write_queue();
+}
+
+// Writes the queued messages until the queue is empty; runs while is_sending_ is held
+inline boost::asio::awaitable<void> PeerTCP::write_queue() {
+    while (true) {
         while (!send_queue_.empty()) {
-            const auto message = send_queue_.pop();
-            if (!message) continue;;
+            // Gather queued messages up to the limits into one write
+            size_t bytes {0};
+            while (sending_messages_.size() < send_coalescing_messages_ && bytes < send_coalescing_bytes_) {
+                auto message = send_queue_.pop();
+                if (!message) break;
+                metrics_.send_queue_depth.sub();
+
+                bytes += message->message.size();
+                sending_buffers_.push_back(message->message.buffer());
+                sending_messages_.push_back(std::move(*message));
+            }
+            if (sending_messages_.empty()) continue;
+
+            // async_write keeps writing after partial writes until the whole sequence is sent
+            const auto [ec, written] = co_await async_write(socket_, sending_buffers_,
+                as_tuple(boost::asio::use_awaitable));
+            const size_t messages = sending_messages_.size();
+            if constexpr (METRICS_ENABLED) {
+                const auto written_at = Timestamp::now();
+                for (const auto& message : sending_messages_) metrics_.send.record(message.queued_at, written_at);
+            }
+            sending_buffers_.clear();
+            sending_messages_.clear();
+            send_bytes_.sub(bytes);
 
-            if (auto [ec, _] = co_await socket_.async_send(boost::asio::buffer((*message)->data(), (*message)->size()),
-                as_tuple(boost::asio::use_awaitable)); ec) {
-                spdlog::error("[PeerTCP] Error sending message: {}", ec.what());
+            if (ec) {
+                SANHOK_LOG_ERROR("[PeerTCP] Error sending message: {}", ec.what());
+                metrics_.send_errors.add();
                 disconnect();
                 co_return;
             }
+            metrics_.messages_out.add(messages);
+            metrics_.bytes_out.add(written);
         }
 
         is_sending_ = false;
-    }, boost::asio::detached);
+
+        // Keep sending if a message was pushed after the queue was found empty
+        if (send_queue_.empty() || is_sending_.exchange(true)) break;
+    }
+}
+
+// Applies the overflow policy to a message of size bytes, returning whether to queue it
+inline bool PeerTCP::make_room_to_send(const size_t size) {
+    switch (send_limits_.overflow) {
+    case QueueLimits::Overflow::Block:
+        // Blocking the io_context thread would stall the writes that make room
+        if (ctx_.get_executor().running_in_this_thread()) return true;
+        send_bytes_.wait([this] { return !is_connected_; });
+        return is_connected_;
+    case QueueLimits::Overflow::DropOldest:
+        while (send_bytes_.overflows(size)) {
+            auto oldest = send_queue_.pop();
+            if (!oldest) break;
+            send_bytes_.sub(oldest->message.size());
+            metrics_.send_queue_depth.sub();
+            metrics_.dropped.add();
+        }
+        return true;
+    case QueueLimits::Overflow::DropNewest:
+        metrics_.dropped.add();
+        return false;
+    case QueueLimits::Overflow::Disconnect:
+        SANHOK_LOG_WARN("[PeerTCP] Send queue is over {} bytes, disconnecting", send_limits_.high_watermark);
+        disconnect();
+        return false;
+    }
+    return false;
 }
 
 inline void PeerTCP::set_no_delay(const bool delay) {
     try {
         socket_.set_option(tcp::no_delay(delay));
     } catch (const boost::system::system_error& e) {
-        spdlog::error("[PeerTCP] Error setting no-delay: {}", e.what());
+        SANHOK_LOG_ERROR("[PeerTCP] Error setting no-delay: {}", e.what());
+    }
+}
+
+inline void PeerTCP::set_send_coalescing(const size_t max_bytes, const size_t max_messages) {
+    send_coalescing_bytes_ = std::max<size_t>(max_bytes, 1);
+    send_coalescing_messages_ = std::max<size_t>(max_messages, 1);
+}
+
+inline void PeerTCP::set_handler_dispatch(HandlerDispatch dispatch) {
+    dispatch_ = std::move(dispatch);
+}
+
+// Set before running, as the I/O path reads the limits unsynchronized
+inline void PeerTCP::set_send_limits(QueueLimits limits) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[PeerTCP] Send limits have to be set before running");
+        return;
+    }
+
+    send_limits_ = std::move(limits);
+}
+
+inline void PeerTCP::set_receive_limits(QueueLimits limits) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[PeerTCP] Receive limits have to be set before running");
+        return;
+    }
+
+    receive_limits_ = std::move(limits);
+}
+
+// Disconnects a peer whose size prefix announces a bigger message, before allocating for it
+inline void PeerTCP::set_max_message_size(const size_t max_size) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[PeerTCP] Max message size has to be set before running");
+        return;
+    }
+
+    max_message_size_ = std::max(max_size, sizeof(flatbuffers::uoffset_t));
+}
+
+// Receives with io_uring into a ring of count buffers of buffer_size bytes the kernel fills without a read per
+// chunk. Falls back to reading the socket if the kernel lacks io_uring or provided buffer rings.
+inline void PeerTCP::set_provided_buffers([[maybe_unused]] const size_t count,
+    [[maybe_unused]] const size_t buffer_size = 16384) {
+#ifdef SANHOK_IO_URING
+    if (uring_receiver_) {
+        SANHOK_LOG_ERROR("[PeerTCP] Provided buffers have to be set before running");
+        return;
+    }
+    provided_buffers_ = count;
+    provided_buffer_size_ = std::max<size_t>(buffer_size, 1);
+#else
+    SANHOK_LOG_WARN("[PeerTCP] Provided buffers need libnet built with SANHOK_IO_URING");
+#endif
+}
+
+// Disconnects after timeout without receiving anything, timed by a wheel shared with the other peers
+inline void PeerTCP::set_idle_timeout(TimingWheel& wheel, const std::chrono::steady_clock::duration timeout) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[PeerTCP] Idle timeout has to be set before running");
+        return;
+    }
+
+    idle_timeout_ = timeout;
+    idle_timer_.emplace(wheel, [this] {
+        if (!is_connected_) return;
+        SANHOK_LOG_WARN("[PeerTCP] Nothing received for {}ms, disconnecting",
+            std::chrono::duration_cast<std::chrono::milliseconds>(idle_timeout_).count());
+        disconnect();
+    });
+}
+
+// Records every message received, size prefix included, tagged with peer_id; set before running
+inline void PeerTCP::set_capture(CaptureFile& capture, const uint64_t peer_id) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[PeerTCP] Capture has to be set before running");
+        return;
     }
+
+    capture_ = &capture;
+    capture_peer_id_ = peer_id;
 }
 
 inline boost::asio::awaitable<void> PeerTCP::receive_message() {
-    constexpr size_t MESSAGE_SIZE_PREFIX_BYTES = sizeof(flatbuffers::uoffset_t);
+    compact_receive_buffer();
 
-    std::array<uint8_t, MESSAGE_SIZE_PREFIX_BYTES> header_buffer {};
-    if (const auto [ec, _] = co_await async_read(socket_,
-        boost::asio::buffer(header_buffer),
-        as_tuple(boost::asio::use_awaitable)); ec) {
+    const auto [ec, size] = co_await socket_.async_read_some(
+        boost::asio::buffer(receive_buffer_.data() + receive_end_, receive_buffer_.size() - receive_end_),
+        as_tuple(boost::asio::use_awaitable));
+    if (ec) {
+        if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted) metrics_.receive_errors.add();
         disconnect();
         co_return;
     }
+    receive_end_ += size;
+    metrics_.bytes_in.add(size);
+    rearm_idle_timer();
+    parse_messages(Timestamp::now());
+}
 
-    const auto length = flatbuffers::GetSizePrefixedBufferLength(header_buffer.data());
-    std::vector<uint8_t> body_buffer(length - MESSAGE_SIZE_PREFIX_BYTES);
+#ifdef SANHOK_IO_URING
+// Copies each chunk out of its provided buffer so it goes back to the ring before the messages are handled
+inline boost::asio::awaitable<void> PeerTCP::receive_provided() {
+    co_await uring_receiver_->receive([this](const boost::system::error_code& ec, std::span<const uint8_t> chunk) {
+        if (ec) {
+            if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted) metrics_.receive_errors.add();
+            disconnect();
+            return;
+        }
 
-    if (const auto [ec, _] = co_await async_read(socket_,
-        boost::asio::buffer(body_buffer),
-        as_tuple(boost::asio::use_awaitable)); ec) {
+        compact_receive_buffer();
+        if (receive_buffer_.size() - receive_end_ < chunk.size()) receive_buffer_.resize(receive_end_ + chunk.size());
+        std::memcpy(receive_buffer_.data() + receive_end_, chunk.data(), chunk.size());
+        receive_end_ += chunk.size();
+        metrics_.bytes_in.add(chunk.size());
+        rearm_idle_timer();
+        parse_messages(Timestamp::now());
+    });
+}
+#endif
+
+// Carries the partial message over to the front so the rest of it is read contiguously
+inline void PeerTCP::compact_receive_buffer() {
+    if (receive_begin_ == 0) return;
+
+    std::memmove(receive_buffer_.data(), receive_buffer_.data() + receive_begin_, receive_end_ - receive_begin_);
+    receive_end_ -= receive_begin_;
+    receive_begin_ = 0;
+}
+
+// Parses every complete size-prefixed message read so far
+inline void PeerTCP::parse_messages(const Timestamp received_at) {
+    constexpr size_t MESSAGE_SIZE_PREFIX_BYTES = sizeof(flatbuffers::uoffset_t);
+
+    while (is_connected_ && receive_end_ - receive_begin_ >= MESSAGE_SIZE_PREFIX_BYTES) {
+        const uint8_t* message = receive_buffer_.data() + receive_begin_;
+        const auto length = flatbuffers::GetSizePrefixedBufferLength(message);
+
+        // The prefix comes from the remote peer; a length below the prefix size wrapped around
+        if (length > max_message_size_ || length < MESSAGE_SIZE_PREFIX_BYTES) {
+            SANHOK_LOG_WARN("[PeerTCP] Size prefix announces a message over {} bytes, disconnecting", max_message_size_);
+            metrics_.receive_errors.add();
+            disconnect();
+            return;
+        }
+
+        if (receive_end_ - receive_begin_ < length) {
+            // Make room for a message bigger than the buffer
+            if (length > receive_buffer_.size()) receive_buffer_.resize(length);
+            break;
+        }
+
+        if (capture_) capture_->append(capture_peer_id_, CaptureProtocol::TCP, {message, length});
+
+        const std::span body {message + MESSAGE_SIZE_PREFIX_BYTES, length - MESSAGE_SIZE_PREFIX_BYTES};
+        if (vector_handler_) {
+            dispatch_message(std::vector<uint8_t>(body.begin(), body.end()), received_at);
+        } else {
+            auto buffer = buffer_pool_.acquire(body.size());
+            std::memcpy(buffer.data(), body.data(), body.size());
+            dispatch_message(std::move(buffer), received_at);
+        }
+        receive_begin_ += length;
+    }
+
+    if (receive_begin_ == receive_end_) {
+        receive_begin_ = 0;
+        receive_end_ = 0;
+    }
+}
+
+// Leaves the unread bytes in the socket until the handlers fall to the low watermark
+inline boost::asio::awaitable<void> PeerTCP::wait_for_receive_room() {
+    const auto room = receive_room_;
+    receive_waiting_ = true;
+    // Orders the flag before reading saturated(), against wake_receive() reading the flag after clearing it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    while (is_connected_ && receive_bytes_.saturated()) {
+        room->expires_at(boost::asio::steady_timer::time_point::max());
+        co_await room->async_wait(as_tuple(boost::asio::use_awaitable));
+    }
+    receive_waiting_ = false;
+}
+
+// Wakes wait_for_receive_room() from any thread; the posted cancel holds the timer, not the peer
+inline void PeerTCP::wake_receive() {
+    if (!receive_waiting_) return;
+    post(ctx_, [room = receive_room_] { room->cancel(); });
+}
+
+// Applies the overflow policy to a received message of size bytes, returning whether to dispatch it
+inline bool PeerTCP::make_room_to_receive(const size_t size) {
+    auto overflow = receive_limits_.overflow;
+    if (overflow == QueueLimits::Overflow::DropOldest && dispatch_.mode() != HandlerDispatch::Mode::DedicatedThread) {
+        // Handlers posted to an executor can't be taken back
+        overflow = QueueLimits::Overflow::DropNewest;
+    }
+
+    switch (overflow) {
+    case QueueLimits::Overflow::Block:
+        // The message is already read, so it is dispatched and the next read waits
+        return true;
+    case QueueLimits::Overflow::DropOldest:
+        while (receive_bytes_.overflows(size)) {
+            auto oldest = receive_queue_.pop();
+            if (!oldest) break;
+            receive_bytes_.sub(body_size(oldest->message));
+            metrics_.receive_queue_depth.sub();
+            metrics_.dropped.add();
+        }
+        return true;
+    case QueueLimits::Overflow::DropNewest:
+        metrics_.dropped.add();
+        return false;
+    case QueueLimits::Overflow::Disconnect:
+        SANHOK_LOG_WARN("[PeerTCP] Receive queue is over {} bytes, disconnecting", receive_limits_.high_watermark);
         disconnect();
-        co_return;
+        return false;
+    }
+    return false;
+}
+
+inline size_t PeerTCP::body_size(const MessageBody& message) {
+    return std::visit([](const auto& body) { return body.size(); }, message);
+}
+
+inline void PeerTCP::dispatch_message(MessageBody&& message, const Timestamp received_at) {
+    const size_t size = body_size(message);
+    metrics_.messages_in.add();
+    if (receive_bytes_.overflows(size) && !make_room_to_receive(size)) return;
+
+    receive_bytes_.add(size);
+    metrics_.receive_queue_depth.add();
+
+    switch (dispatch_.mode()) {
+    case HandlerDispatch::Mode::DedicatedThread:
+        receive_queue_.push({std::move(message), received_at});
+        break;
+    case HandlerDispatch::Mode::Inline:
+        handle_message(std::move(message), received_at);
+        break;
+    case HandlerDispatch::Mode::Executor:
+        ++pending_handlers_;
+        post(*handler_strand_, [this, message = std::move(message), received_at]() mutable {
+            handle_message(std::move(message), received_at);
+            if (--pending_handlers_ == 0) pending_handlers_.notify_all();
+        });
+        break;
     }
+}
+
+inline void PeerTCP::rearm_idle_timer() {
+    if (idle_timer_) idle_timer_->arm(idle_timeout_);
+}
+
+inline void PeerTCP::handle_message(MessageBody&& message, const Timestamp received_at) {
+    const auto handled_at = Timestamp::now();
+    const size_t size = body_size(message);
+    metrics_.queue_wait.record(received_at, handled_at);
+    if (auto* buffer = std::get_if<MessageBuffer>(&message)) {
+        message_handler_(std::move(*buffer));
+    } else {
+        vector_handler_(std::move(std::get<std::vector<uint8_t>>(message)));
+    }
+    metrics_.handler.record(handled_at);
+    receive_bytes_.sub(size);
+    metrics_.receive_queue_depth.sub();
+}
 
-    receive_queue_.push(std::move(body_buffer));
+// A handler destroying its own peer cannot join its thread, which is left to return on its own
+inline void PeerTCP::join_worker() {
+    if (!worker_.joinable()) return;
+
+    if (worker_.get_id() == std::this_thread::get_id()) {
+        worker_.detach();
+    } else {
+        worker_.join();
+    }
 }
 }
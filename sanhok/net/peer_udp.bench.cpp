@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/peer_udp.hpp>
+#include <tests/hello.hpp>
+
+#include <chrono>
+
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+using namespace std::chrono_literals;
+
+namespace {
+const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50110};
+const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50111};
+
+std::shared_ptr<flatbuffers::DetachedBuffer> make_packet(const size_t text_size) {
+    flatbuffers::FlatBufferBuilder builder {64 + text_size};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(std::string(text_size, 'a'))));
+    return std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+}
+
+// Sends the packets over loopback, keeping at most window packets in flight so that none is dropped
+void send_window(const size_t packets, const size_t window, const size_t text_size, const size_t batch_size,
+    const bool segmentation_offload = false) {
+    boost::asio::io_context ctx {};
+    std::atomic<size_t> received {0};
+
+    PeerUDP server {ctx, SERVER_ENDPOINT, [&received](std::span<const uint8_t>) { ++received; }};
+    PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+    if (batch_size > 0) {
+        server.set_batch_io(batch_size);
+        client.set_batch_io(batch_size);
+    }
+    if (segmentation_offload) {
+        server.set_segmentation_offload(true);
+        client.set_segmentation_offload(true);
+    }
+    server.open();
+    client.connect(SERVER_ENDPOINT);
+    client.open();
+
+    const auto packet = make_packet(text_size);
+    size_t sent {0};
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (received < packets && std::chrono::steady_clock::now() < deadline) {
+        while (sent < packets && sent - received < window) {
+            client.send_packet(packet);
+            ++sent;
+        }
+        ctx.poll();
+    }
+
+    server.close();
+    client.close();
+    ctx.run_for(1ms);
+}
+}
+
+TEST_CASE("[PeerUDP]") {
+    constexpr size_t PACKETS = 100000;
+    constexpr size_t WINDOW = 64;
+    constexpr size_t TEXT_SIZE = 32;
+
+    BENCHMARK("A syscall per packet; 100000 Hello of 32 characters, 64 in flight") {
+        send_window(PACKETS, WINDOW, TEXT_SIZE, 0);
+    };
+
+    BENCHMARK("recvmmsg/sendmmsg in batches of 32; 100000 Hello of 32 characters, 64 in flight") {
+        send_window(PACKETS, WINDOW, TEXT_SIZE, 32);
+    };
+
+    BENCHMARK("UDP_SEGMENT/UDP_GRO in batches of 32; 100000 Hello of 32 characters, 64 in flight") {
+        send_window(PACKETS, WINDOW, TEXT_SIZE, 32, true);
+    };
+}
@@ -5,7 +5,36 @@
 #include <flatbuffers/detached_buffer.h>
 #include <sanhok/bip_buffer.hpp>
 #include <sanhok/concurrent_queue.hpp>
-#include <spdlog/spdlog.h>
+#include <sanhok/net/capture.hpp>
+#include <sanhok/net/handler_dispatch.hpp>
+#include <sanhok/net/log.hpp>
+#include <sanhok/net/metrics.hpp>
+#include <sanhok/net/send_buffer.hpp>
+#include <sanhok/net/timing_wheel.hpp>
+#include <sanhok/net/uring_receiver.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+// Older C library headers predate UDP segmentation offload
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
 
 namespace sanhok::net {
 using boost::asio::ip::udp;
@@ -13,108 +42,752 @@ using boost::asio::ip::udp;
 class PeerUDP : boost::noncopyable {
 public:
     PeerUDP(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint,
-        std::function<void(std::vector<uint8_t>&&)>&& packet_handler, size_t receive_buffer_size);
+        std::function<void(std::span<const uint8_t>)>&& packet_handler, size_t receive_buffer_size,
+        size_t receive_ring_size);
     ~PeerUDP();
 
     void connect(const udp::endpoint& remote_endpoint);
     void open();
     void close();
     void send_packet(std::shared_ptr<flatbuffers::DetachedBuffer> packet);
+    void send_packet(MessageBuffer packet);
+    void set_handler_dispatch(HandlerDispatch dispatch);
+    void set_batch_io(size_t batch_size);
+    void set_segmentation_offload(bool enabled);
+    void set_provided_buffers(size_t count);
+    void set_idle_timeout(TimingWheel& wheel, std::chrono::steady_clock::duration timeout);
+    void set_capture(CaptureFile& capture, uint64_t peer_id);
 
     bool is_open() const { return is_open_; }
+    boost::asio::io_context& context() const { return ctx_; }
+    const PeerMetrics& metrics() const { return metrics_; }
     udp::endpoint local_endpoint() const { return socket_.local_endpoint(); }
     udp::endpoint remote_endpoint() const { return socket_.remote_endpoint(); }
 
 private:
+    void send(SendBuffer&& packet);
     boost::asio::awaitable<void> receive_packet();
+    boost::asio::awaitable<void> discard_packet();
+    void count_dropped();
+    void end_dropped_run();
+    void dispatch_packet(size_t size);
+    void handle_packet(size_t size);
+    void join_worker();
+    void rearm_idle_timer();
 
     boost::asio::io_context& ctx_;
     udp::socket socket_;
+    // Bound and connected again when opened after close()
+    const udp::endpoint bound_endpoint_;
+    std::optional<udp::endpoint> connected_endpoint_ {};
     std::atomic<bool> is_open_ {false};
+    // Counts the opens; the receive loop of an earlier open() ends once it sees a later one
+    std::atomic<size_t> opens_ {0};
 
     const size_t receive_buffer_size_;
-    ConcurrentQueue<std::vector<uint8_t>> receive_queue_;
-    std::function<void(std::vector<uint8_t>&&)> packet_handler_;
+    std::unique_ptr<BipBuffer<uint8_t>> receive_buffer_; // Grown on open to fit two receive batches
+    ConcurrentQueue<size_t> receive_queue_; // Sizes of the packets committed to receive_buffer_
+    std::function<void(std::span<const uint8_t>)> packet_handler_;
+    std::atomic<std::thread::id> handler_thread_ {}; // Running packet_handler_
+    size_t dropped_run_ {0}; // Packets dropped in a row for want of room in the ring, on the I/O thread
 
     std::thread worker_;
+
+    // Batched I/O with recvmmsg/sendmmsg; disabled when 0
+    size_t batch_size_ {0};
+    // UDP_GRO and UDP_SEGMENT on top of batched I/O, each turned off on open if the kernel lacks it
+    bool gro_enabled_ {false};
+    bool segment_enabled_ {false};
+#ifdef __linux__
+    // The kernel refuses more segments per UDP_SEGMENT send
+    static constexpr size_t MAX_SEGMENTS {64};
+    static constexpr size_t MAX_SEGMENTED_SIZE {65507};
+    // Assumed for the path of a socket not connected yet
+    static constexpr size_t ETHERNET_MTU {1500};
+    // A UDP_GRO receive coalesces up to an IP payload
+    static constexpr size_t MAX_COALESCED_SIZE {65535};
+
+    union ControlBuffer {
+        cmsghdr header;
+        char data[CMSG_SPACE(sizeof(int))];
+    };
+
+    boost::asio::awaitable<void> receive_packets();
+    boost::asio::awaitable<void> send_packets();
+    void enable_segmentation_offload();
+    void resize_batches();
+    size_t prepare_send_headers(size_t first_header, size_t first_packet, bool coalesce);
+    size_t path_segment_size();
+    // Packets gathered per send, enough for a full UDP_SEGMENT run whatever batch_size_ is
+    size_t send_batch_size() const { return segment_enabled_ ? std::max(batch_size_, MAX_SEGMENTS) : batch_size_; }
+    // Bytes of the receive buffer reserved per datagram
+    size_t receive_slot_size() const {
+        return gro_enabled_ ? std::max(receive_buffer_size_, MAX_COALESCED_SIZE) : receive_buffer_size_;
+    }
+    static size_t received_segment_size(const msghdr& header);
+
+    std::vector<mmsghdr> receive_headers_ {};
+    std::vector<iovec> receive_iovecs_ {};
+    std::vector<ControlBuffer> receive_controls_ {};
+    ConcurrentQueue<SendBuffer> send_queue_ {};
+    std::atomic<bool> is_sending_ {false};
+    std::vector<SendBuffer> sending_packets_ {};
+    std::vector<mmsghdr> send_headers_ {};
+    std::vector<iovec> send_iovecs_ {};
+    std::vector<ControlBuffer> send_controls_ {};
+    // Packets over it are not coalesced, as the kernel refuses segments bigger than the path MTU; 0 until queried
+    size_t max_segment_size_ {0};
+#endif
+
+#ifdef SANHOK_IO_URING
+    boost::asio::awaitable<void> receive_provided();
+
+    // Receives through io_uring into provided buffers of receive_buffer_size_ each; disabled when 0
+    size_t provided_buffers_ {0};
+    std::optional<UringReceiver> uring_receiver_ {};
+#endif
+
+    HandlerDispatch dispatch_ {HandlerDispatch::dedicated_thread()};
+    std::optional<boost::asio::strand<boost::asio::any_io_executor>> handler_strand_ {};
+    std::atomic<size_t> pending_handlers_ {0};
+
+    // Closes when nothing is received for idle_timeout_
+    std::optional<WheelTimer> idle_timer_ {};
+    std::chrono::steady_clock::duration idle_timeout_ {};
+
+    // Appends every received packet to capture_ under capture_peer_id_
+    CaptureFile* capture_ {nullptr};
+    uint64_t capture_peer_id_ {0};
+
+    [[no_unique_address]] PeerMetrics metrics_ {};
 };
 
 inline PeerUDP::PeerUDP(boost::asio::io_context& ctx,
-    const udp::endpoint& local_endpoint, std::function<void(std::vector<uint8_t>&&)>&& packet_handler,
-    const size_t receive_buffer_size = 65536)
-    : ctx_(ctx), socket_(ctx_, local_endpoint),
-    receive_buffer_size_(receive_buffer_size), packet_handler_(std::move(packet_handler)) {}
+    const udp::endpoint& local_endpoint, std::function<void(std::span<const uint8_t>)>&& packet_handler,
+    const size_t receive_buffer_size = 65536, const size_t receive_ring_size = 1 << 20)
+    : ctx_(ctx), socket_(ctx_, local_endpoint), bound_endpoint_(socket_.local_endpoint()),
+    receive_buffer_size_(receive_buffer_size),
+    receive_buffer_(std::make_unique<BipBuffer<uint8_t>>(std::max(receive_ring_size, receive_buffer_size * 2))),
+    packet_handler_(std::move(packet_handler)) {
+    MetricsRegistry::instance().add("PeerUDP", metrics_);
+}
 
 inline PeerUDP::~PeerUDP() {
+    // Waits for its handler, which closes
+    idle_timer_.reset();
     close();
-    if (worker_.joinable()) worker_.join();
+    join_worker();
+
+    // Handlers posted to a shared executor still refer to this peer
+    for (size_t pending = pending_handlers_.load(); pending > 0; pending = pending_handlers_.load()) {
+        pending_handlers_.wait(pending);
+    }
+
+    MetricsRegistry::instance().remove(metrics_);
 }
 
 inline void PeerUDP::connect(const udp::endpoint& remote_endpoint) {
     try {
         socket_.connect(remote_endpoint);
+        connected_endpoint_ = remote_endpoint;
     } catch (const boost::system::system_error& e) {
-        spdlog::error("[PeerUDP] Error connecting socket: {}", e.what());
+        SANHOK_LOG_ERROR("[PeerUDP] Error connecting socket: {}", e.what());
     }
 }
 
+// Opening again after close() binds a new socket to the same endpoints and drops what was received before
 inline void PeerUDP::open() {
     if (is_open_) return;
+    if (handler_thread_ == std::this_thread::get_id()) {
+        SANHOK_LOG_ERROR("[PeerUDP] A packet handler cannot open its own peer");
+        return;
+    }
+
+    // The handlers of a previous open() have to return before the ring they read from is emptied
+    join_worker();
+    for (size_t pending = pending_handlers_.load(); pending > 0; pending = pending_handlers_.load()) {
+        pending_handlers_.wait(pending);
+    }
+    receive_buffer_->reset();
+    receive_queue_.clear();
+
+    if (!socket_.is_open()) {
+        try {
+            socket_.open(bound_endpoint_.protocol());
+            socket_.bind(bound_endpoint_);
+            if (connected_endpoint_) socket_.connect(*connected_endpoint_);
+        } catch (const boost::system::system_error& e) {
+            SANHOK_LOG_ERROR("[PeerUDP] Error opening socket: {}", e.what());
+            boost::system::error_code ec;
+            socket_.close(ec);
+            return;
+        }
+    }
+    is_open_ = true;
+
+#ifdef __linux__
+    if (gro_enabled_ || segment_enabled_) enable_segmentation_offload();
+    // A batch reserves a slot per datagram; the ring fits two, one for the receive and one the handlers read
+    if (const size_t ring_size = batch_size_ * receive_slot_size() * 2; ring_size > receive_buffer_->capacity()) {
+        receive_buffer_ = std::make_unique<BipBuffer<uint8_t>>(ring_size);
+    }
+#endif
+#ifdef SANHOK_IO_URING
+    if (provided_buffers_ > 0) {
+        uring_receiver_.emplace(ctx_, socket_.native_handle(), receive_buffer_size_, provided_buffers_);
+        if (!uring_receiver_->open()) {
+            SANHOK_LOG_WARN("[PeerUDP] Falling back to receiving without io_uring");
+            uring_receiver_.reset();
+        }
+    }
+#endif
+
+    rearm_idle_timer();
 
     // Start receiving packets
-    co_spawn(ctx_, [this]()->boost::asio::awaitable<void> {
-        while (is_open_) {
+    co_spawn(ctx_, [this, open = ++opens_]()->boost::asio::awaitable<void> {
+        while (is_open_ && open == opens_) {
+#ifdef SANHOK_IO_URING
+            if (uring_receiver_) {
+                co_await receive_provided();
+                continue;
+            }
+#endif
+#ifdef __linux__
+            if (batch_size_ > 0) {
+                co_await receive_packets();
+                continue;
+            }
+#endif
             co_await receive_packet();
         }
     }, boost::asio::detached);
 
-    // Start handling packets
-    worker_ = std::thread([this] {
-        while (is_open_) {
-            auto packet = receive_queue_.pop_wait();
-            if (!packet) return;
-            packet_handler_(std::move(*packet));
-        }
-    });
-    worker_.detach();
-
-    is_open_ = true;
+    switch (dispatch_.mode()) {
+    case HandlerDispatch::Mode::DedicatedThread:
+        // Start handling packets
+        worker_ = std::thread([this] {
+            while (const auto size = receive_queue_.pop_wait([this] { return !is_open_; })) {
+                handle_packet(*size);
+            }
+        });
+        break;
+    case HandlerDispatch::Mode::Executor:
+        handler_strand_.emplace(dispatch_.executor());
+        break;
+    case HandlerDispatch::Mode::Inline:
+        break;
+    }
 }
 
 inline void PeerUDP::close() {
     if (!is_open_.exchange(false)) return;
 
+    if constexpr (METRICS_ENABLED) {
+        while (receive_queue_.pop()) metrics_.receive_queue_depth.sub();
+    }
     receive_queue_.clear();
+    if (idle_timer_) idle_timer_->cancel();
+
+#ifdef SANHOK_IO_URING
+    if (uring_receiver_) uring_receiver_->close();
+#endif
 
     try {
         socket_.close();
     } catch (const boost::system::system_error& e) {
-        spdlog::error("[PeerUDP] Error closing socket: {}", e.what());
+        SANHOK_LOG_ERROR("[PeerUDP] Error closing socket: {}", e.what());
     }
 }
 
 inline void PeerUDP::send_packet(std::shared_ptr<flatbuffers::DetachedBuffer> packet) {
+    send(std::move(packet));
+}
+
+inline void PeerUDP::send_packet(MessageBuffer packet) {
+    send(std::move(packet));
+}
+
+// Packets sent while the peer is not open are dropped, with or without batched I/O, as PeerTCP drops messages
+// while it is not connected
+inline void PeerUDP::send(SendBuffer&& packet) {
+    if (!packet || !is_open_) return;
+
+#ifdef __linux__
+    if (batch_size_ > 0) {
+        send_queue_.push(std::move(packet));
+        metrics_.send_queue_depth.add();
+        if (is_sending_.exchange(true)) return;
+        co_spawn(ctx_, send_packets(), boost::asio::detached);
+        return;
+    }
+#endif
+
     co_spawn(ctx_, [this, packet = std::move(packet)]()->boost::asio::awaitable<void> {
-        const auto [ec, _] = co_await socket_.async_send(
-            boost::asio::buffer(packet->data(), packet->size()), as_tuple(boost::asio::use_awaitable));
+        const auto [ec, sent] = co_await socket_.async_send(packet.buffer(), as_tuple(boost::asio::use_awaitable));
 
         if (ec) {
-            spdlog::error("[PeerUDP] Error sending packet: {}", ec.what());
+            SANHOK_LOG_ERROR("[PeerUDP] Error sending packet: {}", ec.what());
+            metrics_.send_errors.add();
             close();
+            co_return;
         }
+        metrics_.messages_out.add();
+        metrics_.bytes_out.add(sent);
+        metrics_.datagrams_out.add();
     }, boost::asio::detached);
 }
 
+inline void PeerUDP::set_handler_dispatch(HandlerDispatch dispatch) {
+    dispatch_ = std::move(dispatch);
+}
+
+inline void PeerUDP::set_batch_io(const size_t batch_size) {
+    if (is_open_) {
+        SANHOK_LOG_ERROR("[PeerUDP] Batch I/O has to be set before opening");
+        return;
+    }
+
+#ifdef __linux__
+    batch_size_ = batch_size;
+    resize_batches();
+#else
+    SANHOK_LOG_WARN("[PeerUDP] Batch I/O is only supported on Linux");
+#endif
+}
+
+// Sends runs of up to MAX_SEGMENTS equally sized packets as one UDP_SEGMENT buffer, whatever the batch size, and
+// splits UDP_GRO receives back into packets; a coalesced receive takes a slot of at least MAX_COALESCED_SIZE.
+// Packets that do not fit a datagram within the path MTU go out one by one.
+// Batched I/O is turned on with batches of 1 if it has not been set yet.
+inline void PeerUDP::set_segmentation_offload(const bool enabled) {
+    if (is_open_) {
+        SANHOK_LOG_ERROR("[PeerUDP] Segmentation offload has to be set before opening");
+        return;
+    }
+
+#ifdef __linux__
+    gro_enabled_ = enabled;
+    segment_enabled_ = enabled;
+    if (enabled && batch_size_ == 0) batch_size_ = 1;
+    resize_batches();
+#else
+    SANHOK_LOG_WARN("[PeerUDP] Segmentation offload is only supported on Linux");
+#endif
+}
+
+// Receives with io_uring into a ring of count buffers of receive_buffer_size bytes the kernel fills without a
+// read per packet. Falls back to the other receive paths if the kernel lacks io_uring or provided buffer rings.
+inline void PeerUDP::set_provided_buffers([[maybe_unused]] const size_t count) {
+    if (is_open_) {
+        SANHOK_LOG_ERROR("[PeerUDP] Provided buffers have to be set before opening");
+        return;
+    }
+
+#ifdef SANHOK_IO_URING
+    provided_buffers_ = count;
+#else
+    SANHOK_LOG_WARN("[PeerUDP] Provided buffers need libnet built with SANHOK_IO_URING");
+#endif
+}
+
+// Closes after timeout without receiving a packet, timed by a wheel shared with the other peers
+inline void PeerUDP::set_idle_timeout(TimingWheel& wheel, const std::chrono::steady_clock::duration timeout) {
+    if (is_open_) {
+        SANHOK_LOG_ERROR("[PeerUDP] Idle timeout has to be set before opening");
+        return;
+    }
+
+    idle_timeout_ = timeout;
+    idle_timer_.emplace(wheel, [this] {
+        if (!is_open_) return;
+        SANHOK_LOG_WARN("[PeerUDP] Nothing received for {}ms, closing",
+            std::chrono::duration_cast<std::chrono::milliseconds>(idle_timeout_).count());
+        close();
+    });
+}
+
+// Records every packet received, tagged with peer_id
+inline void PeerUDP::set_capture(CaptureFile& capture, const uint64_t peer_id) {
+    if (is_open_) {
+        SANHOK_LOG_ERROR("[PeerUDP] Capture has to be set before opening");
+        return;
+    }
+
+    capture_ = &capture;
+    capture_peer_id_ = peer_id;
+}
+
 inline boost::asio::awaitable<void> PeerUDP::receive_packet() {
-    std::vector<uint8_t> buffer(receive_buffer_size_);
-    //TODO: Use ring buffer to pack packets without new memory allocations
+    const auto buffer = receive_buffer_->reserve(receive_buffer_size_);
+    if (buffer.empty()) {
+        co_await discard_packet();
+        co_return;
+    }
+    end_dropped_run();
+
+    const auto [ec, size] = co_await socket_.async_receive(
+        boost::asio::buffer(buffer.data(), buffer.size()), as_tuple(boost::asio::use_awaitable));
+    if (ec) {
+        // Aborted by close(), which open() may have followed already
+        if (ec == boost::asio::error::operation_aborted) co_return;
+
+        SANHOK_LOG_ERROR("[PeerUDP] Error receiving packet: {}", ec.what());
+        metrics_.receive_errors.add();
+        close();
+        co_return;
+    }
+
+    if (capture_) capture_->append(capture_peer_id_, CaptureProtocol::UDP, buffer.first(size));
+    receive_buffer_->commit(size);
+    dispatch_packet(size);
+}
+
+// The handler is falling behind; discards the datagram instead of allocating for it
+inline boost::asio::awaitable<void> PeerUDP::discard_packet() {
+    count_dropped();
+    co_await socket_.async_receive(boost::asio::mutable_buffer(), as_tuple(boost::asio::use_awaitable));
+}
+
+// Warns once per run of drops rather than per packet, which would flood the log while the handlers fall behind
+inline void PeerUDP::count_dropped() {
+    metrics_.dropped.add();
+    if (dropped_run_++ == 0) SANHOK_LOG_WARN("[PeerUDP] Receive buffer is full, dropping packets");
+}
 
-    if (const auto [ec, _] = co_await socket_.async_receive(
-        boost::asio::buffer(buffer.data(), buffer.size()), as_tuple(boost::asio::use_awaitable)); ec) {
-        spdlog::error("[PeerUDP] Error receiving packet: {}", ec.what());
+inline void PeerUDP::end_dropped_run() {
+    if (dropped_run_ == 0) return;
+    SANHOK_LOG_INFO("[PeerUDP] Receive buffer has room again after dropping {} packets", dropped_run_);
+    dropped_run_ = 0;
+}
+
+#ifdef __linux__
+inline boost::asio::awaitable<void> PeerUDP::receive_packets() {
+    // Reserve a slot per datagram, halving the batch while the handlers hold the room
+    const size_t slot_size = receive_slot_size();
+    size_t slots = batch_size_;
+    auto buffer = receive_buffer_->reserve(slots * slot_size);
+    while (buffer.empty() && slots > 1) {
+        slots /= 2;
+        buffer = receive_buffer_->reserve(slots * slot_size);
+    }
+    if (buffer.empty()) {
+        co_await discard_packet();
+        co_return;
+    }
+    end_dropped_run();
+
+    if (const auto [ec] = co_await socket_.async_wait(udp::socket::wait_read, as_tuple(boost::asio::use_awaitable)); ec) {
+        // Aborted by close(), which open() may have followed already
+        if (ec == boost::asio::error::operation_aborted) co_return;
+
+        SANHOK_LOG_ERROR("[PeerUDP] Error waiting for packets: {}", ec.what());
+        metrics_.receive_errors.add();
         close();
         co_return;
     }
-    receive_queue_.push(std::move(buffer));
+
+    for (size_t i = 0; i < slots; ++i) {
+        receive_iovecs_[i] = {buffer.data() + i * slot_size, slot_size};
+        receive_headers_[i] = {};
+        receive_headers_[i].msg_hdr.msg_iov = &receive_iovecs_[i];
+        receive_headers_[i].msg_hdr.msg_iovlen = 1;
+        if (gro_enabled_) {
+            receive_headers_[i].msg_hdr.msg_control = &receive_controls_[i];
+            receive_headers_[i].msg_hdr.msg_controllen = sizeof(ControlBuffer);
+        }
+    }
+
+    const int received = ::recvmmsg(socket_.native_handle(), receive_headers_.data(), slots, MSG_DONTWAIT, nullptr);
+    if (received < 0) {
+        receive_buffer_->commit(0);
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) co_return;
+
+        SANHOK_LOG_ERROR("[PeerUDP] Error receiving packets: {}", std::strerror(errno));
+        metrics_.receive_errors.add();
+        close();
+        co_return;
+    }
+
+    // Pack the packets back to back so the handler side releases them in order
+    size_t used {0};
+    size_t truncated {0};
+    for (int i = 0; i < received; ++i) {
+        const auto& header = receive_headers_[i];
+        if (header.msg_hdr.msg_flags & MSG_TRUNC) {
+            ++truncated;
+            continue;
+        }
+
+        if (used != i * slot_size) {
+            std::memmove(buffer.data() + used, buffer.data() + i * slot_size, header.msg_len);
+        }
+        used += header.msg_len;
+    }
+    receive_buffer_->commit(used);
+    // Once per batch, as a peer sending oversized packets would flood the log
+    if (truncated > 0) {
+        SANHOK_LOG_WARN("[PeerUDP] Dropped {} packets bigger than {} bytes", truncated, slot_size);
+        metrics_.dropped.add(truncated);
+    }
+
+    const uint8_t* packet = buffer.data();
+    for (int i = 0; i < received; ++i) {
+        // Empty datagrams are dispatched like in receive_packet()
+        if (receive_headers_[i].msg_hdr.msg_flags & MSG_TRUNC) continue;
+        const size_t size = receive_headers_[i].msg_len;
+
+        // A coalesced receive is a run of segment_size packets, the last one possibly shorter
+        const size_t segment_size = gro_enabled_ ? received_segment_size(receive_headers_[i].msg_hdr) : 0;
+        if (segment_size == 0 || segment_size >= size) {
+            if (capture_) capture_->append(capture_peer_id_, CaptureProtocol::UDP, {packet, size});
+            dispatch_packet(size);
+            packet += size;
+            continue;
+        }
+        for (size_t offset = 0; offset < size; offset += segment_size) {
+            const size_t segment = std::min(segment_size, size - offset);
+            if (capture_) capture_->append(capture_peer_id_, CaptureProtocol::UDP, {packet, segment});
+            dispatch_packet(segment);
+            packet += segment;
+        }
+    }
+}
+
+inline size_t PeerUDP::received_segment_size(const msghdr& header) {
+    for (auto cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&header), cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int segment_size;
+            std::memcpy(&segment_size, CMSG_DATA(cmsg), sizeof(segment_size));
+            return segment_size;
+        }
+    }
+    return 0;
+}
+
+inline void PeerUDP::enable_segmentation_offload() {
+    const int fd = socket_.native_handle();
+
+    constexpr int enable {1};
+    if (gro_enabled_ && ::setsockopt(fd, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) < 0) {
+        SANHOK_LOG_WARN("[PeerUDP] UDP_GRO is not supported, receiving packets one by one: {}", std::strerror(errno));
+        gro_enabled_ = false;
+    }
+
+    // Only probes for UDP_SEGMENT; the segment size is given per send
+    constexpr int probe {0};
+    if (segment_enabled_ && ::setsockopt(fd, SOL_UDP, UDP_SEGMENT, &probe, sizeof(probe)) < 0) {
+        SANHOK_LOG_WARN("[PeerUDP] UDP_SEGMENT is not supported, sending packets one by one: {}", std::strerror(errno));
+        segment_enabled_ = false;
+    }
+}
+
+// The payload of a datagram that fits the path MTU of the connected socket
+inline size_t PeerUDP::path_segment_size() {
+    boost::system::error_code ec;
+    const bool v6 = socket_.local_endpoint(ec).protocol() == udp::v6();
+
+    int mtu {0};
+    socklen_t length {sizeof(mtu)};
+    const int result = v6
+        ? ::getsockopt(socket_.native_handle(), IPPROTO_IPV6, IPV6_MTU, &mtu, &length)
+        : ::getsockopt(socket_.native_handle(), IPPROTO_IP, IP_MTU, &mtu, &length);
+    if (result < 0) mtu = ETHERNET_MTU;
+
+    const size_t headers = (v6 ? 40 : 20) + sizeof(udphdr);
+    return static_cast<size_t>(mtu) > headers ? mtu - headers : 0;
+}
+
+inline void PeerUDP::resize_batches() {
+    receive_headers_.resize(batch_size_);
+    receive_iovecs_.resize(batch_size_);
+    receive_controls_.resize(batch_size_);
+
+    const size_t send_batch = send_batch_size();
+    send_headers_.resize(send_batch);
+    send_iovecs_.resize(send_batch);
+    send_controls_.resize(send_batch);
+    sending_packets_.reserve(send_batch);
+}
+
+// Builds a header per run of equally sized packets in sending_packets_, from first_packet into send_headers_ from
+// first_header, and returns the number of headers; each packet gets its own header unless coalesce
+inline size_t PeerUDP::prepare_send_headers(const size_t first_header, const size_t first_packet, const bool coalesce) {
+    size_t headers {first_header};
+    for (size_t i = first_packet; i < sending_packets_.size(); ++headers) {
+        const size_t size = send_iovecs_[i].iov_len;
+        size_t run {1};
+        if (coalesce && size > 0 && size <= max_segment_size_) {
+            while (i + run < sending_packets_.size() && run < MAX_SEGMENTS
+                && send_iovecs_[i + run].iov_len == size && (run + 1) * size <= MAX_SEGMENTED_SIZE) {
+                ++run;
+            }
+        }
+
+        auto& header = send_headers_[headers] = {};
+        header.msg_hdr.msg_iov = &send_iovecs_[i];
+        header.msg_hdr.msg_iovlen = run;
+        if (run > 1) {
+            header.msg_hdr.msg_control = &send_controls_[headers];
+            header.msg_hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+            const auto cmsg = CMSG_FIRSTHDR(&header.msg_hdr);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            const auto segment_size = static_cast<uint16_t>(size);
+            std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+        i += run;
+    }
+    return headers;
+}
+
+inline boost::asio::awaitable<void> PeerUDP::send_packets() {
+    while (true) {
+        while (!send_queue_.empty()) {
+            for (const size_t batch = send_batch_size(); sending_packets_.size() < batch;) {
+                auto packet = send_queue_.pop();
+                if (!packet) break;
+                metrics_.send_queue_depth.sub();
+
+                send_iovecs_[sending_packets_.size()] = {const_cast<uint8_t*>(packet->data()), packet->size()};
+                sending_packets_.push_back(std::move(*packet));
+            }
+
+            if (segment_enabled_ && max_segment_size_ == 0) max_segment_size_ = path_segment_size();
+            size_t headers = prepare_send_headers(0, 0, segment_enabled_);
+            size_t sent {0};
+            while (sent < headers) {
+                const int result = ::sendmmsg(socket_.native_handle(), send_headers_.data() + sent,
+                    headers - sent, MSG_DONTWAIT);
+                if (result >= 0) {
+                    for (size_t i = sent; i < sent + result; ++i) {
+                        metrics_.messages_out.add(send_headers_[i].msg_hdr.msg_iovlen);
+                        metrics_.bytes_out.add(send_headers_[i].msg_len);
+                        metrics_.datagrams_out.add();
+                    }
+                    sent += result;
+                    continue;
+                }
+                if (errno == EINTR) continue;
+
+                // The route takes smaller segments than it did; the run goes out a datagram per packet
+                if (errno == EINVAL && send_headers_[sent].msg_hdr.msg_iovlen > 1) {
+                    const size_t packet = send_headers_[sent].msg_hdr.msg_iov - send_iovecs_.data();
+                    const size_t segment_size = send_iovecs_[packet].iov_len;
+                    SANHOK_LOG_WARN("[PeerUDP] UDP_SEGMENT refused {} byte segments, sending them one by one",
+                        segment_size);
+                    max_segment_size_ = std::min(path_segment_size(), segment_size - 1);
+                    headers = prepare_send_headers(sent, packet, false);
+                    continue;
+                }
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    const auto [ec] = co_await socket_.async_wait(udp::socket::wait_write,
+                        as_tuple(boost::asio::use_awaitable));
+                    if (!ec) continue;
+                    SANHOK_LOG_ERROR("[PeerUDP] Error waiting to send packets: {}", ec.message());
+                } else {
+                    SANHOK_LOG_ERROR("[PeerUDP] Error sending packets: {}", std::strerror(errno));
+                }
+                metrics_.send_errors.add();
+                sending_packets_.clear();
+                // Sends again once opened after close()
+                is_sending_ = false;
+                close();
+                co_return;
+            }
+            sending_packets_.clear();
+        }
+
+        is_sending_ = false;
+
+        // Keep sending if a packet was pushed after the queue was found empty
+        if (send_queue_.empty() || is_sending_.exchange(true)) break;
+    }
+}
+#endif
+
+#ifdef SANHOK_IO_URING
+inline boost::asio::awaitable<void> PeerUDP::receive_provided() {
+    co_await uring_receiver_->receive([this](const boost::system::error_code& ec, std::span<const uint8_t> packet) {
+        // Aborted by close(), which open() may have followed already
+        if (ec == boost::asio::error::operation_aborted) return;
+        if (ec) {
+            SANHOK_LOG_ERROR("[PeerUDP] Error receiving packet: {}", ec.what());
+            metrics_.receive_errors.add();
+            close();
+            return;
+        }
+        if (capture_) capture_->append(capture_peer_id_, CaptureProtocol::UDP, packet);
+
+        // Inline handlers read the provided buffer before it goes back to the ring
+        if (dispatch_.mode() == HandlerDispatch::Mode::Inline) {
+            metrics_.messages_in.add();
+            metrics_.bytes_in.add(packet.size());
+            rearm_idle_timer();
+            packet_handler_(packet);
+            return;
+        }
+
+        const auto buffer = receive_buffer_->reserve(packet.size());
+        if (buffer.size() < packet.size()) {
+            count_dropped();
+            return;
+        }
+        end_dropped_run();
+        std::ranges::copy(packet, buffer.begin());
+        receive_buffer_->commit(packet.size());
+        dispatch_packet(packet.size());
+    });
+}
+#endif
+
+inline void PeerUDP::dispatch_packet(const size_t size) {
+    metrics_.messages_in.add();
+    metrics_.bytes_in.add(size);
+    metrics_.receive_queue_depth.add();
+    rearm_idle_timer();
+
+    switch (dispatch_.mode()) {
+    case HandlerDispatch::Mode::DedicatedThread:
+        receive_queue_.push(size);
+        break;
+    case HandlerDispatch::Mode::Inline:
+        handle_packet(size);
+        break;
+    case HandlerDispatch::Mode::Executor:
+        ++pending_handlers_;
+        post(*handler_strand_, [this, size] {
+            handle_packet(size);
+            if (--pending_handlers_ == 0) pending_handlers_.notify_all();
+        });
+        break;
+    }
+}
+
+// Handles the packet in place and hands its space back to the receiver
+inline void PeerUDP::handle_packet(const size_t size) {
+    handler_thread_ = std::this_thread::get_id();
+    packet_handler_(receive_buffer_->read().first(size));
+    receive_buffer_->release(size);
+    handler_thread_ = std::thread::id {};
+    metrics_.receive_queue_depth.sub();
+}
+
+inline void PeerUDP::rearm_idle_timer() {
+    if (idle_timer_) idle_timer_->arm(idle_timeout_);
+}
+
+// A handler destroying its own peer cannot join its thread, which is left to return on its own
+inline void PeerUDP::join_worker() {
+    if (!worker_.joinable()) return;
+
+    if (worker_.get_id() == std::this_thread::get_id()) {
+        worker_.detach();
+    } else {
+        worker_.join();
+    }
 }
 }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace sanhok::net {
+/*
+ * Byte watermarks of a PeerTCP queue and what to do with a message that would go over the high one
+ * on_high is called once the queue hits the high watermark and on_low once it falls back to the low one,
+ * on whichever thread queued or released the bytes.
+ */
+struct QueueLimits {
+    enum class Overflow {
+        // Sending blocks the caller until the queue falls to the low watermark, unless it is on the io_context
+        // thread that writes; receiving stops reading the socket, so that TCP flow control holds the sender
+        Block,
+        DropOldest, // Drops queued messages to make room; received ones only with HandlerDispatch::dedicated_thread()
+        DropNewest,
+        Disconnect,
+    };
+
+    size_t high_watermark {SIZE_MAX};
+    size_t low_watermark {0};
+    Overflow overflow {Overflow::Block};
+    std::function<void()> on_high {};
+    std::function<void()> on_low {};
+};
+
+/*
+ * Bytes in a queue against its QueueLimits
+ * A single message bigger than the high watermark still fits into an empty queue. on_room is called after on_low,
+ * for the owner of the queue to wake what waits for room other than wait().
+ */
+class QueueBytes {
+public:
+    explicit QueueBytes(const QueueLimits& limits, std::function<void()> on_room = {})
+        : limits_(limits), on_room_(std::move(on_room)) {}
+
+    size_t load() const { return bytes_.load(std::memory_order_relaxed); }
+    // Between hitting the high watermark and falling back to the low one
+    bool saturated() const { return saturated_.load(std::memory_order_relaxed); }
+
+    bool overflows(size_t size);
+    void add(size_t size);
+    void sub(size_t size);
+
+    // Blocks until the queue is not saturated or stop() returns true
+    template <typename Stop>
+    void wait(Stop stop);
+    // Wakes wait() to check stop()
+    void notify();
+
+private:
+    const QueueLimits& limits_;
+    const std::function<void()> on_room_;
+    std::atomic<size_t> bytes_ {0};
+    std::atomic<bool> saturated_ {false};
+
+    std::mutex mutex_ {};
+    std::condition_variable room_ {};
+};
+
+// Whether size more bytes go over the high watermark; the first overflow calls on_high
+inline bool QueueBytes::overflows(const size_t size) {
+    const size_t bytes = load();
+    if (bytes == 0 || bytes + size <= limits_.high_watermark) return false;
+
+    if (!saturated_.exchange(true) && limits_.on_high) limits_.on_high();
+    return true;
+}
+
+inline void QueueBytes::add(const size_t size) {
+    bytes_.fetch_add(size, std::memory_order_relaxed);
+}
+
+inline void QueueBytes::sub(const size_t size) {
+    const size_t bytes = bytes_.fetch_sub(size, std::memory_order_relaxed) - size;
+    if (bytes > limits_.low_watermark || !saturated() || !saturated_.exchange(false)) return;
+
+    if (limits_.on_low) limits_.on_low();
+    notify();
+    if (on_room_) on_room_();
+}
+
+template <typename Stop>
+void QueueBytes::wait(Stop stop) {
+    std::unique_lock lock {mutex_};
+    room_.wait(lock, [this, &stop] { return !saturated() || stop(); });
+}
+
+inline void QueueBytes::notify() {
+    // Locking orders the notification after a waiter that checked its predicate
+    { std::lock_guard lock {mutex_}; }
+    room_.notify_all();
+}
+}
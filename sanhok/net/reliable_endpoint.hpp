@@ -0,0 +1,445 @@
+#pragma once
+
+#include <sanhok/buffer_pool.hpp>
+#include <sanhok/net/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace sanhok::net {
+enum class ChannelMode : uint8_t {
+    Unreliable, // At most once, in any order
+    UnreliableSequenced, // At most once, dropping messages older than the last delivered one
+    ReliableUnordered, // Exactly once, in any order
+    ReliableOrdered, // Exactly once, in the order sent
+};
+
+/*
+ * The reliability layer of a UDP connection without any I/O; its owner feeds it packets and the time
+ * Every packet has a sequence number and acks the latest 33 packets received with a bitfield, so acks ride on
+ * the traffic both ways and an ack-only packet goes out only when there is none for a while or a burst comes in.
+ * Messages of reliable channels are sent again when their packet is not acked within a retransmission timeout
+ * estimated from RTT like TCP, with each send in a new packet so that every ack is an RTT sample. A message has
+ * to fit in one packet.
+ */
+class ReliableEndpoint {
+public:
+    using Clock = std::chrono::steady_clock;
+    using PacketSender = std::function<void(std::span<const uint8_t>)>;
+    using MessageHandler = std::function<void(uint8_t, std::span<const uint8_t>)>; // (channel, message)
+
+    struct Config {
+        size_t max_packet_size {1200};
+        Clock::duration ack_delay {std::chrono::milliseconds {5}}; // Before an ack-only packet
+        Clock::duration initial_rto {std::chrono::milliseconds {100}};
+        Clock::duration min_rto {std::chrono::milliseconds {10}};
+        Clock::duration max_rto {std::chrono::seconds {1}};
+    };
+
+    struct Stats {
+        uint64_t packets_sent;
+        uint64_t packets_received;
+        uint64_t retransmissions;
+        uint64_t duplicates; // Messages of reliable channels received again
+    };
+
+    static constexpr size_t HEADER_SIZE {12};
+
+    ReliableEndpoint(std::vector<ChannelMode> channels, PacketSender packet_sender, MessageHandler message_handler,
+        Config config);
+
+    // Returns false if the channel doesn't exist or the message doesn't fit in a packet
+    bool send(uint8_t channel, std::span<const uint8_t> message, Clock::time_point now);
+    void receive(std::span<const uint8_t> packet, Clock::time_point now);
+    // Sends messages again after their timeout and acks that found no packet to ride on; call it every few ms
+    void update(Clock::time_point now);
+
+    Clock::duration rtt() const { return srtt_; }
+    Clock::duration rto() const { return rto_; }
+    // Messages of reliable channels not acked yet
+    size_t unacked() const;
+    Stats stats() const { return stats_; }
+
+private:
+    static constexpr uint8_t ACK_ONLY {0xFF}; // Channel of a packet without a message
+    static constexpr uint8_t HAS_ACK {0x01}; // Flag of a packet sent after receiving any
+    static constexpr size_t SEQUENCE_BUFFER_SIZE {1024};
+    static constexpr uint16_t MESSAGE_WINDOW {256}; // Messages of a reliable channel in flight
+    static constexpr uint32_t ACK_EVERY {16}; // Packets received, half of those an ack covers
+    static constexpr uint32_t MAX_BACKOFF_SHIFT {2};
+
+    struct SentPacket {
+        uint16_t sequence;
+        bool valid;
+        bool acked;
+        uint8_t channel;
+        uint16_t message_id;
+        Clock::time_point sent_at;
+    };
+
+    struct ReceivedPacket {
+        uint16_t sequence;
+        bool valid;
+    };
+
+    struct OutgoingMessage {
+        uint16_t id;
+        MessageBuffer payload;
+        Clock::time_point sent_at;
+        uint32_t sends;
+        bool acked;
+    };
+
+    struct IncomingMessage {
+        uint16_t id;
+        bool received;
+        MessageBuffer payload; // Held on ReliableOrdered until the messages before it are delivered
+    };
+
+    struct Channel {
+        ChannelMode mode;
+        uint16_t next_send_id;
+        uint16_t next_receive_id; // The oldest not received if reliable, or the newest delivered + 1 if sequenced
+        std::deque<OutgoingMessage> outgoing; // Reliable ones from the oldest not acked, with consecutive ids
+        std::vector<IncomingMessage> incoming; // MESSAGE_WINDOW slots by id if reliable
+    };
+
+    static bool is_reliable(ChannelMode mode);
+    // Whether sequence a is after b, wrapping around
+    static bool is_newer(uint16_t a, uint16_t b);
+
+    void send_packet(uint8_t channel, uint16_t message_id, std::span<const uint8_t> payload, Clock::time_point now);
+    void send_ack(uint16_t ack, Clock::time_point now);
+    void send_message(uint8_t channel, OutgoingMessage& message, Clock::time_point now);
+    void acknowledge(uint16_t sequence, Clock::time_point now);
+    void update_rto(Clock::duration sample);
+    bool record_received(uint16_t sequence);
+    uint32_t ack_bits(uint16_t ack) const;
+    void deliver(uint8_t index, uint16_t message_id, std::span<const uint8_t> payload);
+
+    const Config config_;
+    PacketSender packet_sender_;
+    MessageHandler message_handler_;
+    std::vector<Channel> channels_ {};
+
+    uint16_t next_sequence_ {0};
+    std::vector<SentPacket> sent_packets_;
+    std::vector<uint8_t> packet_ {};
+
+    uint16_t remote_sequence_ {0}; // The newest received
+    bool has_received_ {false};
+    std::vector<ReceivedPacket> received_packets_;
+    bool ack_pending_ {false};
+    Clock::time_point ack_pending_since_ {};
+    uint32_t packets_to_ack_ {0};
+
+    bool rtt_measured_ {false};
+    Clock::duration srtt_ {};
+    Clock::duration rttvar_ {};
+    Clock::duration rto_;
+
+    Stats stats_ {};
+};
+
+namespace detail {
+inline void write_u16(uint8_t* out, const uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+inline void write_u32(uint8_t* out, const uint32_t value) {
+    write_u16(out, static_cast<uint16_t>(value));
+    write_u16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+
+inline uint16_t read_u16(const uint8_t* in) {
+    return static_cast<uint16_t>(in[0] | in[1] << 8);
+}
+
+inline uint32_t read_u32(const uint8_t* in) {
+    return read_u16(in) | static_cast<uint32_t>(read_u16(in + 2)) << 16;
+}
+}
+
+inline ReliableEndpoint::ReliableEndpoint(std::vector<ChannelMode> channels, PacketSender packet_sender,
+    MessageHandler message_handler, const Config config = {})
+    : config_(config), packet_sender_(std::move(packet_sender)), message_handler_(std::move(message_handler)),
+    sent_packets_(SEQUENCE_BUFFER_SIZE), received_packets_(SEQUENCE_BUFFER_SIZE), rto_(config.initial_rto) {
+    if (channels.size() >= ACK_ONLY) {
+        SANHOK_LOG_ERROR("[ReliableEndpoint] {} channels are more than {}", channels.size(), ACK_ONLY);
+        channels.resize(ACK_ONLY);
+    }
+
+    for (const ChannelMode mode : channels) {
+        channels_.push_back({mode, 0, 0, {}, {}});
+        if (is_reliable(mode)) channels_.back().incoming.resize(MESSAGE_WINDOW);
+    }
+    packet_.reserve(config_.max_packet_size);
+}
+
+inline bool ReliableEndpoint::send(const uint8_t channel, const std::span<const uint8_t> message,
+    const Clock::time_point now) {
+    if (channel >= channels_.size()) {
+        SANHOK_LOG_ERROR("[ReliableEndpoint] No channel {}", channel);
+        return false;
+    }
+    if (HEADER_SIZE + message.size() > config_.max_packet_size) {
+        SANHOK_LOG_ERROR("[ReliableEndpoint] Message of {} bytes doesn't fit in a packet of {} bytes", message.size(),
+            config_.max_packet_size);
+        return false;
+    }
+
+    Channel& c = channels_[channel];
+    const uint16_t id = c.next_send_id++;
+    if (!is_reliable(c.mode)) {
+        send_packet(channel, id, message, now);
+        return true;
+    }
+
+    auto payload = BufferPool::shared().acquire(message.size());
+    std::ranges::copy(message, payload.begin());
+    c.outgoing.push_back({id, std::move(payload), {}, 0, false});
+
+    // The rest waits in the queue until the oldest ones are acked
+    if (static_cast<uint16_t>(id - c.outgoing.front().id) < MESSAGE_WINDOW) send_message(channel, c.outgoing.back(), now);
+    return true;
+}
+
+inline void ReliableEndpoint::receive(const std::span<const uint8_t> packet, const Clock::time_point now) {
+    if (packet.size() < HEADER_SIZE) {
+        SANHOK_LOG_WARN("[ReliableEndpoint] Packet of {} bytes is too short", packet.size());
+        return;
+    }
+    ++stats_.packets_received;
+
+    const uint16_t sequence = detail::read_u16(packet.data());
+    const uint8_t flags = packet[8];
+    const uint8_t channel = packet[9];
+    const uint16_t message_id = detail::read_u16(packet.data() + 10);
+    const bool is_late = has_received_ && static_cast<uint16_t>(remote_sequence_ - sequence) > 32 &&
+        is_newer(remote_sequence_, sequence);
+
+    if (flags & HAS_ACK) {
+        const uint16_t ack = detail::read_u16(packet.data() + 2);
+        const uint32_t bits = detail::read_u32(packet.data() + 4);
+        acknowledge(ack, now);
+        for (uint16_t i = 0; i < 32; ++i) {
+            if (bits & (uint32_t {1} << i)) acknowledge(static_cast<uint16_t>(ack - 1 - i), now);
+        }
+    }
+
+    // A packet duplicated on the way
+    if (!record_received(sequence) || channel == ACK_ONLY) return;
+    if (channel >= channels_.size()) {
+        SANHOK_LOG_WARN("[ReliableEndpoint] Packet for no channel {}", channel);
+        return;
+    }
+
+    if (!ack_pending_) {
+        ack_pending_ = true;
+        ack_pending_since_ = now;
+    }
+    deliver(channel, message_id, packet.subspan(HEADER_SIZE));
+
+    // The bitfield from the newest packet doesn't reach a packet reordered that far, so it is acked on its own
+    if (is_late) send_ack(sequence, now);
+    // Acks for a burst would fall off the bitfield before ack_delay
+    else if (ack_pending_ && ++packets_to_ack_ >= ACK_EVERY) send_ack(remote_sequence_, now);
+}
+
+inline void ReliableEndpoint::update(const Clock::time_point now) {
+    for (size_t index = 0; index < channels_.size(); ++index) {
+        Channel& c = channels_[index];
+        if (!is_reliable(c.mode)) continue;
+
+        for (size_t i = 0; i < c.outgoing.size() && i < MESSAGE_WINDOW; ++i) {
+            OutgoingMessage& message = c.outgoing[i];
+            if (message.acked) continue;
+
+            if (message.sends == 0) {
+                send_message(static_cast<uint8_t>(index), message, now);
+            } else if (now - message.sent_at >= std::min(rto_ * (1 << std::min(message.sends - 1, MAX_BACKOFF_SHIFT)),
+                config_.max_rto)) {
+                ++stats_.retransmissions;
+                send_message(static_cast<uint8_t>(index), message, now);
+            }
+        }
+    }
+
+    if (ack_pending_ && now - ack_pending_since_ >= config_.ack_delay) send_ack(remote_sequence_, now);
+}
+
+inline size_t ReliableEndpoint::unacked() const {
+    size_t unacked {0};
+    for (const Channel& c : channels_) {
+        unacked += std::ranges::count(c.outgoing, false, &OutgoingMessage::acked);
+    }
+    return unacked;
+}
+
+inline bool ReliableEndpoint::is_reliable(const ChannelMode mode) {
+    return mode == ChannelMode::ReliableUnordered || mode == ChannelMode::ReliableOrdered;
+}
+
+inline bool ReliableEndpoint::is_newer(const uint16_t a, const uint16_t b) {
+    return a != b && static_cast<uint16_t>(a - b) < 0x8000;
+}
+
+inline void ReliableEndpoint::send_packet(const uint8_t channel, const uint16_t message_id,
+    const std::span<const uint8_t> payload, const Clock::time_point now) {
+    const uint16_t sequence = next_sequence_++;
+
+    packet_.resize(HEADER_SIZE + payload.size());
+    detail::write_u16(packet_.data(), sequence);
+    detail::write_u16(packet_.data() + 2, remote_sequence_);
+    detail::write_u32(packet_.data() + 4, ack_bits(remote_sequence_));
+    packet_[8] = has_received_ ? HAS_ACK : 0;
+    packet_[9] = channel;
+    detail::write_u16(packet_.data() + 10, message_id);
+    if (!payload.empty()) std::memcpy(packet_.data() + HEADER_SIZE, payload.data(), payload.size());
+
+    sent_packets_[sequence % SEQUENCE_BUFFER_SIZE] = {sequence, true, false, channel, message_id, now};
+    ack_pending_ = false;
+    packets_to_ack_ = 0;
+    ++stats_.packets_sent;
+    packet_sender_(packet_);
+}
+
+inline void ReliableEndpoint::send_message(const uint8_t channel, OutgoingMessage& message,
+    const Clock::time_point now) {
+    message.sent_at = now;
+    ++message.sends;
+    send_packet(channel, message.id, message.payload.span(), now);
+}
+
+inline void ReliableEndpoint::send_ack(const uint16_t ack, const Clock::time_point now) {
+    if (ack == remote_sequence_) {
+        send_packet(ACK_ONLY, 0, {}, now);
+        return;
+    }
+
+    const uint16_t sequence = next_sequence_++;
+    packet_.resize(HEADER_SIZE);
+    detail::write_u16(packet_.data(), sequence);
+    detail::write_u16(packet_.data() + 2, ack);
+    detail::write_u32(packet_.data() + 4, ack_bits(ack));
+    packet_[8] = HAS_ACK;
+    packet_[9] = ACK_ONLY;
+    detail::write_u16(packet_.data() + 10, 0);
+
+    sent_packets_[sequence % SEQUENCE_BUFFER_SIZE] = {sequence, true, false, ACK_ONLY, 0, now};
+    ++stats_.packets_sent;
+    packet_sender_(packet_);
+}
+
+inline void ReliableEndpoint::acknowledge(const uint16_t sequence, const Clock::time_point now) {
+    SentPacket& packet = sent_packets_[sequence % SEQUENCE_BUFFER_SIZE];
+    if (!packet.valid || packet.sequence != sequence || packet.acked) return;
+
+    packet.acked = true;
+    update_rto(now - packet.sent_at);
+
+    if (packet.channel >= channels_.size()) return;
+    Channel& c = channels_[packet.channel];
+    if (!is_reliable(c.mode) || c.outgoing.empty()) return;
+
+    const uint16_t offset = packet.message_id - c.outgoing.front().id;
+    if (offset < c.outgoing.size()) c.outgoing[offset].acked = true;
+
+    // Sending the messages that enter the window is left to update()
+    while (!c.outgoing.empty() && c.outgoing.front().acked) c.outgoing.pop_front();
+}
+
+// RFC 6298
+inline void ReliableEndpoint::update_rto(const Clock::duration sample) {
+    if (!rtt_measured_) {
+        rtt_measured_ = true;
+        srtt_ = sample;
+        rttvar_ = sample / 2;
+    } else {
+        const Clock::duration error = srtt_ > sample ? srtt_ - sample : sample - srtt_;
+        rttvar_ = (rttvar_ * 3 + error) / 4;
+        srtt_ = (srtt_ * 7 + sample) / 8;
+    }
+    rto_ = std::clamp(srtt_ + 4 * rttvar_, config_.min_rto, config_.max_rto);
+}
+
+// Returns false if the packet is already received
+inline bool ReliableEndpoint::record_received(const uint16_t sequence) {
+    ReceivedPacket& packet = received_packets_[sequence % SEQUENCE_BUFFER_SIZE];
+    if (packet.valid && packet.sequence == sequence) return false;
+
+    packet = {sequence, true};
+    if (!has_received_ || is_newer(sequence, remote_sequence_)) remote_sequence_ = sequence;
+    has_received_ = true;
+    return true;
+}
+
+// Bit i acks ack - 1 - i
+inline uint32_t ReliableEndpoint::ack_bits(const uint16_t ack) const {
+    uint32_t bits {0};
+    for (uint16_t i = 0; i < 32; ++i) {
+        const auto sequence = static_cast<uint16_t>(ack - 1 - i);
+        const ReceivedPacket& packet = received_packets_[sequence % SEQUENCE_BUFFER_SIZE];
+        if (packet.valid && packet.sequence == sequence) bits |= uint32_t {1} << i;
+    }
+    return bits;
+}
+
+inline void ReliableEndpoint::deliver(const uint8_t index, const uint16_t message_id,
+    const std::span<const uint8_t> payload) {
+    Channel& c = channels_[index];
+
+    switch (c.mode) {
+    case ChannelMode::Unreliable:
+        message_handler_(index, payload);
+        return;
+    case ChannelMode::UnreliableSequenced:
+        if (message_id != c.next_receive_id && !is_newer(message_id, c.next_receive_id)) return;
+        c.next_receive_id = message_id + 1;
+        message_handler_(index, payload);
+        return;
+    case ChannelMode::ReliableUnordered:
+    case ChannelMode::ReliableOrdered:
+        break;
+    }
+
+    // Behind the window means it is delivered already, as the sender never goes beyond it
+    const uint16_t offset = message_id - c.next_receive_id;
+    IncomingMessage& slot = c.incoming[message_id % MESSAGE_WINDOW];
+    if (offset >= MESSAGE_WINDOW || (slot.received && slot.id == message_id)) {
+        ++stats_.duplicates;
+        return;
+    }
+
+    if (c.mode == ChannelMode::ReliableUnordered) {
+        slot = {message_id, true, {}};
+        message_handler_(index, payload);
+    } else if (offset == 0) {
+        message_handler_(index, payload);
+        slot = {message_id, true, {}};
+    } else {
+        auto held = BufferPool::shared().acquire(payload.size());
+        std::ranges::copy(payload, held.begin());
+        slot = {message_id, true, std::move(held)};
+        return;
+    }
+
+    // Move past the received messages, delivering those held in order
+    for (IncomingMessage* next = &slot; next->received && next->id == c.next_receive_id;
+        next = &c.incoming[c.next_receive_id % MESSAGE_WINDOW]) {
+        if (c.mode == ChannelMode::ReliableOrdered && next->payload) {
+            const auto held = std::move(next->payload);
+            message_handler_(index, held.span());
+        }
+        next->received = false;
+        ++c.next_receive_id;
+    }
+}
+}
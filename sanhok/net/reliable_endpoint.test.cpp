@@ -0,0 +1,181 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/reliable_endpoint.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace std::chrono_literals;
+
+namespace {
+using Clock = ReliableEndpoint::Clock;
+
+// Carries packets between endpoints 0 and 1 after a delay with jitter, which reorders them, dropping some
+struct LossyLink {
+    struct Packet {
+        Clock::time_point deliver_at;
+        int to;
+        std::vector<uint8_t> bytes;
+    };
+
+    void send(const int to, const std::span<const uint8_t> packet, const Clock::time_point now) {
+        if (rng() % 100 < loss_percent) return;
+        const auto jitter_ms = jitter.count() > 0 ? rng() % jitter.count() : 0;
+        in_flight.push_back({now + delay + std::chrono::milliseconds {jitter_ms}, to, {packet.begin(), packet.end()}});
+    }
+
+    template <typename Receive>
+    void deliver(const Clock::time_point now, Receive receive) {
+        std::vector<Packet> due {};
+        std::erase_if(in_flight, [&due, now](Packet& packet) {
+            if (packet.deliver_at > now) return false;
+            due.push_back(std::move(packet));
+            return true;
+        });
+        std::ranges::stable_sort(due, {}, &Packet::deliver_at);
+        for (const Packet& packet : due) receive(packet.to, packet.bytes);
+    }
+
+    uint32_t loss_percent {0};
+    std::chrono::milliseconds delay {10ms};
+    std::chrono::milliseconds jitter {0ms};
+    std::mt19937 rng {42};
+    std::vector<Packet> in_flight {};
+};
+
+std::array<uint8_t, 4> encode(const uint32_t value) {
+    std::array<uint8_t, 4> bytes {};
+    std::memcpy(bytes.data(), &value, sizeof(value));
+    return bytes;
+}
+
+uint32_t decode(const std::span<const uint8_t> bytes) {
+    uint32_t value {};
+    std::memcpy(&value, bytes.data(), sizeof(value));
+    return value;
+}
+
+std::vector<uint32_t> iota(const uint32_t count) {
+    std::vector<uint32_t> values(count);
+    std::iota(values.begin(), values.end(), 0);
+    return values;
+}
+}
+
+TEST_CASE("[ReliableEndpoint]") {
+    constexpr uint8_t UNRELIABLE {0};
+    constexpr uint8_t SEQUENCED {1};
+    constexpr uint8_t UNORDERED {2};
+    constexpr uint8_t ORDERED {3};
+    const std::vector CHANNELS {ChannelMode::Unreliable, ChannelMode::UnreliableSequenced,
+        ChannelMode::ReliableUnordered, ChannelMode::ReliableOrdered};
+
+    Clock::time_point now {};
+    LossyLink link {};
+    std::array<std::vector<uint32_t>, 4> received {};
+
+    ReliableEndpoint a {CHANNELS, [&link, &now](std::span<const uint8_t> packet) { link.send(1, packet, now); },
+        [](uint8_t, std::span<const uint8_t>) {}};
+    ReliableEndpoint b {CHANNELS, [&link, &now](std::span<const uint8_t> packet) { link.send(0, packet, now); },
+        [&received](uint8_t channel, std::span<const uint8_t> message) { received[channel].push_back(decode(message)); }};
+
+    const auto run = [&](const Clock::duration duration) {
+        for (const auto end = now + duration; now < end; now += 1ms) {
+            link.deliver(now, [&](int to, std::span<const uint8_t> packet) { (to == 0 ? a : b).receive(packet, now); });
+            a.update(now);
+            b.update(now);
+        }
+    };
+
+    SECTION("Delivers by the mode of each channel over a lossy link that reorders") {
+        constexpr uint32_t MESSAGES {1000};
+        link.loss_percent = 20;
+        link.jitter = 20ms;
+
+        for (uint32_t i = 0; i < MESSAGES; ++i) {
+            for (uint8_t channel = 0; channel < CHANNELS.size(); ++channel) REQUIRE(a.send(channel, encode(i), now));
+            run(1ms);
+        }
+        run(10s);
+
+        REQUIRE(received[ORDERED] == iota(MESSAGES));
+
+        REQUIRE(received[UNORDERED].size() == MESSAGES);
+        REQUIRE(!std::ranges::is_sorted(received[UNORDERED]));
+        std::ranges::sort(received[UNORDERED]);
+        REQUIRE(received[UNORDERED] == iota(MESSAGES));
+
+        REQUIRE(received[SEQUENCED].size() < MESSAGES);
+        REQUIRE(std::ranges::adjacent_find(received[SEQUENCED], std::greater_equal {}) == received[SEQUENCED].end());
+
+        REQUIRE(received[UNRELIABLE].size() < MESSAGES);
+        REQUIRE(!std::ranges::is_sorted(received[UNRELIABLE]));
+        std::ranges::sort(received[UNRELIABLE]);
+        REQUIRE(std::ranges::adjacent_find(received[UNRELIABLE]) == received[UNRELIABLE].end());
+
+        REQUIRE(a.unacked() == 0);
+        REQUIRE(a.stats().retransmissions > 0);
+    }
+
+    SECTION("Estimates RTT from acks") {
+        link.delay = 20ms;
+
+        for (uint32_t i = 0; i < 100; ++i) {
+            a.send(ORDERED, encode(i), now);
+            run(10ms);
+        }
+
+        // Acks wait for ack_delay of the default Config without traffic back
+        REQUIRE(a.rtt() >= 40ms);
+        REQUIRE(a.rtt() <= 46ms);
+        REQUIRE(a.rto() >= a.rtt());
+        REQUIRE(a.stats().retransmissions == 0);
+    }
+
+    SECTION("Holds messages beyond the window until the link recovers") {
+        constexpr uint32_t MESSAGES {1000};
+        link.loss_percent = 100;
+
+        for (uint32_t i = 0; i < MESSAGES; ++i) a.send(ORDERED, encode(i), now);
+        run(1s);
+        REQUIRE(received[ORDERED].empty());
+        REQUIRE(a.unacked() == MESSAGES);
+
+        link.loss_percent = 0;
+        run(5s);
+        REQUIRE(received[ORDERED] == iota(MESSAGES));
+        REQUIRE(a.unacked() == 0);
+    }
+
+    SECTION("Wraps sequence numbers and message ids around") {
+        constexpr uint32_t MESSAGES {70000};
+        link.loss_percent = 10;
+        link.jitter = 5ms;
+
+        for (uint32_t i = 0; i < MESSAGES; i += 2) {
+            a.send(ORDERED, encode(i), now);
+            a.send(ORDERED, encode(i + 1), now);
+            run(1ms);
+        }
+        // Sending faster than a window per RTT with the losses leaves a backlog
+        run(20s);
+
+        REQUIRE(received[ORDERED] == iota(MESSAGES));
+        REQUIRE(a.unacked() == 0);
+    }
+
+    SECTION("Rejects what it cannot send") {
+        REQUIRE(!a.send(static_cast<uint8_t>(CHANNELS.size()), encode(0), now));
+        REQUIRE(!a.send(ORDERED, std::vector<uint8_t>(1200), now));
+        REQUIRE(a.stats().packets_sent == 0);
+
+        b.receive(std::vector<uint8_t>(ReliableEndpoint::HEADER_SIZE - 1), now);
+        REQUIRE(b.stats().packets_received == 0);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <sanhok/buffer_pool.hpp>
+#include <sanhok/net/peer_udp.hpp>
+#include <sanhok/net/reliable_endpoint.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace sanhok::net {
+/*
+ * Channels of ReliableEndpoint over a connected PeerUDP
+ * The endpoint lives on the io_context thread, receiving packets inline and updated by a timer,
+ * so the io_context has to be run by one thread. send() can be called from any thread.
+ * Its timer and the sends it dispatched may still be queued on the io_context when it is destroyed; they then
+ * complete without touching it.
+ */
+class ReliableUDP final : boost::noncopyable {
+public:
+    ReliableUDP(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint, std::vector<ChannelMode> channels,
+        ReliableEndpoint::MessageHandler&& message_handler, ReliableEndpoint::Config config,
+        std::chrono::milliseconds update_interval);
+    ~ReliableUDP();
+
+    void connect(const udp::endpoint& remote_endpoint) { peer_.connect(remote_endpoint); }
+    void open();
+    void close();
+    // The message is copied, to be sent on the io_context
+    void send(uint8_t channel, std::span<const uint8_t> message);
+
+    bool is_open() const { return peer_.is_open(); }
+    udp::endpoint local_endpoint() const { return peer_.local_endpoint(); }
+    // Only to be read on the io_context thread
+    const ReliableEndpoint& endpoint() const { return endpoint_; }
+
+private:
+    boost::asio::io_context& ctx_;
+    PeerUDP peer_;
+    ReliableEndpoint endpoint_;
+    boost::asio::steady_timer timer_;
+    const std::chrono::milliseconds update_interval_;
+
+    // Expires with it, for the timer wait and dispatched sends that outlive it
+    std::shared_ptr<bool> alive_ {std::make_shared<bool>(true)};
+};
+
+inline ReliableUDP::ReliableUDP(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint,
+    std::vector<ChannelMode> channels, ReliableEndpoint::MessageHandler&& message_handler,
+    const ReliableEndpoint::Config config = {}, const std::chrono::milliseconds update_interval = std::chrono::milliseconds {5})
+    : ctx_(ctx),
+    peer_(ctx, local_endpoint, [this](const std::span<const uint8_t> packet) {
+        endpoint_.receive(packet, ReliableEndpoint::Clock::now());
+    }),
+    endpoint_(std::move(channels), [this](const std::span<const uint8_t> packet) {
+        auto buffer = BufferPool::shared().acquire(packet.size());
+        std::ranges::copy(packet, buffer.begin());
+        peer_.send_packet(std::move(buffer));
+    }, std::move(message_handler), config),
+    timer_(ctx), update_interval_(update_interval) {
+    peer_.set_handler_dispatch(HandlerDispatch::inline_io());
+}
+
+inline ReliableUDP::~ReliableUDP() {
+    alive_.reset();
+    close();
+}
+
+inline void ReliableUDP::open() {
+    if (peer_.is_open()) return;
+    peer_.open();
+
+    co_spawn(ctx_, [this, alive = std::weak_ptr {alive_}]()->boost::asio::awaitable<void> {
+        while (!alive.expired() && peer_.is_open()) {
+            timer_.expires_after(update_interval_);
+            const auto [ec] = co_await timer_.async_wait(as_tuple(boost::asio::use_awaitable));
+            // Destroyed after the wait completed
+            if (ec || alive.expired()) co_return;
+
+            endpoint_.update(ReliableEndpoint::Clock::now());
+        }
+    }, boost::asio::detached);
+}
+
+inline void ReliableUDP::close() {
+    if (!peer_.is_open()) return;
+
+    peer_.close();
+    timer_.cancel();
+}
+
+inline void ReliableUDP::send(const uint8_t channel, const std::span<const uint8_t> message) {
+    auto buffer = BufferPool::shared().acquire(message.size());
+    std::ranges::copy(message, buffer.begin());
+
+    boost::asio::dispatch(ctx_, [this, alive = std::weak_ptr {alive_}, channel, buffer = std::move(buffer)] {
+        if (alive.expired()) return;
+        endpoint_.send(channel, buffer.span(), ReliableEndpoint::Clock::now());
+    });
+}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <flatbuffers/detached_buffer.h>
+#include <sanhok/buffer_pool.hpp>
+
+#include <memory>
+#include <variant>
+
+namespace sanhok::net {
+/*
+ * A message queued for sending, either a shared DetachedBuffer or a pooled MessageBuffer
+ * It keeps the buffer alive until the write completes.
+ */
+class SendBuffer {
+public:
+    SendBuffer(std::shared_ptr<flatbuffers::DetachedBuffer> buffer)
+        : data_(buffer ? buffer->data() : nullptr), size_(buffer ? buffer->size() : 0), owner_(std::move(buffer)) {}
+
+    SendBuffer(MessageBuffer buffer)
+        : data_(buffer.data()), size_(buffer.size()), owner_(std::move(buffer)) {}
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    boost::asio::const_buffer buffer() const { return {data_, size_}; }
+    explicit operator bool() const { return data_ != nullptr; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    std::variant<std::shared_ptr<flatbuffers::DetachedBuffer>, MessageBuffer> owner_;
+};
+}
@@ -0,0 +1,132 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/peer_tcp.hpp>
+#include <sanhok/net/server_runtime.hpp>
+#include <tests/hello.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+using namespace std::chrono_literals;
+
+namespace {
+constexpr unsigned short LISTEN_PORT {50200};
+const tcp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), LISTEN_PORT};
+
+void wait_until(const std::atomic<size_t>& counter, const size_t target) {
+    while (counter < target) std::this_thread::sleep_for(100us);
+}
+
+// Connects and closes connections from a client runtime until the server accepted all of them
+void accept_connections(const size_t threads, const ServerRuntime::AcceptMode mode, const size_t connections) {
+    std::atomic<size_t> accepted {0};
+
+    ServerRuntime server {threads};
+    server.listen_tcp(LISTEN_PORT, [&accepted](boost::asio::io_context&, tcp::socket&&) {
+        ++accepted;
+    }, mode);
+    server.start();
+
+    ServerRuntime clients {threads};
+    clients.start();
+    for (size_t i = 0; i < connections; ++i) {
+        auto& ctx = clients.next_context();
+        co_spawn(ctx, [&ctx]()->boost::asio::awaitable<void> {
+            tcp::socket socket {ctx};
+            co_await socket.async_connect(SERVER_ENDPOINT, as_tuple(boost::asio::use_awaitable));
+        }, boost::asio::detached);
+    }
+
+    wait_until(accepted, connections);
+    clients.stop();
+    server.stop();
+}
+
+struct EchoSession {
+    std::unique_ptr<PeerTCP> peer {};
+};
+
+// Every client sends a Hello and waits for the echo, round_trips times
+void echo_round_trips(const size_t threads, const ServerRuntime::AcceptMode mode, const size_t connections,
+    const size_t round_trips) {
+    std::mutex sessions_mutex {};
+    std::vector<std::unique_ptr<EchoSession>> sessions {};
+
+    ServerRuntime server {threads};
+    server.listen_tcp(LISTEN_PORT, [&sessions_mutex, &sessions](boost::asio::io_context& ctx, tcp::socket&& socket) {
+        auto session = std::make_unique<EchoSession>();
+        session->peer = std::make_unique<PeerTCP>(ctx, std::move(socket),
+            [session = session.get()](std::vector<uint8_t>&& message) {
+                flatbuffers::FlatBufferBuilder builder {64};
+                builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(GetHello(message.data())->hello()->str())));
+                session->peer->send_message(std::make_shared<flatbuffers::DetachedBuffer>(builder.Release()));
+            });
+        session->peer->set_handler_dispatch(HandlerDispatch::inline_io());
+        session->peer->set_no_delay(true);
+        session->peer->run();
+
+        std::lock_guard lock {sessions_mutex};
+        sessions.push_back(std::move(session));
+    }, mode);
+    server.start();
+
+    flatbuffers::FlatBufferBuilder builder {64};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString("Hello")));
+    const auto hello = builder.Release();
+
+    std::atomic<size_t> finished {0};
+    ServerRuntime clients {threads};
+    clients.start();
+    for (size_t i = 0; i < connections; ++i) {
+        auto& ctx = clients.next_context();
+        co_spawn(ctx, [&ctx, &hello, &finished, round_trips]()->boost::asio::awaitable<void> {
+            tcp::socket socket {ctx};
+            co_await socket.async_connect(SERVER_ENDPOINT, as_tuple(boost::asio::use_awaitable));
+            socket.set_option(tcp::no_delay(true));
+
+            std::array<uint8_t, 256> echo {};
+            for (size_t r = 0; r < round_trips; ++r) {
+                co_await async_write(socket, boost::asio::buffer(hello.data(), hello.size()),
+                    as_tuple(boost::asio::use_awaitable));
+                co_await async_read(socket, boost::asio::buffer(echo.data(), hello.size()),
+                    as_tuple(boost::asio::use_awaitable));
+            }
+            ++finished;
+        }, boost::asio::detached);
+    }
+
+    wait_until(finished, connections);
+    clients.stop();
+    server.stop();
+    sessions.clear();
+}
+}
+
+TEST_CASE("[ServerRuntime]") {
+    constexpr size_t CONNECTIONS = 1000;
+    constexpr size_t ECHO_CONNECTIONS = 64;
+    constexpr size_t ROUND_TRIPS = 1000;
+
+    for (const size_t threads : {1, 2, 4}) {
+        const auto io_contexts = std::to_string(threads) + " io_contexts";
+
+        BENCHMARK("Accept 1000 connections, SO_REUSEPORT; " + io_contexts) {
+            accept_connections(threads, ServerRuntime::AcceptMode::ReusePort, CONNECTIONS);
+        };
+
+        BENCHMARK("Accept 1000 connections, round-robin; " + io_contexts) {
+            accept_connections(threads, ServerRuntime::AcceptMode::RoundRobin, CONNECTIONS);
+        };
+
+        BENCHMARK("Echo 64 connections x 1000 round trips, SO_REUSEPORT; " + io_contexts) {
+            echo_round_trips(threads, ServerRuntime::AcceptMode::ReusePort, ECHO_CONNECTIONS, ROUND_TRIPS);
+        };
+
+        BENCHMARK("Echo 64 connections x 1000 round trips, round-robin; " + io_contexts) {
+            echo_round_trips(threads, ServerRuntime::AcceptMode::RoundRobin, ECHO_CONNECTIONS, ROUND_TRIPS);
+        };
+    }
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <sanhok/net/listener_tcp.hpp>
+#include <sanhok/net/log.hpp>
+#include <sanhok/net/server_udp.hpp>
+#include <sanhok/net/timing_wheel.hpp>
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace sanhok::net {
+/*
+ * Runs an io_context per thread, each thread pinned to a core
+ * TCP listeners either accept on every io_context with SO_REUSEPORT or hand accepted sockets out round-robin.
+ * on_acceptance is called from the thread of the io_context that accepted, so it has to be thread-safe.
+ * UDP servers always bind a socket per io_context with SO_REUSEPORT; on_session is called the same way, and
+ * their sessions close after idle_timeout on the wheel of their io_context, unless it is zero.
+ * Every io_context has a TimingWheel for the idle timeouts and heartbeats of the peers running on it.
+ * stop() closes the listeners and UDP servers on their own threads before joining them; a runtime started again
+ * runs without them, until they are added again with listen_tcp and listen_udp.
+ * stop() may also be called from a handler on one of the io_contexts, whose thread is then joined by the next
+ * start() or stop(); the runtime still has to be destroyed from a thread of its own.
+ */
+class ServerRuntime final : boost::noncopyable {
+public:
+    enum class AcceptMode {
+        ReusePort, // An acceptor per io_context on the same port
+        RoundRobin, // One acceptor handing sockets to the io_contexts in turn
+    };
+
+    explicit ServerRuntime(size_t threads);
+    ~ServerRuntime();
+
+    void start();
+    void stop();
+    void listen_tcp(unsigned short port,
+        std::function<void(boost::asio::io_context&, tcp::socket&&)>&& on_acceptance, AcceptMode mode);
+    void listen_udp(unsigned short port, ServerUDP::SessionHandler&& on_session,
+        std::chrono::steady_clock::duration idle_timeout);
+
+    boost::asio::io_context& next_context();
+    boost::asio::io_context& context(const size_t index) { return *contexts_[index]; }
+    TimingWheel& timing_wheel(const boost::asio::io_context& ctx);
+    size_t size() const { return contexts_.size(); }
+
+private:
+    void stop_context(size_t index);
+    void join_stopping_thread();
+    static void pin_to_core(std::thread& thread, size_t core);
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> contexts_ {};
+    std::vector<std::unique_ptr<TimingWheel>> timing_wheels_ {}; // One per io_context, by index
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_guards_ {};
+    std::vector<std::thread> threads_ {};
+    std::thread stopping_thread_ {}; // Ran the handler that called stop()
+    std::vector<std::unique_ptr<ListenerTCP>> listeners_ {};
+    std::vector<std::unique_ptr<ServerUDP>> udp_servers_ {};
+    std::atomic<size_t> next_context_ {0};
+};
+
+inline ServerRuntime::ServerRuntime(const size_t threads = std::thread::hardware_concurrency()) {
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+        // Each io_context is only run by its own thread
+        contexts_.push_back(std::make_unique<boost::asio::io_context>(1));
+        timing_wheels_.push_back(std::make_unique<TimingWheel>(*contexts_.back()));
+    }
+}
+
+inline ServerRuntime::~ServerRuntime() {
+    stop();
+}
+
+inline void ServerRuntime::start() {
+    if (!threads_.empty()) return;
+    if (stopping_thread_.get_id() == std::this_thread::get_id()) {
+        SANHOK_LOG_ERROR("[ServerRuntime] Cannot start again from the handler that stopped it");
+        return;
+    }
+    join_stopping_thread();
+
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+        // Run again after stop()
+        contexts_[i]->restart();
+        work_guards_.push_back(make_work_guard(*contexts_[i]));
+        timing_wheels_[i]->start();
+        threads_.emplace_back([ctx = contexts_[i].get()] {
+            ctx->run();
+        });
+        pin_to_core(threads_.back(), i);
+    }
+}
+
+inline void ServerRuntime::stop() {
+    join_stopping_thread();
+
+    // Acceptors, sockets and timers are closed on the thread running their operations, all at once
+    std::vector<std::future<void>> stopped {};
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+        auto& ctx = *contexts_[i];
+        if (threads_.empty() || ctx.stopped() || ctx.get_executor().running_in_this_thread()) {
+            stop_context(i);
+            continue;
+        }
+
+        std::packaged_task<void()> task {[this, i] { stop_context(i); }};
+        stopped.push_back(task.get_future());
+        boost::asio::post(ctx, std::move(task));
+    }
+    for (const auto& future : stopped) future.wait();
+
+    work_guards_.clear();
+    for (const auto& ctx : contexts_) ctx->stop();
+    for (auto& thread : threads_) {
+        // Cannot join the thread running this call, which returns once its handler does
+        if (thread.get_id() == std::this_thread::get_id()) {
+            stopping_thread_ = std::move(thread);
+        } else if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+
+    // The handler calling stop() may be one of theirs
+    if (stopping_thread_.joinable()) return;
+    listeners_.clear();
+    udp_servers_.clear();
+}
+
+// Joins the thread that called stop() from a handler and drops the listeners and UDP servers it had to leave
+inline void ServerRuntime::join_stopping_thread() {
+    if (!stopping_thread_.joinable() || stopping_thread_.get_id() == std::this_thread::get_id()) return;
+
+    stopping_thread_.join();
+    listeners_.clear();
+    udp_servers_.clear();
+}
+
+// Stops what runs on the io_context at index
+inline void ServerRuntime::stop_context(const size_t index) {
+    const auto& ctx = *contexts_[index];
+    for (const auto& listener : listeners_) {
+        if (&listener->context() == &ctx) listener->stop();
+    }
+    for (const auto& server : udp_servers_) {
+        if (&server->context() == &ctx) server->stop();
+    }
+    timing_wheels_[index]->stop();
+}
+
+inline void ServerRuntime::listen_tcp(const unsigned short port,
+    std::function<void(boost::asio::io_context&, tcp::socket&&)>&& on_acceptance,
+    const AcceptMode mode = AcceptMode::ReusePort) {
+    // Before the listeners left by stop() are dropped along with the new one
+    join_stopping_thread();
+
+    switch (mode) {
+    case AcceptMode::ReusePort:
+        for (const auto& ctx : contexts_) {
+            auto on_acceptance_copy = on_acceptance;
+            listeners_.push_back(std::make_unique<ListenerTCP>(*ctx, port, std::move(on_acceptance_copy),
+                std::function<boost::asio::io_context&()> {}, true));
+            listeners_.back()->start();
+        }
+        break;
+    case AcceptMode::RoundRobin:
+        listeners_.push_back(std::make_unique<ListenerTCP>(next_context(), port, std::move(on_acceptance),
+            [this]() -> boost::asio::io_context& { return next_context(); }, false));
+        listeners_.back()->start();
+        break;
+    }
+}
+
+inline void ServerRuntime::listen_udp(const unsigned short port, ServerUDP::SessionHandler&& on_session,
+    const std::chrono::steady_clock::duration idle_timeout = {}) {
+    join_stopping_thread();
+
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+        auto on_session_copy = on_session;
+        udp_servers_.push_back(std::make_unique<ServerUDP>(*contexts_[i], udp::endpoint {udp::v4(), port},
+            std::move(on_session_copy), true));
+        if (idle_timeout > std::chrono::steady_clock::duration::zero()) {
+            udp_servers_.back()->set_idle_timeout(*timing_wheels_[i], idle_timeout);
+        }
+        udp_servers_.back()->start();
+    }
+}
+
+inline boost::asio::io_context& ServerRuntime::next_context() {
+    return *contexts_[next_context_.fetch_add(1, std::memory_order_relaxed) % contexts_.size()];
+}
+
+inline TimingWheel& ServerRuntime::timing_wheel(const boost::asio::io_context& ctx) {
+    for (size_t i = 0; i < contexts_.size(); ++i) {
+        if (contexts_[i].get() == &ctx) return *timing_wheels_[i];
+    }
+
+    // Still works, as timers are thread-safe, but the handlers run on the thread of another io_context
+    SANHOK_LOG_ERROR("[ServerRuntime] io_context is not of this runtime, using the timing wheel of the first one");
+    return *timing_wheels_.front();
+}
+
+inline void ServerRuntime::pin_to_core(std::thread& thread, const size_t core) {
+#ifdef __linux__
+    const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core % cores, &cpu_set);
+    if (const int error = pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set); error != 0) {
+        SANHOK_LOG_WARN("[ServerRuntime] Error pinning thread to core {}: {}", core % cores, error);
+    }
+#endif
+}
+}
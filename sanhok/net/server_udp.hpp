@@ -0,0 +1,315 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <flatbuffers/detached_buffer.h>
+#include <sanhok/buffer_pool.hpp>
+#include <sanhok/net/log.hpp>
+#include <sanhok/net/metrics.hpp>
+#include <sanhok/net/send_buffer.hpp>
+#include <sanhok/net/socket_options.hpp>
+#include <sanhok/net/timing_wheel.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace sanhok::net {
+using boost::asio::ip::udp;
+
+class ServerUDP;
+
+/*
+ * A remote endpoint of ServerUDP
+ * Packets are sent with send_to on the socket that received from the endpoint, from any thread.
+ * A session must not be used after its server is destroyed.
+ */
+class SessionUDP final : boost::noncopyable {
+public:
+    SessionUDP(ServerUDP& server, const udp::endpoint& remote_endpoint)
+        : server_(server), remote_endpoint_(remote_endpoint) {}
+
+    void send_packet(std::shared_ptr<flatbuffers::DetachedBuffer> packet);
+    void send_packet(MessageBuffer packet);
+    // The next datagram from the endpoint starts a new session
+    void close();
+
+    bool is_open() const { return is_open_; }
+    const udp::endpoint& remote_endpoint() const { return remote_endpoint_; }
+
+private:
+    friend class ServerUDP;
+
+    ServerUDP& server_;
+    const udp::endpoint remote_endpoint_;
+    std::function<void(std::span<const uint8_t>)> packet_handler_ {};
+    std::atomic<bool> is_open_ {true};
+    std::optional<WheelTimer> idle_timer_ {}; // Closes the session when nothing comes from the endpoint
+};
+
+/*
+ * A UDP socket receiving from many remote endpoints, routing each datagram to the session of its source
+ * on_session is called with the session of a new endpoint and returns its packet handler, or an empty one to
+ * drop the datagram. Handlers run on the io_context thread with the datagram in the receive buffer, so the
+ * io_context has to be run by one thread. ServerRuntime::listen_udp binds a server per io_context with
+ * SO_REUSEPORT, where the kernel hashes each remote endpoint to one socket and so one thread.
+ * Any source address opens a session, so sessions are capped and may close after an idle timeout.
+ * Destroy the server on its io_context thread or while the io_context is not running; its pending operations
+ * then complete without touching it.
+ */
+class ServerUDP final : boost::noncopyable {
+public:
+    using PacketHandler = std::function<void(std::span<const uint8_t>)>;
+    using SessionHandler = std::function<PacketHandler(const std::shared_ptr<SessionUDP>&)>;
+
+    ServerUDP(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint, SessionHandler&& on_session,
+        bool reuse_port, size_t receive_buffer_size);
+    ~ServerUDP();
+
+    void start();
+    void stop();
+    void set_idle_timeout(TimingWheel& wheel, std::chrono::steady_clock::duration timeout);
+    void set_max_sessions(size_t max_sessions);
+
+    bool is_running() const { return is_running_; }
+    size_t session_count() const { return session_count_.load(std::memory_order_relaxed); }
+    boost::asio::io_context& context() const { return ctx_; }
+    udp::endpoint local_endpoint() const { return socket_.local_endpoint(); }
+    const PeerMetrics& metrics() const { return metrics_; }
+
+private:
+    friend class SessionUDP;
+
+    struct EndpointHash {
+        size_t operator()(const udp::endpoint& endpoint) const;
+    };
+
+    static constexpr size_t DEFAULT_MAX_SESSIONS {65536};
+
+    static udp::socket open_socket(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint, bool reuse_port);
+    boost::asio::awaitable<void> receive(std::weak_ptr<bool> alive);
+    void dispatch_packet(size_t size);
+    void send(const udp::endpoint& remote_endpoint, SendBuffer&& packet);
+    void close_sessions();
+
+    boost::asio::io_context& ctx_;
+    udp::socket socket_;
+    std::atomic<bool> is_running_ {false};
+    SessionHandler on_session_;
+
+    std::vector<uint8_t> receive_buffer_;
+    udp::endpoint sender_endpoint_ {};
+
+    // Only touched on the io_context thread
+    std::unordered_map<udp::endpoint, std::shared_ptr<SessionUDP>, EndpointHash> sessions_ {};
+    std::atomic<size_t> session_count_ {0};
+    size_t max_sessions_ {DEFAULT_MAX_SESSIONS};
+    TimingWheel* idle_wheel_ {nullptr};
+    std::chrono::steady_clock::duration idle_timeout_ {};
+
+    // Expires with the server, for the operations and posted handlers that outlive it
+    std::shared_ptr<bool> alive_ {std::make_shared<bool>(true)};
+
+    [[no_unique_address]] PeerMetrics metrics_ {};
+};
+
+inline void SessionUDP::send_packet(std::shared_ptr<flatbuffers::DetachedBuffer> packet) {
+    if (!is_open_) return;
+    server_.send(remote_endpoint_, std::move(packet));
+}
+
+inline void SessionUDP::send_packet(MessageBuffer packet) {
+    if (!is_open_) return;
+    server_.send(remote_endpoint_, std::move(packet));
+}
+
+inline void SessionUDP::close() {
+    if (!is_open_.exchange(false)) return;
+
+    // Posted, as the handler of the session may be running
+    boost::asio::post(server_.ctx_, [&server = server_, alive = std::weak_ptr {server_.alive_},
+        remote_endpoint = remote_endpoint_] {
+        if (alive.expired()) return;
+        const auto it = server.sessions_.find(remote_endpoint);
+        if (it == server.sessions_.end() || it->second->is_open()) return;
+
+        server.sessions_.erase(it);
+        server.session_count_.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+inline ServerUDP::ServerUDP(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint,
+    SessionHandler&& on_session, const bool reuse_port = false, const size_t receive_buffer_size = 65536)
+    : ctx_(ctx), socket_(open_socket(ctx, local_endpoint, reuse_port)), on_session_(std::move(on_session)),
+    receive_buffer_(receive_buffer_size) {
+    MetricsRegistry::instance().add("ServerUDP", metrics_);
+}
+
+inline ServerUDP::~ServerUDP() {
+    alive_.reset();
+    stop();
+    close_sessions();
+    MetricsRegistry::instance().remove(metrics_);
+}
+
+inline void ServerUDP::start() {
+    if (is_running_.exchange(true)) return;
+
+    co_spawn(ctx_, receive(alive_), boost::asio::detached);
+}
+
+inline void ServerUDP::stop() {
+    if (!is_running_.exchange(false)) return;
+
+    try {
+        socket_.close();
+    } catch (const boost::system::system_error& e) {
+        SANHOK_LOG_ERROR("[ServerUDP] Error closing socket: {}", e.what());
+    }
+}
+
+// Closes sessions after timeout without a datagram from their endpoint, timed by a wheel shared with the peers
+inline void ServerUDP::set_idle_timeout(TimingWheel& wheel, const std::chrono::steady_clock::duration timeout) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[ServerUDP] Idle timeout has to be set before starting");
+        return;
+    }
+
+    idle_wheel_ = &wheel;
+    idle_timeout_ = timeout;
+}
+
+// Datagrams of new endpoints are dropped while max_sessions are open
+inline void ServerUDP::set_max_sessions(const size_t max_sessions) {
+    if (is_running_) {
+        SANHOK_LOG_ERROR("[ServerUDP] Max sessions has to be set before starting");
+        return;
+    }
+
+    max_sessions_ = max_sessions;
+}
+
+inline udp::socket ServerUDP::open_socket(boost::asio::io_context& ctx, const udp::endpoint& local_endpoint,
+    const bool reuse_port) {
+    udp::socket socket {ctx};
+    socket.open(local_endpoint.protocol());
+    if (reuse_port) {
+        // Lets a socket per io_context bind the same port; the kernel spreads remote endpoints over them
+        socket.set_option(udp::socket::reuse_address(true));
+        socket.set_option(ReusePort(true));
+    }
+    socket.bind(local_endpoint);
+
+    return socket;
+}
+
+// Takes the token of the server, which may be destroyed before the coroutine first runs
+inline boost::asio::awaitable<void> ServerUDP::receive(const std::weak_ptr<bool> alive) {
+    while (!alive.expired() && is_running_) {
+        const auto [ec, size] = co_await socket_.async_receive_from(boost::asio::buffer(receive_buffer_),
+            sender_endpoint_, as_tuple(boost::asio::use_awaitable));
+        // Destroyed while receiving
+        if (alive.expired()) co_return;
+
+        if (ec) {
+            // Stopped; the sessions are left to the io_context thread
+            if (ec == boost::asio::error::operation_aborted) {
+                close_sessions();
+                co_return;
+            }
+
+            // An error of one datagram doesn't stop the others
+            SANHOK_LOG_ERROR("[ServerUDP] Error receiving packet: {}", ec.what());
+            metrics_.receive_errors.add();
+            continue;
+        }
+
+        metrics_.messages_in.add();
+        metrics_.bytes_in.add(size);
+        dispatch_packet(size);
+    }
+}
+
+inline void ServerUDP::dispatch_packet(const size_t size) {
+    auto it = sessions_.find(sender_endpoint_);
+    if (it == sessions_.end()) {
+        // Closed sessions still count until their erase runs
+        if (sessions_.size() >= max_sessions_) {
+            SANHOK_LOG_WARN("[ServerUDP] {} sessions open, dropping a datagram of {}:{}", sessions_.size(),
+                sender_endpoint_.address().to_string(), sender_endpoint_.port());
+            metrics_.dropped.add();
+            return;
+        }
+
+        auto session = std::make_shared<SessionUDP>(*this, sender_endpoint_);
+        session->packet_handler_ = on_session_(session);
+        if (!session->packet_handler_) {
+            metrics_.dropped.add();
+            return;
+        }
+        if (idle_wheel_) session->idle_timer_.emplace(*idle_wheel_, [session = session.get()] { session->close(); });
+
+        it = sessions_.emplace(sender_endpoint_, std::move(session)).first;
+        session_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const auto& session = it->second;
+    if (session->idle_timer_) session->idle_timer_->arm(idle_timeout_);
+    session->packet_handler_({receive_buffer_.data(), size});
+}
+
+inline void ServerUDP::send(const udp::endpoint& remote_endpoint, SendBuffer&& packet) {
+    if (!packet || !is_running_) return;
+
+    co_spawn(ctx_, [this, alive = std::weak_ptr {alive_}, remote_endpoint,
+        packet = std::move(packet)]()->boost::asio::awaitable<void> {
+        // Destroyed before the send started
+        if (alive.expired()) co_return;
+
+        const auto [ec, sent] = co_await socket_.async_send_to(packet.buffer(), remote_endpoint,
+            as_tuple(boost::asio::use_awaitable));
+        if (alive.expired()) co_return;
+
+        if (ec) {
+            SANHOK_LOG_ERROR("[ServerUDP] Error sending packet to {}:{}: {}", remote_endpoint.address().to_string(),
+                remote_endpoint.port(), ec.what());
+            metrics_.send_errors.add();
+            co_return;
+        }
+        metrics_.messages_out.add();
+        metrics_.bytes_out.add(sent);
+    }, boost::asio::detached);
+}
+
+inline void ServerUDP::close_sessions() {
+    // The timers go now, as sessions held by the application may outlive the wheel
+    for (const auto& [_, session] : sessions_) {
+        session->is_open_ = false;
+        session->idle_timer_.reset();
+    }
+    sessions_.clear();
+    session_count_ = 0;
+}
+
+// Folds the address and port into 64 bits for a multiplicative hash
+inline size_t ServerUDP::EndpointHash::operator()(const udp::endpoint& endpoint) const {
+    uint64_t key {endpoint.port()};
+    if (endpoint.address().is_v4()) {
+        key |= static_cast<uint64_t>(endpoint.address().to_v4().to_uint()) << 16;
+    } else {
+        const auto bytes = endpoint.address().to_v6().to_bytes();
+        uint64_t high, low;
+        std::memcpy(&high, bytes.data(), sizeof(high));
+        std::memcpy(&low, bytes.data() + sizeof(high), sizeof(low));
+        key ^= (high * 0x9E3779B97F4A7C15ull) ^ low;
+    }
+    const uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(hash ^ hash >> 32);
+}
+}
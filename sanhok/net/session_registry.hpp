@@ -0,0 +1,170 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <sanhok/net/log.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace sanhok::net {
+/*
+ * Refers to a session of a SessionRegistry by its slot and the generation of the slot when it was registered
+ * A handle outliving its session never reaches the session taking the slot next, as the generation moves on.
+ */
+struct SessionHandle {
+    uint32_t index {0};
+    uint32_t generation {0}; // Odd while registered, so that a default handle refers to nothing
+
+    uint64_t value() const { return static_cast<uint64_t>(generation) << 32 | index; }
+    static SessionHandle from_value(const uint64_t value) {
+        return {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32)};
+    }
+
+    bool operator==(const SessionHandle&) const = default;
+};
+
+/*
+ * Sessions, such as PeerTCP, in a slot map with a fixed number of slots
+ * Lookups by handle index a slot, and the sessions are kept dense so that apply_all walks one array.
+ * Handles are validated against the generation of their slot without taking a lock.
+ * Functions applied and session factories must not insert into or erase from the same registry.
+ */
+template <typename Session>
+class SessionRegistry {
+public:
+    using MakeSession = std::function<std::unique_ptr<Session>(boost::asio::io_context&,
+        boost::asio::ip::tcp::socket&&, SessionHandle)>;
+
+    explicit SessionRegistry(const size_t capacity = 65536)
+        : capacity_(static_cast<uint32_t>(capacity)), slots_(std::make_unique<Slot[]>(capacity_)) {
+        for (uint32_t i = 0; i < capacity_; ++i) slots_[i].position = i + 1;
+        sessions_.reserve(capacity_);
+        slot_indices_.reserve(capacity_);
+    }
+    ~SessionRegistry() = default;
+    SessionRegistry(const SessionRegistry&) = delete;
+    SessionRegistry& operator=(const SessionRegistry&) = delete;
+
+    // Leaves the session to the caller when the registry is full
+    SessionHandle insert(std::unique_ptr<Session>&& session) {
+        return emplace([&session](SessionHandle) { return std::move(session); });
+    }
+
+    // Registers the session factory(handle) makes, so that the session knows its handle from the start.
+    // Returns a default handle when the registry is full or the factory makes nothing.
+    template <typename Factory>
+        requires std::convertible_to<std::invoke_result_t<Factory, SessionHandle>, std::unique_ptr<Session>>
+    SessionHandle emplace(Factory factory) {
+        std::unique_lock lock {mutex_};
+
+        if (free_head_ == capacity_) {
+            SANHOK_LOG_WARN("[SessionRegistry] All {} slots are taken, refusing a session", capacity_);
+            return {};
+        }
+
+        Slot& slot = slots_[free_head_];
+        const SessionHandle handle {free_head_, slot.generation.load(std::memory_order_relaxed) + 1};
+        std::unique_ptr<Session> session = factory(handle);
+        if (!session) return {};
+
+        free_head_ = slot.position;
+        slot.position = static_cast<uint32_t>(sessions_.size());
+        sessions_.push_back(std::move(session));
+        slot_indices_.push_back(handle.index);
+        slot.generation.store(handle.generation, std::memory_order_release);
+
+        return handle;
+    }
+
+    // Returns the session to be destroyed by the caller, outside the lock; nullptr if the handle is stale
+    std::unique_ptr<Session> erase(const SessionHandle handle) {
+        std::unique_lock lock {mutex_};
+        if (!contains(handle)) return nullptr;
+
+        Slot& slot = slots_[handle.index];
+        slot.generation.store(handle.generation + 1, std::memory_order_release);
+
+        // The last session fills the hole, keeping the sessions dense
+        std::unique_ptr<Session> session = std::move(sessions_[slot.position]);
+        if (slot.position != sessions_.size() - 1) {
+            sessions_[slot.position] = std::move(sessions_.back());
+            slot_indices_[slot.position] = slot_indices_.back();
+            slots_[slot_indices_.back()].position = slot.position;
+        }
+        sessions_.pop_back();
+        slot_indices_.pop_back();
+
+        slot.position = free_head_;
+        free_head_ = handle.index;
+
+        return session;
+    }
+
+    bool contains(const SessionHandle handle) const {
+        return handle.index < capacity_
+            && slots_[handle.index].generation.load(std::memory_order_acquire) == handle.generation
+            && handle.generation % 2 == 1;
+    }
+
+    // Returns false if the handle is stale
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, Session&, Args&&...>
+    bool apply(const SessionHandle handle, Function function, Args&&... args) {
+        std::shared_lock lock {mutex_};
+
+        if (!contains(handle)) return false;
+        function(*sessions_[slots_[handle.index].position], std::forward<Args>(args)...);
+        return true;
+    }
+
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, Session&, Args...>
+    void apply_all(Function function, Args&&... args) {
+        std::shared_lock lock {mutex_};
+
+        for (const auto& session : sessions_) {
+            function(*session, args...);
+        }
+    }
+
+    // An on_acceptance for ListenerTCP registering the session make_session makes of every accepted socket
+    std::function<void(boost::asio::io_context&, boost::asio::ip::tcp::socket&&)> on_acceptance(
+        MakeSession&& make_session) {
+        return [this, make_session = std::move(make_session)](boost::asio::io_context& ctx,
+            boost::asio::ip::tcp::socket&& socket) {
+            emplace([&](const SessionHandle handle) { return make_session(ctx, std::move(socket), handle); });
+        };
+    }
+
+    bool empty() const {
+        std::shared_lock lock {mutex_};
+        return sessions_.empty();
+    }
+
+    size_t size() const {
+        std::shared_lock lock {mutex_};
+        return sessions_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> generation {0};
+        uint32_t position {0}; // Of the session in sessions_ while taken, of the next free slot while free
+    };
+
+    const uint32_t capacity_;
+    const std::unique_ptr<Slot[]> slots_;
+
+    mutable std::shared_mutex mutex_ {};
+    std::vector<std::unique_ptr<Session>> sessions_ {};
+    std::vector<uint32_t> slot_indices_ {}; // Slot of each session in sessions_
+    uint32_t free_head_ {0}; // capacity_ when there is no free slot
+};
+}
@@ -0,0 +1,110 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/session_registry.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace sanhok::net;
+
+namespace {
+struct Session {
+    int id;
+};
+}
+
+TEST_CASE("[SessionRegistry]") {
+    SessionRegistry<Session> registry {4};
+
+    SECTION("Handles reach their session until it is erased") {
+        const SessionHandle first = registry.insert(std::make_unique<Session>(1));
+        const SessionHandle second = registry.insert(std::make_unique<Session>(2));
+        REQUIRE(registry.size() == 2);
+        REQUIRE(registry.contains(first));
+        REQUIRE(!registry.contains(SessionHandle {}));
+
+        int id {0};
+        REQUIRE(registry.apply(second, [&id](const Session& session) { id = session.id; }));
+        REQUIRE(id == 2);
+        REQUIRE(SessionHandle::from_value(second.value()) == second);
+
+        REQUIRE(registry.erase(first)->id == 1);
+        REQUIRE(registry.erase(first) == nullptr);
+        REQUIRE(!registry.contains(first));
+        REQUIRE(!registry.apply(first, [](Session&) { FAIL("Applied to an erased session"); }));
+        REQUIRE(registry.size() == 1);
+    }
+
+    SECTION("A stale handle misses the session reusing its slot") {
+        const SessionHandle stale = registry.insert(std::make_unique<Session>(1));
+        registry.erase(stale);
+
+        const SessionHandle reused = registry.insert(std::make_unique<Session>(2));
+        REQUIRE(reused.index == stale.index);
+        REQUIRE(reused.generation != stale.generation);
+        REQUIRE(!registry.contains(stale));
+        REQUIRE(registry.erase(stale) == nullptr);
+        REQUIRE(registry.contains(reused));
+    }
+
+    SECTION("A full registry refuses sessions") {
+        for (int i = 0; i < 4; ++i) registry.insert(std::make_unique<Session>(i));
+
+        auto session = std::make_unique<Session>(4);
+        REQUIRE(registry.insert(std::move(session)) == SessionHandle {});
+        REQUIRE(session != nullptr);
+        REQUIRE(registry.size() == 4);
+    }
+
+    SECTION("Sessions stay dense through erasures") {
+        std::vector<SessionHandle> handles {};
+        for (int i = 0; i < 4; ++i) handles.push_back(registry.insert(std::make_unique<Session>(i)));
+        registry.erase(handles[0]);
+        registry.erase(handles[2]);
+
+        int sum {0};
+        registry.apply_all([&sum](const Session& session, const int add) { sum += session.id + add; }, 10);
+        REQUIRE(sum == 1 + 3 + 20);
+
+        handles[0] = registry.insert(std::make_unique<Session>(5));
+        int id {0};
+        REQUIRE(registry.apply(handles[3], [&id](const Session& session) { id = session.id; }));
+        REQUIRE(id == 3);
+        REQUIRE(registry.apply(handles[0], [&id](const Session& session) { id = session.id; }));
+        REQUIRE(id == 5);
+    }
+
+    SECTION("emplace hands the session its handle") {
+        SessionHandle given {};
+        const SessionHandle handle = registry.emplace([&given](const SessionHandle handle) {
+            given = handle;
+            return std::make_unique<Session>(1);
+        });
+        REQUIRE(handle == given);
+
+        REQUIRE(registry.emplace([](SessionHandle) { return std::unique_ptr<Session> {}; }) == SessionHandle {});
+        REQUIRE(registry.size() == 1);
+    }
+}
+
+TEST_CASE("Handles are validated while other threads insert and erase", "[SessionRegistry]") {
+    SessionRegistry<Session> registry {64};
+    const SessionHandle kept = registry.insert(std::make_unique<Session>(0));
+
+    std::atomic<bool> churning {true};
+    std::thread churn {[&registry, &churning] {
+        for (int i = 0; i < 10000; ++i) registry.erase(registry.insert(std::make_unique<Session>(i)));
+        churning = false;
+    }};
+
+    int misses {0};
+    while (churning) {
+        if (!registry.contains(kept)) ++misses;
+        registry.apply(kept, [&misses](const Session& session) { if (session.id != 0) ++misses; });
+    }
+    churn.join();
+
+    REQUIRE(misses == 0);
+    REQUIRE(registry.size() == 1);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <boost/asio/socket_base.hpp>
+
+#include <cstddef>
+
+namespace sanhok::net {
+/*
+ * SO_REUSEPORT as a settable socket option, which Boost.Asio only has in its detail namespace
+ * Sockets with it bind the same address and port, and the kernel spreads connections or datagrams over them.
+ */
+class ReusePort {
+public:
+    explicit ReusePort(const bool enabled) : value_(enabled ? 1 : 0) {}
+
+    template <typename Protocol>
+    int level(const Protocol&) const { return SOL_SOCKET; }
+
+    template <typename Protocol>
+    int name(const Protocol&) const { return SO_REUSEPORT; }
+
+    template <typename Protocol>
+    const int* data(const Protocol&) const { return &value_; }
+
+    template <typename Protocol>
+    size_t size(const Protocol&) const { return sizeof(value_); }
+
+private:
+    int value_;
+};
+}
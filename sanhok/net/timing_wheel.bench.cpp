@@ -0,0 +1,51 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <sanhok/net/timing_wheel.hpp>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace sanhok::net;
+using namespace std::chrono_literals;
+
+namespace {
+constexpr size_t TIMERS = 100000;
+}
+
+// Re-arms every idle timeout of 100000 connections once, as a message received on each of them would
+TEST_CASE("[TimingWheel]") {
+    boost::asio::io_context ctx {};
+
+    TimingWheel wheel {ctx};
+    std::vector<std::unique_ptr<WheelTimer>> wheel_timers {};
+    for (size_t i = 0; i < TIMERS; ++i) {
+        wheel_timers.push_back(std::make_unique<WheelTimer>(wheel, [] {}));
+        wheel_timers.back()->arm(30s + std::chrono::milliseconds {i % 1000});
+    }
+
+    // A steady_timer per connection with a pending wait, cancelled and put back into the timer heap
+    std::vector<std::unique_ptr<boost::asio::steady_timer>> steady_timers {};
+    for (size_t i = 0; i < TIMERS; ++i) {
+        steady_timers.push_back(std::make_unique<boost::asio::steady_timer>(ctx));
+        steady_timers.back()->expires_after(30s + std::chrono::milliseconds {i % 1000});
+        steady_timers.back()->async_wait([](const boost::system::error_code&) {});
+    }
+
+    BENCHMARK("TimingWheel; re-arm 100000 timers") {
+        for (size_t i = 0; i < TIMERS; ++i) wheel_timers[i]->arm(30s + std::chrono::milliseconds {i % 1000});
+    };
+
+    BENCHMARK("steady_timer; re-arm 100000 timers") {
+        for (size_t i = 0; i < TIMERS; ++i) {
+            steady_timers[i]->expires_after(30s + std::chrono::milliseconds {i % 1000});
+            steady_timers[i]->async_wait([](const boost::system::error_code&) {});
+        }
+        // Completes the cancelled waits as a running io_context would
+        ctx.poll();
+        ctx.restart();
+    };
+
+    for (const auto& timer : steady_timers) timer->cancel();
+    ctx.poll();
+}
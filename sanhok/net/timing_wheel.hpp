@@ -0,0 +1,221 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace sanhok::net {
+class TimingWheel;
+
+/*
+ * A timer of a TimingWheel, armed, re-armed and cancelled in constant time from any thread
+ * The handler runs once per arm on the io_context thread of the wheel and may arm or cancel any timer, its own
+ * included. Destroying a timer waits for its handler running on another thread, so a handler must not destroy
+ * its own timer. The wheel has to outlive its timers.
+ */
+class WheelTimer final : boost::noncopyable {
+public:
+    WheelTimer(TimingWheel& wheel, std::function<void()>&& handler)
+        : wheel_(wheel), handler_(std::move(handler)) {}
+    ~WheelTimer();
+
+    // Replaces the previous deadline, if any
+    void arm(std::chrono::steady_clock::duration timeout);
+    void cancel();
+
+    bool is_armed() const;
+    TimingWheel& wheel() const { return wheel_; }
+
+private:
+    friend class TimingWheel;
+
+    TimingWheel& wheel_;
+    std::function<void()> handler_;
+
+    // Guarded by the mutex of the wheel
+    WheelTimer** slot_ {nullptr}; // Head of the list the timer is linked in; nullptr when not armed
+    WheelTimer* prev_ {nullptr};
+    WheelTimer* next_ {nullptr};
+    size_t rounds_ {0}; // Turns of the wheel left before the slot is due
+};
+
+/*
+ * A hashed timing wheel ticking on an io_context, for many coarse timers such as idle timeouts and heartbeats
+ * A timer lands in the slot its timeout in ticks hashes to, counting the turns of the wheel beyond the first,
+ * so arming touches one list instead of a timer heap. Timers fire within a tick of their timeout.
+ * ServerRuntime keeps a wheel per io_context.
+ */
+class TimingWheel final : boost::noncopyable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimingWheel(boost::asio::io_context& ctx, Clock::duration tick, size_t slots);
+    ~TimingWheel();
+
+    void start();
+    void stop();
+
+    bool is_running() const { return is_running_; }
+    // Timers armed and not fired yet
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+    Clock::duration tick() const { return tick_; }
+    boost::asio::io_context& context() const { return ctx_; }
+
+private:
+    friend class WheelTimer;
+
+    boost::asio::awaitable<void> run();
+    void advance();
+    static void link(WheelTimer*& head, WheelTimer& timer);
+    static void unlink(WheelTimer& timer);
+
+    boost::asio::io_context& ctx_;
+    boost::asio::steady_timer timer_;
+    std::atomic<bool> is_running_ {false};
+    const Clock::duration tick_;
+
+    std::mutex mutex_ {};
+    std::vector<WheelTimer*> slots_; // Heads of the timer lists; a power of two of them
+    WheelTimer* due_ {nullptr}; // Taken out of the current slot to be fired
+    size_t cursor_ {0};
+    std::atomic<WheelTimer*> firing_ {nullptr};
+    std::atomic<size_t> size_ {0};
+};
+
+inline WheelTimer::~WheelTimer() {
+    std::unique_lock lock {wheel_.mutex_};
+    if (slot_) {
+        TimingWheel::unlink(*this);
+        wheel_.size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // The handler is running on the io_context thread
+    while (wheel_.firing_ == this && !wheel_.ctx_.get_executor().running_in_this_thread()) {
+        lock.unlock();
+        wheel_.firing_.wait(this);
+        lock.lock();
+    }
+}
+
+inline void WheelTimer::arm(const std::chrono::steady_clock::duration timeout) {
+    const auto tick = wheel_.tick_.count();
+    const size_t ticks = std::max<std::chrono::steady_clock::rep>((timeout.count() + tick - 1) / tick, 1);
+
+    std::lock_guard lock {wheel_.mutex_};
+    if (slot_) {
+        TimingWheel::unlink(*this);
+    } else {
+        wheel_.size_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // A slot is due when the cursor reaches it, a full turn after it is armed at the latest
+    const size_t slots = wheel_.slots_.size();
+    rounds_ = (ticks - 1) / slots;
+    TimingWheel::link(wheel_.slots_[(wheel_.cursor_ + ticks) & (slots - 1)], *this);
+}
+
+inline void WheelTimer::cancel() {
+    std::lock_guard lock {wheel_.mutex_};
+    if (!slot_) return;
+
+    TimingWheel::unlink(*this);
+    wheel_.size_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline bool WheelTimer::is_armed() const {
+    std::lock_guard lock {wheel_.mutex_};
+    return slot_ != nullptr;
+}
+
+inline TimingWheel::TimingWheel(boost::asio::io_context& ctx,
+    const Clock::duration tick = std::chrono::milliseconds {10}, const size_t slots = 512)
+    : ctx_(ctx), timer_(ctx), tick_(std::max<Clock::duration>(tick, Clock::duration {1})),
+    slots_(std::bit_ceil(std::max<size_t>(slots, 1)), nullptr) {}
+
+inline TimingWheel::~TimingWheel() {
+    stop();
+}
+
+inline void TimingWheel::start() {
+    if (is_running_.exchange(true)) return;
+
+    co_spawn(ctx_, run(), boost::asio::detached);
+}
+
+inline void TimingWheel::stop() {
+    if (!is_running_.exchange(false)) return;
+
+    timer_.cancel();
+}
+
+inline boost::asio::awaitable<void> TimingWheel::run() {
+    auto next_tick = Clock::now() + tick_;
+    while (is_running_) {
+        timer_.expires_at(next_tick);
+        const auto [ec] = co_await timer_.async_wait(as_tuple(boost::asio::use_awaitable));
+        if (ec) co_return;
+
+        // Catch up on the ticks missed while the io_context was busy
+        for (const auto now = Clock::now(); next_tick <= now && is_running_; next_tick += tick_) advance();
+    }
+}
+
+// Moves the cursor to the next slot and fires the timers due in it
+inline void TimingWheel::advance() {
+    std::unique_lock lock {mutex_};
+    cursor_ = (cursor_ + 1) & (slots_.size() - 1);
+
+    for (WheelTimer* timer = slots_[cursor_]; timer;) {
+        WheelTimer* next = timer->next_;
+        if (timer->rounds_ > 0) {
+            --timer->rounds_;
+        } else {
+            unlink(*timer);
+            link(due_, *timer);
+        }
+        timer = next;
+    }
+
+    // One at a time without the lock, so that handlers can arm and cancel timers, the due ones included
+    while (WheelTimer* timer = due_) {
+        unlink(*timer);
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        firing_ = timer;
+        lock.unlock();
+
+        timer->handler_();
+
+        lock.lock();
+        firing_ = nullptr;
+        firing_.notify_all();
+    }
+}
+
+inline void TimingWheel::link(WheelTimer*& head, WheelTimer& timer) {
+    timer.slot_ = &head;
+    timer.prev_ = nullptr;
+    timer.next_ = head;
+    if (head) head->prev_ = &timer;
+    head = &timer;
+}
+
+inline void TimingWheel::unlink(WheelTimer& timer) {
+    if (timer.prev_) {
+        timer.prev_->next_ = timer.next_;
+    } else {
+        *timer.slot_ = timer.next_;
+    }
+    if (timer.next_) timer.next_->prev_ = timer.prev_;
+
+    timer.slot_ = nullptr;
+    timer.prev_ = nullptr;
+    timer.next_ = nullptr;
+}
+}
@@ -0,0 +1,119 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/timing_wheel.hpp>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace sanhok::net;
+using namespace std::chrono_literals;
+
+namespace {
+using Clock = TimingWheel::Clock;
+}
+
+TEST_CASE("[TimingWheel]") {
+    boost::asio::io_context ctx {};
+    // A turn of the wheel every 8ms, so that timeouts beyond it take rounds
+    TimingWheel wheel {ctx, 1ms, 8};
+    wheel.start();
+
+    SECTION("Fires once after the timeout, within a tick") {
+        std::vector<Clock::duration> fired {};
+        const auto armed_at = Clock::now();
+        WheelTimer short_timer {wheel, [&] { fired.push_back(Clock::now() - armed_at); }};
+        WheelTimer long_timer {wheel, [&] { fired.push_back(Clock::now() - armed_at); }};
+        short_timer.arm(5ms);
+        long_timer.arm(30ms);
+        REQUIRE(wheel.size() == 2);
+
+        ctx.run_for(60ms);
+
+        REQUIRE(fired.size() == 2);
+        REQUIRE(fired[0] >= 4ms);
+        REQUIRE(fired[1] >= 29ms);
+        REQUIRE(!short_timer.is_armed());
+        REQUIRE(wheel.size() == 0);
+    }
+
+    SECTION("Re-arming pushes the deadline back") {
+        int fired {0};
+        WheelTimer timer {wheel, [&fired] { ++fired; }};
+        timer.arm(100ms);
+        for (int i = 0; i < 10; ++i) {
+            ctx.run_for(20ms);
+            timer.arm(100ms);
+        }
+        REQUIRE(fired == 0);
+        REQUIRE(wheel.size() == 1);
+
+        ctx.run_for(150ms);
+        REQUIRE(fired == 1);
+    }
+
+    SECTION("Cancelled timers don't fire") {
+        int fired {0};
+        WheelTimer cancelled {wheel, [&fired] { ++fired; }};
+        cancelled.arm(5ms);
+        cancelled.cancel();
+        REQUIRE(!cancelled.is_armed());
+        REQUIRE(wheel.size() == 0);
+
+        {
+            WheelTimer destroyed {wheel, [&fired] { ++fired; }};
+            destroyed.arm(5ms);
+        }
+        REQUIRE(wheel.size() == 0);
+
+        ctx.run_for(20ms);
+        REQUIRE(fired == 0);
+    }
+
+    SECTION("Handlers re-arm their own timer and cancel timers due in the same tick") {
+        int beats {0};
+        std::unique_ptr<WheelTimer> heartbeat {};
+        heartbeat = std::make_unique<WheelTimer>(wheel, [&] {
+            ++beats;
+            heartbeat->arm(3ms);
+        });
+        heartbeat->arm(3ms);
+
+        int fired {0};
+        std::vector<std::unique_ptr<WheelTimer>> timers {};
+        for (int i = 0; i < 2; ++i) {
+            timers.push_back(std::make_unique<WheelTimer>(wheel, [&, i] {
+                ++fired;
+                timers[1 - i]->cancel();
+            }));
+        }
+        for (const auto& timer : timers) timer->arm(5ms);
+
+        ctx.run_for(32ms);
+        REQUIRE(fired == 1);
+        REQUIRE(beats >= 8);
+        REQUIRE(heartbeat->is_armed());
+    }
+
+    SECTION("Arms and cancels from other threads") {
+        constexpr int TIMERS {1000};
+        std::atomic<int> fired {0};
+        std::vector<std::unique_ptr<WheelTimer>> timers {};
+        for (int i = 0; i < TIMERS; ++i) timers.push_back(std::make_unique<WheelTimer>(wheel, [&fired] { ++fired; }));
+
+        std::thread io {[&ctx] { ctx.run_for(100ms); }};
+        std::thread other {[&timers] {
+            for (int i = 0; i < TIMERS; ++i) {
+                timers[i]->arm(std::chrono::milliseconds {i % 20});
+                if (i % 2 == 1) timers[i]->cancel();
+            }
+        }};
+        other.join();
+        io.join();
+
+        REQUIRE(fired == TIMERS / 2);
+        REQUIRE(wheel.size() == 0);
+    }
+
+    wheel.stop();
+}
@@ -0,0 +1,394 @@
+#pragma once
+
+#ifdef SANHOK_IO_URING
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <sanhok/net/log.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace sanhok::net {
+class UringReceiver;
+
+/*
+ * An io_uring shared by the UringReceivers of an io_context, with a ring of provided buffers per buffer size
+ * A server of many peers has one ring, one eventfd and one set of buffers per io_context rather than per peer.
+ * Completions wake the io_context through the eventfd and go to their receivers, so handlers run on its thread
+ * like the other receive paths. Asio has no way to submit to the ring of its own io_uring backend, hence this one.
+ * The first receiver of a buffer size sets how many buffers of that size there are. Like the peers, it expects
+ * its io_context to be run by a single thread.
+ */
+class UringService final : public boost::asio::execution_context::service {
+public:
+    static inline boost::asio::execution_context::id id {};
+
+    explicit UringService(boost::asio::io_context& ctx);
+    ~UringService() override;
+
+private:
+    friend class UringReceiver;
+
+    struct BufferGroup {
+        uint16_t id;
+        size_t buffer_size;
+        uint32_t buffer_count; // A power of two, as the ring requires
+        io_uring_buf_ring* ring;
+        std::vector<uint8_t> buffers;
+
+        uint8_t* buffer(const uint16_t buffer_id) { return buffers.data() + buffer_id * buffer_size; }
+    };
+
+    struct Registration {
+        UringReceiver* receiver; // nullptr once the receiver is gone, until its cancel completes
+        BufferGroup* group;
+    };
+
+    static constexpr unsigned RING_ENTRIES {64};
+    static constexpr unsigned COMPLETION_ENTRIES {4096};
+    // Low bit of the user data of a submission: a cancel rather than a receive
+    static constexpr uint64_t CANCEL {1};
+
+    void shutdown() override;
+    BufferGroup* open(size_t buffer_size, size_t buffer_count);
+    uint64_t add(UringReceiver& receiver, BufferGroup& group);
+    void remove(uint64_t id);
+    bool submit_receive(uint64_t id, int fd, const BufferGroup& group);
+    void submit_cancel(uint64_t id);
+    static void return_buffer(BufferGroup& group, uint16_t buffer_id);
+    boost::asio::awaitable<void> dispatch_completions();
+
+    boost::asio::io_context& ctx_;
+    std::mutex mutex_ {}; // Receivers open, close and go away from any thread
+    io_uring ring_ {};
+    bool has_ring_ {false};
+    std::deque<BufferGroup> groups_ {};
+    boost::asio::posix::stream_descriptor completions_; // The eventfd registered to ring_
+    std::unordered_map<uint64_t, Registration> receivers_ {};
+    uint64_t next_id_ {1};
+};
+
+/*
+ * Multishot receives on a socket through the UringService of its io_context, into its provided buffers
+ * The kernel picks a buffer per completion, so no read is issued with a buffer that sits waiting for data, and
+ * every buffer goes back to the ring when its handler returns. When the handlers fall behind and the ring runs
+ * out, the receive stops and the data stays in the socket until the next receive() rearms it.
+ */
+class UringReceiver final : boost::noncopyable {
+public:
+    UringReceiver(boost::asio::io_context& ctx, int fd, size_t buffer_size, size_t buffer_count);
+    ~UringReceiver();
+
+    // Returns false if io_uring or provided buffer rings are not available
+    bool open();
+    void close();
+    // Calls handler(ec, data) for each completion until there is none left; ec is eof at the end of a stream
+    template <typename Handler>
+        requires std::invocable<Handler, const boost::system::error_code&, std::span<const uint8_t>>
+    boost::asio::awaitable<void> receive(Handler handler);
+
+    bool is_open() const { return is_open_; }
+
+private:
+    friend class UringService;
+
+    struct Completion {
+        int result;
+        unsigned flags;
+    };
+
+    // From UringService on the io_context thread
+    void complete(int result, unsigned flags);
+
+    UringService& service_;
+    const int fd_;
+    const size_t buffer_size_;
+    const size_t buffer_count_;
+    bool is_stream_ {false};
+    std::atomic<bool> is_open_ {false};
+    bool is_receiving_ {false}; // The multishot receive is armed
+
+    UringService::BufferGroup* group_ {nullptr};
+    uint64_t id_ {0};
+    std::vector<Completion> completions_ {}; // Not handled yet
+    std::vector<Completion> handling_ {};
+    boost::asio::steady_timer wake_; // Cancelled on a completion
+};
+
+inline UringService::UringService(boost::asio::io_context& ctx)
+    : boost::asio::execution_context::service(ctx), ctx_(ctx), completions_(ctx) {}
+
+inline UringService::~UringService() {
+    shutdown();
+}
+
+inline void UringService::shutdown() {
+    std::lock_guard lock {mutex_};
+
+    boost::system::error_code ec;
+    completions_.close(ec);
+    for (auto& group : groups_) io_uring_free_buf_ring(&ring_, group.ring, group.buffer_count, group.id);
+    groups_.clear();
+    if (has_ring_) io_uring_queue_exit(&ring_);
+    has_ring_ = false;
+}
+
+// Sets up the ring on the first call and the buffer group of buffer_size on the first call for that size
+inline UringService::BufferGroup* UringService::open(const size_t buffer_size, const size_t buffer_count) {
+    std::lock_guard lock {mutex_};
+
+    if (!has_ring_) {
+        // Room for many completions between two wakeups; past it the kernel holds them back rather than drop them
+        io_uring_params params {};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = COMPLETION_ENTRIES;
+        if (const int error = io_uring_queue_init_params(RING_ENTRIES, &ring_, &params); error < 0) {
+            SANHOK_LOG_ERROR("[UringService] Error setting up io_uring: {}", std::strerror(-error));
+            return nullptr;
+        }
+        has_ring_ = true;
+
+        const int event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event < 0) {
+            SANHOK_LOG_ERROR("[UringService] Error creating eventfd: {}", std::strerror(errno));
+            io_uring_queue_exit(&ring_);
+            has_ring_ = false;
+            return nullptr;
+        }
+        completions_.assign(event);
+        if (const int error = io_uring_register_eventfd(&ring_, event); error < 0) {
+            SANHOK_LOG_ERROR("[UringService] Error registering eventfd: {}", std::strerror(-error));
+            boost::system::error_code ec;
+            completions_.close(ec);
+            io_uring_queue_exit(&ring_);
+            has_ring_ = false;
+            return nullptr;
+        }
+
+        co_spawn(ctx_, dispatch_completions(), boost::asio::detached);
+    }
+
+    const auto it = std::ranges::find(groups_, buffer_size, &BufferGroup::buffer_size);
+    if (it != groups_.end()) return &*it;
+
+    const auto count = std::bit_ceil(static_cast<uint32_t>(std::clamp<size_t>(buffer_count, 1, 32768)));
+    const auto group_id = static_cast<uint16_t>(groups_.size());
+    int error {0};
+    io_uring_buf_ring* buffer_ring = io_uring_setup_buf_ring(&ring_, count, group_id, 0, &error);
+    if (!buffer_ring) {
+        SANHOK_LOG_ERROR("[UringService] Error registering provided buffers: {}", std::strerror(-error));
+        return nullptr;
+    }
+
+    auto& group = groups_.emplace_back(group_id, buffer_size, count, buffer_ring, std::vector<uint8_t>(buffer_size * count));
+    for (uint32_t i = 0; i < count; ++i) {
+        io_uring_buf_ring_add(buffer_ring, group.buffer(static_cast<uint16_t>(i)), static_cast<unsigned>(buffer_size),
+            static_cast<uint16_t>(i), io_uring_buf_ring_mask(count), static_cast<int>(i));
+    }
+    io_uring_buf_ring_advance(buffer_ring, static_cast<int>(count));
+    return &group;
+}
+
+inline uint64_t UringService::add(UringReceiver& receiver, BufferGroup& group) {
+    std::lock_guard lock {mutex_};
+
+    const uint64_t id = next_id_++;
+    receivers_.emplace(id, Registration {&receiver, &group});
+    return id;
+}
+
+// Keeps the group of the receiver until its cancel completes, to give back the buffers still in flight
+inline void UringService::remove(const uint64_t id) {
+    std::lock_guard lock {mutex_};
+
+    if (const auto it = receivers_.find(id); it != receivers_.end()) it->second.receiver = nullptr;
+}
+
+inline bool UringService::submit_receive(const uint64_t id, const int fd, const BufferGroup& group) {
+    std::lock_guard lock {mutex_};
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (!sqe) {
+        SANHOK_LOG_ERROR("[UringService] Submission queue is full");
+        return false;
+    }
+    io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = group.id;
+    io_uring_sqe_set_data64(sqe, id << 1);
+
+    if (const int submitted = io_uring_submit(&ring_); submitted < 0) {
+        SANHOK_LOG_ERROR("[UringService] Error submitting receive: {}", std::strerror(-submitted));
+        return false;
+    }
+    return true;
+}
+
+// Drops the reference of the receive to the socket, which would keep it open
+inline void UringService::submit_cancel(const uint64_t id) {
+    std::lock_guard lock {mutex_};
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    if (!sqe) {
+        SANHOK_LOG_ERROR("[UringService] Submission queue is full, the receive is not cancelled");
+        return;
+    }
+    io_uring_prep_cancel64(sqe, id << 1, 0);
+    io_uring_sqe_set_data64(sqe, id << 1 | CANCEL);
+    io_uring_submit(&ring_);
+}
+
+inline void UringService::return_buffer(BufferGroup& group, const uint16_t buffer_id) {
+    io_uring_buf_ring_add(group.ring, group.buffer(buffer_id), static_cast<unsigned>(group.buffer_size), buffer_id,
+        io_uring_buf_ring_mask(group.buffer_count), 0);
+    io_uring_buf_ring_advance(group.ring, 1);
+}
+
+inline boost::asio::awaitable<void> UringService::dispatch_completions() {
+    while (true) {
+        const auto [ec] = co_await completions_.async_wait(boost::asio::posix::descriptor_base::wait_read,
+            as_tuple(boost::asio::use_awaitable));
+        if (ec) co_return;
+
+        uint64_t signalled;
+        [[maybe_unused]] const auto read = ::read(completions_.native_handle(), &signalled, sizeof(signalled));
+
+        // Held while completing, so that a receiver is not destroyed in between
+        std::lock_guard lock {mutex_};
+        io_uring_cqe* cqe;
+        while (has_ring_ && io_uring_peek_cqe(&ring_, &cqe) == 0) {
+            const int result = cqe->res;
+            const unsigned flags = cqe->flags;
+            const uint64_t data = io_uring_cqe_get_data64(cqe);
+            io_uring_cqe_seen(&ring_, cqe);
+
+            const auto it = receivers_.find(data >> 1);
+            if (it == receivers_.end()) continue;
+            const auto [receiver, group] = it->second;
+
+            // The cancel completes after the receive it cancelled, so nothing comes for the receiver after it
+            if (data & CANCEL) {
+                receivers_.erase(it);
+                if (receiver) receiver->complete(-ECANCELED, 0);
+            } else if (receiver) {
+                receiver->complete(result, flags);
+            } else if (flags & IORING_CQE_F_BUFFER) {
+                return_buffer(*group, static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+        }
+    }
+}
+
+inline UringReceiver::UringReceiver(boost::asio::io_context& ctx, const int fd, const size_t buffer_size,
+    const size_t buffer_count)
+    : service_(boost::asio::use_service<UringService>(ctx)), fd_(fd), buffer_size_(buffer_size),
+    buffer_count_(buffer_count), wake_(ctx) {}
+
+inline UringReceiver::~UringReceiver() {
+    close();
+    if (id_ == 0) return;
+
+    service_.remove(id_);
+    // The buffers of the completions left go back on the io_context thread, which owns the ring
+    if (!completions_.empty()) {
+        post(service_.ctx_, [group = group_, completions = std::move(completions_)] {
+            for (const auto& [_, flags] : completions) {
+                if (flags & IORING_CQE_F_BUFFER) {
+                    UringService::return_buffer(*group, static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+            }
+        });
+    }
+}
+
+inline bool UringReceiver::open() {
+    if (is_open_) return true;
+
+    int type {0};
+    socklen_t length {sizeof(type)};
+    if (getsockopt(fd_, SOL_SOCKET, SO_TYPE, &type, &length) == 0) is_stream_ = type == SOCK_STREAM;
+
+    group_ = service_.open(buffer_size_, buffer_count_);
+    if (!group_) return false;
+
+    id_ = service_.add(*this, *group_);
+    is_open_ = true;
+    is_receiving_ = service_.submit_receive(id_, fd_, *group_);
+    return is_receiving_;
+}
+
+inline void UringReceiver::close() {
+    if (!is_open_.exchange(false)) return;
+
+    // Its completion wakes a pending receive()
+    service_.submit_cancel(id_);
+}
+
+inline void UringReceiver::complete(const int result, const unsigned flags) {
+    completions_.push_back({result, flags});
+    wake_.cancel();
+}
+
+template <typename Handler>
+    requires std::invocable<Handler, const boost::system::error_code&, std::span<const uint8_t>>
+boost::asio::awaitable<void> UringReceiver::receive(Handler handler) {
+    if (!is_open_) {
+        handler(boost::asio::error::operation_aborted, {});
+        co_return;
+    }
+    if (!is_receiving_) {
+        is_receiving_ = service_.submit_receive(id_, fd_, *group_);
+        if (!is_receiving_) {
+            handler(boost::asio::error::no_buffer_space, {});
+            co_return;
+        }
+    }
+
+    if (completions_.empty()) {
+        wake_.expires_at(std::chrono::steady_clock::time_point::max());
+        co_await wake_.async_wait(as_tuple(boost::asio::use_awaitable));
+    }
+
+    handling_.swap(completions_);
+    for (const auto& [result, flags] : handling_) {
+        if (!(flags & IORING_CQE_F_MORE)) is_receiving_ = false;
+
+        if (flags & IORING_CQE_F_BUFFER) {
+            const auto buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+            if (is_open_ && (result > 0 || (result == 0 && !is_stream_))) {
+                handler({}, {group_->buffer(buffer_id), static_cast<size_t>(result)});
+            }
+            UringService::return_buffer(*group_, buffer_id);
+        } else if (!is_open_) {
+            // Closed; the handler hears of it once below
+        } else if (result == 0) {
+            handler(boost::asio::error::eof, {});
+        } else if (result == -ENOBUFS) {
+            // The ring ran out; receiving resumes on the next call
+        } else if (result == -ECANCELED) {
+            handler(boost::asio::error::operation_aborted, {});
+        } else if (result < 0) {
+            handler(boost::system::error_code {-result, boost::system::system_category()}, {});
+        }
+    }
+    handling_.clear();
+
+    if (!is_open_) handler(boost::asio::error::operation_aborted, {});
+}
+}
+#endif
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace sanhok {
+/*
+ * A map for lookups on every message and writes on connect and disconnect, such as a session table
+ * Readers work on an immutable snapshot without taking a lock: entering a read only bumps a counter of the
+ * reader slot of the thread, which other threads rarely share. Writers copy the snapshot, publish the copy
+ * and wait for the readers of the previous epoch before freeing the old one, so a write costs a copy of the map.
+ * Values are read-only to the functions applied; share mutable state through pointers.
+ * Functions applied must not write to the same map, as the write would wait for its own read.
+ */
+template <typename KeyType, typename ValueType, size_t ReaderSlots = 64>
+class ReadMostlyMap {
+public:
+    ReadMostlyMap() = default;
+    ~ReadMostlyMap() { delete map_.load(); }
+    ReadMostlyMap(const ReadMostlyMap&) = delete;
+    ReadMostlyMap& operator=(const ReadMostlyMap&) = delete;
+
+    void insert_or_assign(const KeyType& key, const ValueType& value) {
+        write([&key, &value](Map& map) { map.insert_or_assign(key, value); });
+    }
+
+    void insert_or_assign(const KeyType& key, ValueType&& value) {
+        write([&key, &value](Map& map) { map.insert_or_assign(key, std::forward<ValueType>(value)); });
+    }
+
+    ValueType at(const KeyType& key) const {
+        const ReadGuard guard {*this};
+        return guard.map().at(key);
+    }
+
+    void erase(const KeyType& key) {
+        write([&key](Map& map) { map.erase(key); }, [&key](const Map& map) { return map.contains(key); });
+    }
+
+    void clear() {
+        write([](Map& map) { map.clear(); }, [](const Map& map) { return !map.empty(); });
+    }
+
+    bool contains(const KeyType& key) const {
+        const ReadGuard guard {*this};
+        return guard.map().contains(key);
+    }
+
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, const ValueType&, Args&&...>
+    void apply(const KeyType& key, Function function, Args&&... args) const {
+        const ReadGuard guard {*this};
+
+        const auto it = guard.map().find(key);
+        if (it == guard.map().end()) return;
+        function(it->second, std::forward<Args>(args)...);
+    }
+
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, const ValueType&, Args...>
+    void apply_all(Function function, Args&&... args) const {
+        const ReadGuard guard {*this};
+
+        for (const auto& [_, value] : guard.map()) {
+            function(value, args...);
+        }
+    }
+
+    template <typename Filter, typename Function, typename... Args>
+        requires std::invocable<Filter, const ValueType&>
+        && std::same_as<bool, std::invoke_result_t<Filter, const ValueType&>>
+        && std::invocable<Function, const ValueType&, Args...>
+    void apply_some(Filter filter, Function function, Args&&... args) const {
+        const ReadGuard guard {*this};
+
+        for (const auto& [_, value] : guard.map()) {
+            if (!filter(value)) continue;
+
+            function(value, args...);
+        }
+    }
+
+    bool empty() const {
+        const ReadGuard guard {*this};
+        return guard.map().empty();
+    }
+
+    size_t size() const {
+        const ReadGuard guard {*this};
+        return guard.map().size();
+    }
+
+private:
+    using Map = std::unordered_map<KeyType, ValueType>;
+
+    // Readers in the slot by the parity of the epoch they entered in
+    struct alignas(64) ReaderSlot {
+        std::array<std::atomic<size_t>, 2> readers {};
+    };
+
+    // Pins the snapshot current when the read starts until the guard goes away
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const ReadMostlyMap& owner) : slot_(owner.slots_[thread_slot()]) {
+            // Counted under an epoch that the next writer will wait for; entering as the epoch moves on retries
+            while (true) {
+                const uint64_t epoch = owner.epoch_.load();
+                parity_ = epoch & 1;
+                slot_.readers[parity_].fetch_add(1);
+                if (owner.epoch_.load() == epoch) break;
+                slot_.readers[parity_].fetch_sub(1, std::memory_order_release);
+            }
+            map_ = owner.map_.load();
+        }
+        ~ReadGuard() { slot_.readers[parity_].fetch_sub(1, std::memory_order_release); }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        const Map& map() const { return *map_; }
+
+    private:
+        ReaderSlot& slot_;
+        size_t parity_ {0};
+        const Map* map_ {nullptr};
+    };
+
+    // Threads take slots in turn, so up to ReaderSlots threads never share one
+    static size_t thread_slot() {
+        static std::atomic<size_t> next_slot {0};
+        thread_local const size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % ReaderSlots;
+        return slot;
+    }
+
+    template <typename Modify>
+    void write(Modify modify) {
+        write(std::move(modify), [](const Map&) { return true; });
+    }
+
+    // Publishes a modified copy unless changes() finds nothing to modify
+    template <typename Modify, typename Changes>
+    void write(Modify modify, Changes changes) {
+        std::lock_guard lock {write_mutex_};
+
+        const Map* previous = map_.load(std::memory_order_relaxed);
+        if (!changes(*previous)) return;
+
+        auto next = std::make_unique<Map>(*previous);
+        modify(*next);
+        map_.store(next.release());
+
+        // Readers entering from now on see the new epoch and the new snapshot
+        const uint64_t epoch = epoch_.fetch_add(1);
+        for (const ReaderSlot& slot : slots_) {
+            while (slot.readers[epoch & 1].load(std::memory_order_acquire) > 0) std::this_thread::yield();
+        }
+        delete previous;
+    }
+
+    // Written only by writers, so readers keep the line shared
+    alignas(64) std::atomic<const Map*> map_ {new Map {}};
+    std::atomic<uint64_t> epoch_ {0};
+
+    mutable std::array<ReaderSlot, ReaderSlots> slots_ {};
+    std::mutex write_mutex_ {};
+};
+}
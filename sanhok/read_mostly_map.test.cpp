@@ -0,0 +1,131 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/read_mostly_map.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace sanhok;
+
+TEST_CASE("Insert/Erase thread safety", "[ReadMostlyMap]")
+{
+    ReadMostlyMap<int, int> map {};
+
+    std::thread t1([&map] {
+        for (int i = 0; i < 1000; ++i) {
+            map.insert_or_assign(i, 42);
+            map.erase(i);
+        }
+    });
+
+    std::thread t2([&map] {
+        for (int i = 1000; i < 2000; ++i) {
+            map.insert_or_assign(i, 27);
+            map.erase(i);
+        }
+    });
+
+    t1.join();
+    t2.join();
+
+    REQUIRE(map.empty());
+}
+
+TEST_CASE("apply", "[ReadMostlyMap]")
+{
+    ReadMostlyMap<int, std::shared_ptr<int>> map {};
+    map.insert_or_assign(2, std::make_shared<int>(20));
+
+    map.apply(2, [](const std::shared_ptr<int>& value, const int add) {
+        *value += add;
+    }, 10);
+    map.apply(3, [](const std::shared_ptr<int>&) {
+        FAIL("Applied to a missing key");
+    });
+
+    REQUIRE(*map.at(2) == 30);
+}
+
+TEST_CASE("apply_all", "[ReadMostlyMap]")
+{
+    ReadMostlyMap<int, int> map {};
+    map.insert_or_assign(1, 10);
+    map.insert_or_assign(2, 20);
+    map.insert_or_assign(3, 30);
+
+    int sum {0};
+    map.apply_all([&sum](const int& value, const int add) {
+        sum += value + add;
+    }, 5);
+
+    REQUIRE(sum == 75);
+    REQUIRE(map.size() == 3);
+}
+
+TEST_CASE("apply_some", "[ReadMostlyMap]")
+{
+    ReadMostlyMap<int, int> map {};
+    map.insert_or_assign(1, 10);
+    map.insert_or_assign(2, 21);
+    map.insert_or_assign(3, 30);
+
+    auto odd_numbers = [](const int& n) -> bool {
+        return n % 2 != 0;
+    };
+
+    std::vector<int> applied {};
+    map.apply_some(std::move(odd_numbers), [&applied](const int& value) {
+        applied.push_back(value);
+    });
+
+    REQUIRE(applied == std::vector {21});
+}
+
+TEST_CASE("Readers see whole snapshots while writers replace them", "[ReadMostlyMap]")
+{
+    constexpr int READERS = 4;
+    constexpr int KEYS = 100;
+
+    // Every write keeps all values equal, so a reader seeing two values saw a torn or freed snapshot
+    ReadMostlyMap<int, std::vector<int>> map {};
+    for (int key = 0; key < KEYS; ++key) map.insert_or_assign(key, std::vector<int>(16, 0));
+
+    std::atomic<bool> writing {true};
+    std::atomic<int> torn {0};
+    std::vector<std::thread> readers {};
+    for (int r = 0; r < READERS; ++r) {
+        readers.emplace_back([&] {
+            while (writing) {
+                int first {-1};
+                map.apply_all([&first, &torn](const std::vector<int>& value) {
+                    if (first < 0) first = value.front();
+                    for (const int element : value) {
+                        if (element != first) ++torn;
+                    }
+                });
+                map.apply(KEYS / 2, [&torn](const std::vector<int>& value) {
+                    if (value.size() != 16) ++torn;
+                });
+                std::this_thread::yield();
+            }
+        });
+    }
+
+    // Rewrites the whole map with clear, so that the readers never see a mix of generations
+    std::thread writer {[&map, &writing] {
+        for (int generation = 1; generation <= 20; ++generation) {
+            map.clear();
+            for (int key = 0; key < KEYS; ++key) map.insert_or_assign(key, std::vector<int>(16, generation));
+            map.erase(KEYS / 2);
+            map.insert_or_assign(KEYS / 2, std::vector<int>(16, generation));
+        }
+        writing = false;
+    }};
+
+    writer.join();
+    for (auto& reader : readers) reader.join();
+
+    REQUIRE(torn == 0);
+    REQUIRE(map.size() == KEYS);
+    REQUIRE(map.at(0).front() == 20);
+}
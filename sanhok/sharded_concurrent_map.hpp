@@ -0,0 +1,100 @@
+#pragma once
+
+#include <sanhok/concurrent_map.hpp>
+
+#include <array>
+#include <bit>
+#include <functional>
+
+namespace sanhok {
+/*
+ * A ConcurrentMap split into independently locked shards by the hash of the key
+ * Writers only contend with the operations on the same shard.
+ */
+template <typename KeyType, typename ValueType, size_t ShardCount = 16, typename Hash = std::hash<KeyType>>
+    requires (std::has_single_bit(ShardCount))
+class ShardedConcurrentMap {
+public:
+    ShardedConcurrentMap() = default;
+    ~ShardedConcurrentMap() = default;
+    ShardedConcurrentMap(const ShardedConcurrentMap&) = delete;
+    ShardedConcurrentMap& operator=(const ShardedConcurrentMap&) = delete;
+
+    void insert_or_assign(const KeyType& key, const ValueType& value) {
+        shard(key).insert_or_assign(key, value);
+    }
+
+    void insert_or_assign(const KeyType& key, ValueType&& value) {
+        shard(key).insert_or_assign(key, std::forward<ValueType>(value));
+    }
+
+    ValueType at(const KeyType& key) const {
+        return shard(key).at(key);
+    }
+
+    void erase(const KeyType& key) {
+        shard(key).erase(key);
+    }
+
+    void clear() {
+        for (auto& shard : shards_) shard.map.clear();
+    }
+
+    bool contains(const KeyType& key) const {
+        return shard(key).contains(key);
+    }
+
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, ValueType&, Args&&...>
+    void apply(const KeyType& key, Function function, Args&&... args) {
+        shard(key).apply(key, std::move(function), std::forward<Args>(args)...);
+    }
+
+    template <typename Function, typename... Args>
+        requires std::invocable<Function, ValueType&, Args...>
+    void apply_all(Function function, Args&&... args) {
+        for (auto& shard : shards_) shard.map.apply_all(function, args...);
+    }
+
+    template <typename Filter, typename Function, typename... Args>
+        requires std::invocable<Filter, const ValueType&>
+        && std::same_as<bool, std::invoke_result_t<Filter, const ValueType&>>
+        && std::invocable<Function, ValueType&, Args...>
+    void apply_some(Filter filter, Function function, Args&&... args) {
+        for (auto& shard : shards_) shard.map.apply_some(filter, function, args...);
+    }
+
+    bool empty() const {
+        for (const auto& shard : shards_) {
+            if (!shard.map.empty()) return false;
+        }
+        return true;
+    }
+
+private:
+    // Keeps the locks of neighboring shards off the same cache line
+    struct alignas(64) Shard {
+        ConcurrentMap<KeyType, ValueType> map {};
+    };
+
+    static size_t shard_index(const KeyType& key) {
+        if constexpr (ShardCount == 1) {
+            return 0;
+        } else {
+            // Fibonacci hashing spreads keys with poor low bits, like pointers, over the shards
+            const auto hash = static_cast<uint64_t>(Hash {}(key)) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(hash >> (64 - std::countr_zero(ShardCount)));
+        }
+    }
+
+    ConcurrentMap<KeyType, ValueType>& shard(const KeyType& key) {
+        return shards_[shard_index(key)].map;
+    }
+
+    const ConcurrentMap<KeyType, ValueType>& shard(const KeyType& key) const {
+        return shards_[shard_index(key)].map;
+    }
+
+    std::array<Shard, ShardCount> shards_ {};
+};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace sanhok::net::tests {
+/*
+ * Records benchmark results as JSON lines of {"benchmark", "metric", "value", "unit"}
+ * The lines are appended to the file named by SANHOK_BENCH_REPORT, or printed to stdout if it is not set,
+ * so that results of different releases can be compared by a script.
+ */
+class BenchReport {
+public:
+    static void record(std::string_view benchmark, std::string_view metric, double value, std::string_view unit);
+
+    // Records p50, p99, p999 and max of the samples in microseconds
+    static void record_latencies(std::string_view benchmark, std::vector<std::chrono::nanoseconds>& samples);
+
+    // Records the rate of count per second over elapsed
+    static void record_rate(std::string_view benchmark, std::string_view metric, double count,
+        std::chrono::nanoseconds elapsed, std::string_view unit);
+};
+
+inline void BenchReport::record(const std::string_view benchmark, const std::string_view metric, const double value,
+    const std::string_view unit) {
+    static std::mutex mutex {};
+
+    const auto line = std::format(R"({{"benchmark":"{}","metric":"{}","value":{:.3f},"unit":"{}"}})",
+        benchmark, metric, value, unit);
+
+    std::lock_guard lock {mutex};
+    if (const char* path = std::getenv("SANHOK_BENCH_REPORT")) {
+        std::ofstream {path, std::ios::app} << line << '\n';
+    } else {
+        std::cout << line << std::endl;
+    }
+}
+
+inline void BenchReport::record_latencies(const std::string_view benchmark,
+    std::vector<std::chrono::nanoseconds>& samples) {
+    if (samples.empty()) return;
+    std::ranges::sort(samples);
+
+    const auto percentile = [&samples](const double p) {
+        const auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+        const auto sample = samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+        return std::chrono::duration<double, std::micro>(sample).count();
+    };
+
+    record(benchmark, "p50", percentile(0.5), "us");
+    record(benchmark, "p99", percentile(0.99), "us");
+    record(benchmark, "p999", percentile(0.999), "us");
+    record(benchmark, "max", percentile(1.0), "us");
+}
+
+inline void BenchReport::record_rate(const std::string_view benchmark, const std::string_view metric,
+    const double count, const std::chrono::nanoseconds elapsed, const std::string_view unit) {
+    record(benchmark, metric, count / std::chrono::duration<double>(elapsed).count(), unit);
+}
+}
@@ -0,0 +1,300 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/listener_tcp.hpp>
+#include <sanhok/net/peer_tcp.hpp>
+#include <sanhok/net/peer_udp.hpp>
+#include <tests/bench_report.hpp>
+#include <tests/hello.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace sanhok::net::tests;
+using namespace std::chrono_literals;
+
+/*
+ * Loopback benchmarks of ListenerTCP, PeerTCP and PeerUDP, reported through BenchReport
+ * Both ends run on one io_context in the benchmark thread.
+ */
+namespace {
+constexpr unsigned short LISTEN_PORT {50300};
+const tcp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), LISTEN_PORT};
+const udp::endpoint UDP_SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50301};
+const udp::endpoint UDP_CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50302};
+
+using Clock = std::chrono::steady_clock;
+
+// A size-prefixed Hello of about size bytes in total
+std::shared_ptr<flatbuffers::DetachedBuffer> make_message(const size_t size) {
+    flatbuffers::FlatBufferBuilder empty {64};
+    empty.FinishSizePrefixed(CreateHello(empty, empty.CreateString("")));
+    const size_t text_size = size > empty.GetSize() ? size - empty.GetSize() : 0;
+
+    flatbuffers::FlatBufferBuilder builder {64 + text_size};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(std::string(text_size, 'a'))));
+    return std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+}
+
+/*
+ * A ListenerTCP whose accepted peers either echo or only count the messages
+ */
+class Server {
+public:
+    enum class Mode { Echo, Count };
+
+    Server(boost::asio::io_context& ctx, Mode mode, size_t provided_buffers = 0);
+    ~Server();
+
+    size_t accepted() const { return sessions_.size(); }
+    size_t received() const { return received_; }
+
+private:
+    struct Session {
+        std::unique_ptr<PeerTCP> peer {};
+    };
+
+    void accept(boost::asio::io_context& ctx, tcp::socket&& socket);
+    static void echo(PeerTCP& peer, const MessageBuffer& message);
+
+    const Mode mode_;
+    const size_t provided_buffers_;
+    size_t received_ {0};
+    std::vector<std::unique_ptr<Session>> sessions_ {};
+    ListenerTCP listener_;
+};
+
+Server::Server(boost::asio::io_context& ctx, const Mode mode, const size_t provided_buffers)
+    : mode_(mode), provided_buffers_(provided_buffers), listener_(ctx, LISTEN_PORT, [this](boost::asio::io_context& ctx, tcp::socket&& socket) {
+        accept(ctx, std::move(socket));
+    }) {
+    listener_.start();
+}
+
+Server::~Server() {
+    listener_.stop();
+    for (const auto& session : sessions_) session->peer->disconnect();
+}
+
+void Server::accept(boost::asio::io_context& ctx, tcp::socket&& socket) {
+    auto session = std::make_unique<Session>();
+    session->peer = std::make_unique<PeerTCP>(ctx, std::move(socket),
+        [this, session = session.get()](MessageBuffer&& message) {
+            ++received_;
+            if (mode_ == Mode::Echo) echo(*session->peer, message);
+        });
+    session->peer->set_handler_dispatch(HandlerDispatch::inline_io());
+    session->peer->set_no_delay(true);
+    if (provided_buffers_ > 0) session->peer->set_provided_buffers(provided_buffers_);
+    session->peer->run();
+    sessions_.push_back(std::move(session));
+}
+
+// Sends the message body back with its size prefix
+void Server::echo(PeerTCP& peer, const MessageBuffer& message) {
+    constexpr size_t PREFIX_BYTES = sizeof(flatbuffers::uoffset_t);
+
+    auto echoed = BufferPool::shared().acquire(PREFIX_BYTES + message.size());
+    const auto size = static_cast<flatbuffers::uoffset_t>(message.size());
+    std::memcpy(echoed.data(), &size, PREFIX_BYTES);
+    std::memcpy(echoed.data() + PREFIX_BYTES, message.data(), message.size());
+    peer.send_message(std::move(echoed));
+}
+
+void connect(boost::asio::io_context& ctx, PeerTCP& client) {
+    co_spawn(ctx, [&client]()->boost::asio::awaitable<void> {
+        co_await client.connect(SERVER_ENDPOINT);
+        client.set_no_delay(true);
+        client.run();
+    }, boost::asio::detached);
+
+    while (!client.is_connected()) ctx.run_for(1ms);
+}
+
+// A PeerTCP client sends a message and waits for its echo, one at a time
+void tcp_echo_latency(const std::string_view benchmark, const size_t size, const size_t round_trips) {
+    constexpr size_t WARM_UP = 100;
+
+    boost::asio::io_context ctx {};
+    Server server {ctx, Server::Mode::Echo};
+
+    const auto message = make_message(size);
+    std::vector<std::chrono::nanoseconds> samples {};
+    samples.reserve(WARM_UP + round_trips);
+    Clock::time_point sent_at {};
+
+    PeerTCP* client_peer {nullptr};
+    PeerTCP client {ctx, tcp::socket {ctx}, [&](MessageBuffer&&) {
+        samples.push_back(Clock::now() - sent_at);
+        if (samples.size() == WARM_UP + round_trips) return;
+
+        sent_at = Clock::now();
+        client_peer->send_message(message);
+    }};
+    client_peer = &client;
+    client.set_handler_dispatch(HandlerDispatch::inline_io());
+    connect(ctx, client);
+
+    sent_at = Clock::now();
+    client.send_message(message);
+    while (samples.size() < WARM_UP + round_trips) ctx.run_for(1ms);
+
+    samples.erase(samples.begin(), samples.begin() + WARM_UP);
+    BenchReport::record_latencies(benchmark, samples);
+    client.disconnect();
+}
+
+// A PeerTCP client streams messages, keeping at most window of them unhandled by the server
+// The server receives through io_uring into provided_buffers buffers unless it is 0.
+void tcp_throughput(const std::string_view benchmark, const size_t size, const size_t messages, const size_t window,
+    const size_t provided_buffers = 0) {
+    boost::asio::io_context ctx {};
+    Server server {ctx, Server::Mode::Count, provided_buffers};
+
+    const auto message = make_message(size);
+    PeerTCP client {ctx, tcp::socket {ctx}, std::function<void(std::vector<uint8_t>&&)> {}};
+    connect(ctx, client);
+
+    size_t sent {0};
+    const auto start = Clock::now();
+    while (server.received() < messages) {
+        while (sent < messages && sent - server.received() < window) {
+            client.send_message(message);
+            ++sent;
+        }
+        ctx.poll();
+    }
+    const auto elapsed = Clock::now() - start;
+
+    BenchReport::record_rate(benchmark, "messages", static_cast<double>(messages), elapsed, "messages/s");
+    BenchReport::record_rate(benchmark, "throughput", static_cast<double>(messages * message->size()) / 1e6,
+        elapsed, "MB/s");
+    client.disconnect();
+}
+
+// PeerUDP sends packets, keeping at most window of them unhandled by the receiver so that none is dropped
+void udp_packets(const std::string_view benchmark, const size_t packets, const size_t window,
+    const size_t batch_size, const bool segmentation_offload, const size_t provided_buffers = 0) {
+    boost::asio::io_context ctx {};
+
+    size_t received {0};
+    PeerUDP server {ctx, UDP_SERVER_ENDPOINT, [&received](std::span<const uint8_t>) { ++received; }};
+    PeerUDP client {ctx, UDP_CLIENT_ENDPOINT, {}};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+    if (provided_buffers > 0) server.set_provided_buffers(provided_buffers);
+    for (PeerUDP* peer : {&server, &client}) {
+        if (batch_size > 0) peer->set_batch_io(batch_size);
+        if (segmentation_offload) peer->set_segmentation_offload(true);
+    }
+    server.open();
+    client.connect(UDP_SERVER_ENDPOINT);
+    client.open();
+
+    const auto packet = make_message(64);
+    size_t sent {0};
+    const auto start = Clock::now();
+    const auto deadline = start + 10s;
+    while (received < packets && Clock::now() < deadline) {
+        while (sent < packets && sent - received < window) {
+            client.send_packet(packet);
+            ++sent;
+        }
+        ctx.poll();
+    }
+    const auto elapsed = Clock::now() - start;
+
+    BenchReport::record_rate(benchmark, "packets", static_cast<double>(received), elapsed, "packets/s");
+    BenchReport::record(benchmark, "lost", static_cast<double>(packets - received), "packets");
+    server.close();
+    client.close();
+    ctx.run_for(1ms);
+}
+
+// Opens connections until ListenerTCP accepted all of them
+void tcp_accept_rate(const std::string_view benchmark, const size_t connections) {
+    boost::asio::io_context ctx {};
+    Server server {ctx, Server::Mode::Count};
+
+    std::vector<tcp::socket> sockets {};
+    sockets.reserve(connections);
+    const auto start = Clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        sockets.emplace_back(ctx).async_connect(SERVER_ENDPOINT, [](const boost::system::error_code&) {});
+    }
+    while (server.accepted() < connections) ctx.run_for(1ms);
+    const auto elapsed = Clock::now() - start;
+
+    BenchReport::record_rate(benchmark, "accepts", static_cast<double>(connections), elapsed, "connections/s");
+}
+
+// Every connection sends a message and waits for its echo; the round trips are split over the connections
+void tcp_echo_scaling(const std::string_view benchmark, const size_t connections, const size_t round_trips) {
+    boost::asio::io_context ctx {};
+    Server server {ctx, Server::Mode::Echo};
+
+    const auto message = make_message(64);
+    const size_t round_trips_per_connection = std::max<size_t>(round_trips / connections, 1);
+
+    size_t finished {0};
+    const auto start = Clock::now();
+    for (size_t i = 0; i < connections; ++i) {
+        co_spawn(ctx, [&]()->boost::asio::awaitable<void> {
+            tcp::socket socket {ctx};
+            co_await socket.async_connect(SERVER_ENDPOINT, as_tuple(boost::asio::use_awaitable));
+            socket.set_option(tcp::no_delay(true));
+
+            std::array<uint8_t, 256> echo {};
+            for (size_t r = 0; r < round_trips_per_connection; ++r) {
+                co_await async_write(socket, boost::asio::buffer(message->data(), message->size()),
+                    as_tuple(boost::asio::use_awaitable));
+                co_await async_read(socket, boost::asio::buffer(echo.data(), message->size()),
+                    as_tuple(boost::asio::use_awaitable));
+            }
+            ++finished;
+        }, boost::asio::detached);
+    }
+    while (finished < connections) ctx.run_for(1ms);
+    const auto elapsed = Clock::now() - start;
+
+    BenchReport::record_rate(benchmark, "round_trips",
+        static_cast<double>(connections * round_trips_per_connection), elapsed, "round_trips/s");
+}
+}
+
+TEST_CASE("TCP echo round-trip latency", "[network]") {
+    tcp_echo_latency("tcp_echo_latency_64B", 64, 10000);
+    tcp_echo_latency("tcp_echo_latency_1KiB", 1024, 10000);
+}
+
+TEST_CASE("TCP one-way throughput", "[network]") {
+    tcp_throughput("tcp_throughput_64B", 64, 200000, 256);
+    tcp_throughput("tcp_throughput_1KiB", 1024, 100000, 256);
+    tcp_throughput("tcp_throughput_64KiB", 65536, 2000, 16);
+}
+
+TEST_CASE("UDP packets per second", "[network]") {
+    udp_packets("udp_packets_per_packet", 100000, 64, 0, false);
+    udp_packets("udp_packets_batch_32", 100000, 64, 32, false);
+    udp_packets("udp_packets_segmentation_offload", 100000, 64, 32, true);
+}
+
+#ifdef SANHOK_IO_URING
+// Against the same benchmarks of a build without SANHOK_IO_URING, where Asio runs on epoll
+TEST_CASE("Receiving into io_uring provided buffers", "[network]") {
+    tcp_throughput("tcp_throughput_64B_provided_buffers", 64, 200000, 256, 256);
+    tcp_throughput("tcp_throughput_64KiB_provided_buffers", 65536, 2000, 16, 256);
+    udp_packets("udp_packets_provided_buffers", 100000, 64, 0, false, 256);
+}
+#endif
+
+TEST_CASE("TCP accept rate", "[network]") {
+    tcp_accept_rate("tcp_accept_rate", 1000);
+}
+
+TEST_CASE("TCP echo with many connections", "[network]") {
+    for (const size_t connections : {1, 10, 100, 1000}) {
+        tcp_echo_scaling("tcp_echo_connections_" + std::to_string(connections), connections, 20000);
+    }
+}
@@ -0,0 +1,128 @@
+// automatically generated by the FlatBuffers compiler, do not modify
+
+
+#ifndef FLATBUFFERS_GENERATED_PING_SANHOK_NET_TESTS_H_
+#define FLATBUFFERS_GENERATED_PING_SANHOK_NET_TESTS_H_
+
+#include "flatbuffers/flatbuffers.h"
+
+// Ensure the included flatbuffers.h is the same version as when this file was
+// generated, otherwise it may not be compatible.
+static_assert(FLATBUFFERS_VERSION_MAJOR == 24 &&
+              FLATBUFFERS_VERSION_MINOR == 3 &&
+              FLATBUFFERS_VERSION_REVISION == 25,
+             "Non-compatible flatbuffers version included");
+
+namespace sanhok {
+namespace net {
+namespace tests {
+
+struct Ping;
+struct PingBuilder;
+
+struct Ping FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef PingBuilder Builder;
+  struct Traits;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_PING = 4
+  };
+  const ::flatbuffers::String *ping() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_PING);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_PING) &&
+           verifier.VerifyString(ping()) &&
+           verifier.EndTable();
+  }
+};
+
+struct PingBuilder {
+  typedef Ping Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_ping(::flatbuffers::Offset<::flatbuffers::String> ping) {
+    fbb_.AddOffset(Ping::VT_PING, ping);
+  }
+  explicit PingBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<Ping> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<Ping>(end);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<Ping> CreatePing(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> ping = 0) {
+  PingBuilder builder_(_fbb);
+  builder_.add_ping(ping);
+  return builder_.Finish();
+}
+
+struct Ping::Traits {
+  using type = Ping;
+  static auto constexpr Create = CreatePing;
+};
+
+inline ::flatbuffers::Offset<Ping> CreatePingDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *ping = nullptr) {
+  auto ping__ = ping ? _fbb.CreateString(ping) : 0;
+  return sanhok::net::tests::CreatePing(
+      _fbb,
+      ping__);
+}
+
+inline const sanhok::net::tests::Ping *GetPing(const void *buf) {
+  return ::flatbuffers::GetRoot<sanhok::net::tests::Ping>(buf);
+}
+
+inline const sanhok::net::tests::Ping *GetSizePrefixedPing(const void *buf) {
+  return ::flatbuffers::GetSizePrefixedRoot<sanhok::net::tests::Ping>(buf);
+}
+
+inline const char *PingIdentifier() {
+  return "PING";
+}
+
+inline bool PingBufferHasIdentifier(const void *buf) {
+  return ::flatbuffers::BufferHasIdentifier(
+      buf, PingIdentifier());
+}
+
+inline bool SizePrefixedPingBufferHasIdentifier(const void *buf) {
+  return ::flatbuffers::BufferHasIdentifier(
+      buf, PingIdentifier(), true);
+}
+
+inline bool VerifyPingBuffer(
+    ::flatbuffers::Verifier &verifier) {
+  return verifier.VerifyBuffer<sanhok::net::tests::Ping>(PingIdentifier());
+}
+
+inline bool VerifySizePrefixedPingBuffer(
+    ::flatbuffers::Verifier &verifier) {
+  return verifier.VerifySizePrefixedBuffer<sanhok::net::tests::Ping>(PingIdentifier());
+}
+
+inline void FinishPingBuffer(
+    ::flatbuffers::FlatBufferBuilder &fbb,
+    ::flatbuffers::Offset<sanhok::net::tests::Ping> root) {
+  fbb.Finish(root, PingIdentifier());
+}
+
+inline void FinishSizePrefixedPingBuffer(
+    ::flatbuffers::FlatBufferBuilder &fbb,
+    ::flatbuffers::Offset<sanhok::net::tests::Ping> root) {
+  fbb.FinishSizePrefixed(root, PingIdentifier());
+}
+
+}  // namespace tests
+}  // namespace net
+}  // namespace sanhok
+
+#endif  // FLATBUFFERS_GENERATED_PING_SANHOK_NET_TESTS_H_
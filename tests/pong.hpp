@@ -0,0 +1,128 @@
+// automatically generated by the FlatBuffers compiler, do not modify
+
+
+#ifndef FLATBUFFERS_GENERATED_PONG_SANHOK_NET_TESTS_H_
+#define FLATBUFFERS_GENERATED_PONG_SANHOK_NET_TESTS_H_
+
+#include "flatbuffers/flatbuffers.h"
+
+// Ensure the included flatbuffers.h is the same version as when this file was
+// generated, otherwise it may not be compatible.
+static_assert(FLATBUFFERS_VERSION_MAJOR == 24 &&
+              FLATBUFFERS_VERSION_MINOR == 3 &&
+              FLATBUFFERS_VERSION_REVISION == 25,
+             "Non-compatible flatbuffers version included");
+
+namespace sanhok {
+namespace net {
+namespace tests {
+
+struct Pong;
+struct PongBuilder;
+
+struct Pong FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
+  typedef PongBuilder Builder;
+  struct Traits;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_PONG = 4
+  };
+  const ::flatbuffers::String *pong() const {
+    return GetPointer<const ::flatbuffers::String *>(VT_PONG);
+  }
+  bool Verify(::flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_PONG) &&
+           verifier.VerifyString(pong()) &&
+           verifier.EndTable();
+  }
+};
+
+struct PongBuilder {
+  typedef Pong Table;
+  ::flatbuffers::FlatBufferBuilder &fbb_;
+  ::flatbuffers::uoffset_t start_;
+  void add_pong(::flatbuffers::Offset<::flatbuffers::String> pong) {
+    fbb_.AddOffset(Pong::VT_PONG, pong);
+  }
+  explicit PongBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  ::flatbuffers::Offset<Pong> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = ::flatbuffers::Offset<Pong>(end);
+    return o;
+  }
+};
+
+inline ::flatbuffers::Offset<Pong> CreatePong(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    ::flatbuffers::Offset<::flatbuffers::String> pong = 0) {
+  PongBuilder builder_(_fbb);
+  builder_.add_pong(pong);
+  return builder_.Finish();
+}
+
+struct Pong::Traits {
+  using type = Pong;
+  static auto constexpr Create = CreatePong;
+};
+
+inline ::flatbuffers::Offset<Pong> CreatePongDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    const char *pong = nullptr) {
+  auto pong__ = pong ? _fbb.CreateString(pong) : 0;
+  return sanhok::net::tests::CreatePong(
+      _fbb,
+      pong__);
+}
+
+inline const sanhok::net::tests::Pong *GetPong(const void *buf) {
+  return ::flatbuffers::GetRoot<sanhok::net::tests::Pong>(buf);
+}
+
+inline const sanhok::net::tests::Pong *GetSizePrefixedPong(const void *buf) {
+  return ::flatbuffers::GetSizePrefixedRoot<sanhok::net::tests::Pong>(buf);
+}
+
+inline const char *PongIdentifier() {
+  return "PONG";
+}
+
+inline bool PongBufferHasIdentifier(const void *buf) {
+  return ::flatbuffers::BufferHasIdentifier(
+      buf, PongIdentifier());
+}
+
+inline bool SizePrefixedPongBufferHasIdentifier(const void *buf) {
+  return ::flatbuffers::BufferHasIdentifier(
+      buf, PongIdentifier(), true);
+}
+
+inline bool VerifyPongBuffer(
+    ::flatbuffers::Verifier &verifier) {
+  return verifier.VerifyBuffer<sanhok::net::tests::Pong>(PongIdentifier());
+}
+
+inline bool VerifySizePrefixedPongBuffer(
+    ::flatbuffers::Verifier &verifier) {
+  return verifier.VerifySizePrefixedBuffer<sanhok::net::tests::Pong>(PongIdentifier());
+}
+
+inline void FinishPongBuffer(
+    ::flatbuffers::FlatBufferBuilder &fbb,
+    ::flatbuffers::Offset<sanhok::net::tests::Pong> root) {
+  fbb.Finish(root, PongIdentifier());
+}
+
+inline void FinishSizePrefixedPongBuffer(
+    ::flatbuffers::FlatBufferBuilder &fbb,
+    ::flatbuffers::Offset<sanhok::net::tests::Pong> root) {
+  fbb.FinishSizePrefixed(root, PongIdentifier());
+}
+
+}  // namespace tests
+}  // namespace net
+}  // namespace sanhok
+
+#endif  // FLATBUFFERS_GENERATED_PONG_SANHOK_NET_TESTS_H_
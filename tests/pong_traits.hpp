@@ -0,0 +1,13 @@
+// automatically generated by skymarlin_compile_schemas, do not modify
+#pragma once
+
+#include <sanhok/net/message_dispatcher.hpp>
+
+#include "pong.hpp"
+
+namespace sanhok::net {
+template <>
+struct MessageTraits<sanhok::net::tests::Pong> {
+    static constexpr std::string_view identifier {"PONG"};
+};
+}
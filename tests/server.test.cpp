@@ -1,13 +1,37 @@
 #include <catch2/catch_test_macros.hpp>
+#include <sanhok/net/broadcast_group.hpp>
+#include <sanhok/net/builder_pool.hpp>
+#include <sanhok/net/capture_replay.hpp>
 #include <sanhok/net/listener_tcp.hpp>
+#include <sanhok/net/metrics.hpp>
 #include <sanhok/net/peer_tcp.hpp>
 #include <sanhok/net/peer_udp.hpp>
+#include <sanhok/net/queue_limits.hpp>
+#include <sanhok/net/reliable_udp.hpp>
+#include <sanhok/net/server_runtime.hpp>
+#include <sanhok/net/server_udp.hpp>
+#include <sanhok/net/session_registry.hpp>
+#include <sanhok/net/timing_wheel.hpp>
 #include <tests/hello.hpp>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstring>
+#include <filesystem>
+#include <format>
+#include <future>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
 
+using namespace sanhok;
 using namespace sanhok::net;
 using namespace sanhok::net::tests;
 using namespace std::chrono_literals;
@@ -18,14 +42,16 @@ TEST_CASE("[tcp server]") {
 
     boost::asio::io_context ctx {};
     std::vector<std::unique_ptr<PeerTCP>> clients;
+    std::atomic<int> received {0};
 
-    const auto message_handler = [&MESSAGE](std::vector<uint8_t>&& message) {
+    const auto message_handler = [&MESSAGE, &received](std::vector<uint8_t>&& message) {
         flatbuffers::Verifier verifier {message.data(), message.size()};
         REQUIRE(VerifyHelloBuffer(verifier));
 
         const auto hello = GetHello(message.data());
         REQUIRE(hello->hello()->size() == MESSAGE.size());
         REQUIRE(memcmp(hello->hello()->data(), MESSAGE.data(), MESSAGE.size()) == 0);
+        ++received;
     };
 
     ListenerTCP listener {
@@ -59,9 +85,9 @@ TEST_CASE("[tcp server]") {
     SECTION("PeerTCP receives/sends Hello") {
         listener.start();
 
-        co_spawn(ctx, [&ctx]()->boost::asio::awaitable<void> {
-            PeerTCP client {ctx, tcp::socket {ctx}, {}};
-
+        // The client has to outlive its pending sends
+        PeerTCP client {ctx, tcp::socket {ctx}, {}};
+        co_spawn(ctx, [&client, &MESSAGE]()->boost::asio::awaitable<void> {
             co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
             REQUIRE(client.is_connected());
 
@@ -75,6 +101,32 @@ TEST_CASE("[tcp server]") {
         ctx.run_for(100ms);
 
         listener.stop();
+        client.disconnect();
+        clients.clear();
+    }
+
+    SECTION("PeerTCP receives a burst of Hello sent in one gather write") {
+        constexpr int MESSAGES = 50;
+        listener.start();
+
+        PeerTCP client {ctx, tcp::socket {ctx}, {}};
+        co_spawn(ctx, [&ctx, &client, &MESSAGE]()->boost::asio::awaitable<void> {
+            co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+            REQUIRE(client.is_connected());
+
+            flatbuffers::FlatBufferBuilder builder {64};
+            builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(MESSAGE)));
+            const auto message = std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+
+            for (int i = 0; i < MESSAGES; ++i) client.send_message(message);
+        }, boost::asio::detached);
+
+        ctx.run_for(100ms);
+
+        REQUIRE(received == MESSAGES);
+
+        listener.stop();
+        client.disconnect();
         clients.clear();
     }
 }
@@ -87,8 +139,8 @@ TEST_CASE("PeerUDP receives/sends Hello", "[udp server]") {
 
     boost::asio::io_context ctx {};
 
-    int packet_loss = PACKETS;
-    const auto packet_handler = [&MESSAGE, &packet_loss](std::vector<uint8_t>&& message) {
+    std::atomic<int> packet_loss = PACKETS;
+    const auto packet_handler = [&MESSAGE, &packet_loss](std::span<const uint8_t> message) {
         flatbuffers::Verifier verifier {message.data(), message.size()};
         REQUIRE(VerifySizePrefixedHelloBuffer(verifier));
 
@@ -101,8 +153,9 @@ TEST_CASE("PeerUDP receives/sends Hello", "[udp server]") {
     PeerUDP server {ctx, SERVER_ENDPOINT, packet_handler};
     server.open();
 
-    co_spawn(ctx, [&ctx, &SERVER_ENDPOINT, &CLIENT_ENDPOINT, &MESSAGE, &packet_handler]()->boost::asio::awaitable<void> {
-        PeerUDP client {ctx, CLIENT_ENDPOINT, packet_handler};
+    // The client outlives the coroutine so that its sends complete
+    PeerUDP client {ctx, CLIENT_ENDPOINT, packet_handler};
+    co_spawn(ctx, [&SERVER_ENDPOINT, &MESSAGE, &client]()->boost::asio::awaitable<void> {
         client.connect(SERVER_ENDPOINT);
         client.open();
 
@@ -119,5 +172,1657 @@ TEST_CASE("PeerUDP receives/sends Hello", "[udp server]") {
     ctx.run_for(100ms);
 
     REQUIRE(packet_loss < PACKETS);
-    std::cout << std::format("{} packets are lost out of {}", packet_loss, PACKETS) << std::endl;
+    std::cout << std::format("{} packets are lost out of {}", packet_loss.load(), PACKETS) << std::endl;
+}
+
+TEST_CASE("PeerUDP batches packets with recvmmsg/sendmmsg", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50004};
+    const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50005};
+    constexpr int PACKETS = 100;
+
+    boost::asio::io_context ctx {};
+
+    std::vector<std::string> received {};
+    const auto packet_handler = [&received](std::span<const uint8_t> message) {
+        flatbuffers::Verifier verifier {message.data(), message.size()};
+        REQUIRE(VerifySizePrefixedHelloBuffer(verifier));
+        received.push_back(GetSizePrefixedHello(message.data())->hello()->str());
+    };
+
+    PeerUDP server {ctx, SERVER_ENDPOINT, packet_handler};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+    server.set_batch_io(16);
+
+    PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+    client.set_batch_io(16);
+
+    SECTION("A datagram per packet") {}
+    SECTION("Runs of equally sized packets with UDP_SEGMENT/UDP_GRO") {
+        server.set_segmentation_offload(true);
+        client.set_segmentation_offload(true);
+    }
+
+    server.open();
+    client.connect(SERVER_ENDPOINT);
+    client.open();
+
+    // Runs of 10 packets of the same size, packed back to back in the receive buffer
+    const auto text = [](const int i) { return std::string(i / 10 % 7 + 1, 'a' + i % 26); };
+    for (int i = 0; i < PACKETS; ++i) {
+        flatbuffers::FlatBufferBuilder builder {64};
+        builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(text(i))));
+        client.send_packet(std::make_shared<flatbuffers::DetachedBuffer>(builder.Release()));
+    }
+
+    ctx.run_for(100ms);
+
+#ifdef __linux__
+    // Loopback does not drop this few packets
+    REQUIRE(received.size() == PACKETS);
+    for (int i = 0; i < PACKETS; ++i) {
+        REQUIRE(received[i] == text(i));
+    }
+#endif
+}
+
+TEST_CASE("PeerUDP drops packets sent while it is not open", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50035};
+    const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50036};
+
+    boost::asio::io_context ctx {};
+
+    std::vector<uint8_t> received {};
+    PeerUDP server {ctx, SERVER_ENDPOINT, [&received](std::span<const uint8_t> packet) {
+        received.push_back(packet[0]);
+    }};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+    server.open();
+
+    PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+    SECTION("A datagram per send") {}
+    SECTION("Batches of sendmmsg") {
+        client.set_batch_io(16);
+    }
+    client.connect(SERVER_ENDPOINT);
+
+    const auto send = [&client](const uint8_t value) {
+        auto packet = BufferPool::shared().acquire(1);
+        packet.data()[0] = value;
+        client.send_packet(std::move(packet));
+    };
+    send(1);
+    client.open();
+    send(2);
+    ctx.run_for(20ms);
+    client.close();
+    send(3);
+    ctx.run_for(20ms);
+
+    REQUIRE(received == std::vector<uint8_t> {2});
+
+    server.close();
+}
+
+TEST_CASE("PeerUDP drops the packets still queued when closed and opened again", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50037};
+    const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50038};
+
+    boost::asio::io_context ctx {};
+
+    // The handler holds the first packet on the dedicated thread while the next ones queue up behind it
+    std::atomic<bool> is_held {false};
+    std::atomic<bool> is_released {false};
+    std::mutex mutex {};
+    std::vector<uint8_t> received {};
+    PeerUDP server {ctx, SERVER_ENDPOINT, [&](std::span<const uint8_t> packet) {
+        if (packet[0] == 1) {
+            is_held = true;
+            is_released.wait(false);
+        }
+        std::lock_guard lock {mutex};
+        received.insert(received.end(), packet.begin(), packet.end());
+    }};
+    server.open();
+
+    PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+    client.connect(SERVER_ENDPOINT);
+    client.open();
+
+    // Each packet repeats its value as many times, so that a stale one is told apart by its size
+    const auto send = [&client](const uint8_t value) {
+        auto packet = BufferPool::shared().acquire(value);
+        std::fill_n(packet.data(), value, value);
+        client.send_packet(std::move(packet));
+    };
+    const auto received_bytes = [&] {
+        std::lock_guard lock {mutex};
+        return received;
+    };
+
+    send(1);
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (!is_held && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(is_held);
+    send(2);
+    send(3);
+    ctx.run_for(20ms);
+
+    server.close();
+    is_released = true;
+    is_released.notify_all();
+    ctx.run_for(10ms);
+    server.open();
+
+    send(4);
+    send(5);
+    deadline = std::chrono::steady_clock::now() + 1s;
+    while (received_bytes().size() < 10 && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(received_bytes() == std::vector<uint8_t> {1, 4, 4, 4, 4, 5, 5, 5, 5, 5});
+
+    client.close();
+    server.close();
+}
+
+TEST_CASE("PeerUDP delivers empty datagrams with and without batched I/O", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50028};
+    constexpr int PACKETS = 20;
+
+    boost::asio::io_context ctx {};
+
+    std::vector<size_t> received {};
+    PeerUDP server {ctx, SERVER_ENDPOINT, [&received](std::span<const uint8_t> packet) {
+        received.push_back(packet.size());
+    }};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+
+    SECTION("A packet per receive") {}
+    SECTION("Batches of recvmmsg") {
+        server.set_batch_io(64);
+    }
+    SECTION("Batches of recvmmsg with UDP_GRO, the ring grown to fit them") {
+        server.set_batch_io(64);
+        server.set_segmentation_offload(true);
+    }
+    server.open();
+
+    // Every other datagram is empty
+    udp::socket client {ctx, udp::endpoint {udp::v4(), 0}};
+    std::vector<size_t> expected {};
+    const std::array<uint8_t, 1> byte {42};
+    for (int i = 0; i < PACKETS; ++i) {
+        const size_t size = i % 2;
+        client.send_to(boost::asio::buffer(byte, size), SERVER_ENDPOINT);
+        expected.push_back(size);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (received.size() < PACKETS && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(received == expected);
+
+    server.close();
+    ctx.run_for(10ms);
+}
+
+TEST_CASE("PeerUDP coalesces runs of packets with segmentation offload alone", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50025};
+    const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50026};
+    constexpr int PACKETS = 100;
+
+    boost::asio::io_context ctx {};
+
+    std::vector<std::string> received {};
+    PeerUDP server {ctx, SERVER_ENDPOINT, [&received](std::span<const uint8_t> message) {
+        received.push_back(GetSizePrefixedHello(message.data())->hello()->str());
+    }};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+    server.open();
+
+    // Without set_batch_io, so batches of 1
+    PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+    client.set_segmentation_offload(true);
+    client.connect(SERVER_ENDPOINT);
+    client.open();
+
+    // Queued before the io_context runs, so that they go out together
+    const auto text = [](const int i) { return std::string(8, 'a' + i % 26); };
+    for (int i = 0; i < PACKETS; ++i) {
+        flatbuffers::FlatBufferBuilder builder {64};
+        builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(text(i))));
+        client.send_packet(std::make_shared<flatbuffers::DetachedBuffer>(builder.Release()));
+    }
+
+    ctx.run_for(100ms);
+
+#ifdef __linux__
+    REQUIRE(received.size() == PACKETS);
+    for (int i = 0; i < PACKETS; ++i) {
+        REQUIRE(received[i] == text(i));
+    }
+
+    if constexpr (METRICS_ENABLED) {
+        const auto sent = client.metrics().snapshot();
+        REQUIRE(sent.messages_out == PACKETS);
+        // Runs of up to 64 segments per datagram
+        REQUIRE(sent.datagrams_out >= 2);
+        REQUIRE(sent.datagrams_out < sent.messages_out);
+    }
+#endif
+}
+
+#ifdef SANHOK_IO_URING
+TEST_CASE("Peers receive into io_uring provided buffers", "[udp server][tcp server]") {
+    constexpr int MESSAGES = 1000;
+    const auto text = [](const int i) { return std::string(i % 100 + 1, 'a' + i % 26); };
+
+    boost::asio::io_context ctx {};
+    std::mutex mutex {};
+    std::vector<std::string> received {};
+
+    SECTION("PeerUDP") {
+        const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50016};
+        const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50017};
+
+        PeerUDP server {ctx, SERVER_ENDPOINT, [&mutex, &received](std::span<const uint8_t> message) {
+            flatbuffers::Verifier verifier {message.data(), message.size()};
+            REQUIRE(VerifySizePrefixedHelloBuffer(verifier));
+            std::lock_guard lock {mutex};
+            received.push_back(GetSizePrefixedHello(message.data())->hello()->str());
+        }};
+        SECTION("Handled inline in the provided buffer") {
+            server.set_handler_dispatch(HandlerDispatch::inline_io());
+        }
+        SECTION("Copied to the receive buffer for the dedicated thread") {}
+        server.set_provided_buffers(64);
+        server.open();
+
+        PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+        client.connect(SERVER_ENDPOINT);
+        client.open();
+
+        // Paced so that loopback does not drop any
+        for (int i = 0; i < MESSAGES; i += 10) {
+            for (int j = i; j < i + 10; ++j) {
+                flatbuffers::FlatBufferBuilder builder {64};
+                builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(text(j))));
+                client.send_packet(std::make_shared<flatbuffers::DetachedBuffer>(builder.Release()));
+            }
+            ctx.run_for(1ms);
+        }
+        ctx.run_for(100ms);
+
+        std::lock_guard lock {mutex};
+        REQUIRE(received.size() == MESSAGES);
+        for (int i = 0; i < MESSAGES; ++i) REQUIRE(received[i] == text(i));
+        REQUIRE(server.metrics().receive_errors.load() == 0);
+
+        server.close();
+        client.close();
+    }
+
+    SECTION("PeerTCP") {
+        constexpr unsigned short LISTEN_PORT {50018};
+
+        std::vector<std::unique_ptr<PeerTCP>> clients;
+        ListenerTCP listener {
+            ctx, LISTEN_PORT,
+            [&clients, &received](boost::asio::io_context& ctx, tcp::socket&& socket) {
+                auto new_client = std::make_unique<PeerTCP>(ctx, std::move(socket), [&received](MessageBuffer&& message) {
+                    flatbuffers::Verifier verifier {message.data(), message.size()};
+                    REQUIRE(VerifyHelloBuffer(verifier));
+                    received.push_back(GetHello(message.data())->hello()->str());
+                });
+                new_client->set_handler_dispatch(HandlerDispatch::inline_io());
+                // Smaller than most messages, so that they span buffers and the ring runs out
+                new_client->set_provided_buffers(4, 64);
+                new_client->run();
+                clients.push_back(std::move(new_client));
+            }
+        };
+        listener.start();
+
+        PeerTCP client {ctx, tcp::socket {ctx}, {}};
+        co_spawn(ctx, [&client, &text]()->boost::asio::awaitable<void> {
+            co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+            REQUIRE(client.is_connected());
+
+            for (int i = 0; i < MESSAGES; ++i) {
+                flatbuffers::FlatBufferBuilder builder {64};
+                builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(text(i))));
+                client.send_message(std::make_shared<flatbuffers::DetachedBuffer>(builder.Release()));
+            }
+        }, boost::asio::detached);
+
+        ctx.run_for(200ms);
+
+        REQUIRE(received.size() == MESSAGES);
+        for (int i = 0; i < MESSAGES; ++i) REQUIRE(received[i] == text(i));
+
+        // The end of the stream disconnects the server side
+        client.disconnect();
+        ctx.run_for(50ms);
+        REQUIRE(clients.size() == 1);
+        REQUIRE(!clients.front()->is_connected());
+
+        listener.stop();
+        clients.clear();
+    }
+}
+#endif
+
+namespace {
+// Relays datagrams between two endpoints, dropping some and delaying the rest at random so that they are reordered
+class ImpairedRelay {
+public:
+    ImpairedRelay(boost::asio::io_context& ctx, const udp::endpoint& endpoint, const udp::endpoint& a,
+        const udp::endpoint& b, const uint32_t loss_percent, const std::chrono::milliseconds max_delay)
+        : ctx_(ctx), socket_(ctx, endpoint), a_(a), b_(b), loss_percent_(loss_percent), max_delay_(max_delay) {}
+
+    void start() {
+        co_spawn(ctx_, [this]()->boost::asio::awaitable<void> {
+            std::array<uint8_t, 2048> buffer {};
+            udp::endpoint from {};
+            while (true) {
+                const auto [ec, size] = co_await socket_.async_receive_from(boost::asio::buffer(buffer), from,
+                    as_tuple(boost::asio::use_awaitable));
+                if (ec) co_return;
+
+                if (rng_() % 100 < loss_percent_) {
+                    ++dropped_;
+                    continue;
+                }
+                relay(from == a_ ? b_ : a_, {buffer.begin(), buffer.begin() + size});
+            }
+        }, boost::asio::detached);
+    }
+
+    size_t dropped() const { return dropped_; }
+
+private:
+    void relay(const udp::endpoint to, std::vector<uint8_t> packet) {
+        const auto delay = std::chrono::milliseconds {rng_() % (max_delay_.count() + 1)};
+        co_spawn(ctx_, [this, to, delay, packet = std::move(packet)]()->boost::asio::awaitable<void> {
+            boost::asio::steady_timer timer {ctx_, delay};
+            co_await timer.async_wait(as_tuple(boost::asio::use_awaitable));
+            co_await socket_.async_send_to(boost::asio::buffer(packet), to, as_tuple(boost::asio::use_awaitable));
+        }, boost::asio::detached);
+    }
+
+    boost::asio::io_context& ctx_;
+    udp::socket socket_;
+    const udp::endpoint a_;
+    const udp::endpoint b_;
+    const uint32_t loss_percent_;
+    const std::chrono::milliseconds max_delay_;
+    std::mt19937 rng_ {42};
+    size_t dropped_ {0};
+};
+}
+
+TEST_CASE("ReliableUDP delivers through a relay that drops and reorders packets", "[udp server]") {
+    const udp::endpoint RELAY_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50011};
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50012};
+    const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50013};
+    constexpr uint8_t ORDERED {0};
+    constexpr uint8_t UNORDERED {1};
+    constexpr uint32_t MESSAGES {500};
+    const std::vector CHANNELS {ChannelMode::ReliableOrdered, ChannelMode::ReliableUnordered};
+
+    boost::asio::io_context ctx {};
+    ImpairedRelay relay {ctx, RELAY_ENDPOINT, SERVER_ENDPOINT, CLIENT_ENDPOINT, 20, 10ms};
+
+    std::array<std::vector<uint32_t>, 2> received {};
+    ReliableUDP server {ctx, SERVER_ENDPOINT, CHANNELS, [&received](uint8_t channel, std::span<const uint8_t> message) {
+        uint32_t value {};
+        std::memcpy(&value, message.data(), sizeof(value));
+        received[channel].push_back(value);
+    }};
+    ReliableUDP client {ctx, CLIENT_ENDPOINT, CHANNELS, [](uint8_t, std::span<const uint8_t>) {}};
+
+    relay.start();
+    server.connect(RELAY_ENDPOINT);
+    server.open();
+    client.connect(RELAY_ENDPOINT);
+    client.open();
+
+    for (uint32_t i = 0; i < MESSAGES; ++i) {
+        std::array<uint8_t, sizeof(i)> message {};
+        std::memcpy(message.data(), &i, sizeof(i));
+        client.send(ORDERED, message);
+        client.send(UNORDERED, message);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while ((received[ORDERED].size() < MESSAGES || received[UNORDERED].size() < MESSAGES) &&
+        std::chrono::steady_clock::now() < deadline) {
+        ctx.run_for(10ms);
+    }
+
+    std::vector<uint32_t> expected(MESSAGES);
+    std::iota(expected.begin(), expected.end(), 0);
+    REQUIRE(received[ORDERED] == expected);
+    REQUIRE(received[UNORDERED] != expected);
+    std::ranges::sort(received[UNORDERED]);
+    REQUIRE(received[UNORDERED] == expected);
+    REQUIRE(relay.dropped() > 0);
+
+    client.close();
+    server.close();
+}
+
+TEST_CASE("ServerUDP routes datagrams of many endpoints to their sessions", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50014};
+    constexpr int CLIENTS = 32;
+    constexpr int PACKETS = 4;
+
+    boost::asio::io_context ctx {};
+
+    // A session echoes what it receives, which has to come from one client, up to CLIENTS open sessions
+    std::vector<std::shared_ptr<SessionUDP>> sessions {};
+    ServerUDP server {ctx, SERVER_ENDPOINT, [&sessions](const std::shared_ptr<SessionUDP>& session) -> ServerUDP::PacketHandler {
+        if (std::ranges::count_if(sessions, &SessionUDP::is_open) == CLIENTS) return {};
+
+        sessions.push_back(session);
+        return [session = session.get(), client = std::optional<uint8_t> {}](std::span<const uint8_t> packet) mutable {
+            if (!client) client = packet[0];
+            REQUIRE(packet[0] == *client);
+
+            auto echo = BufferPool::shared().acquire(packet.size());
+            std::ranges::copy(packet, echo.begin());
+            session->send_packet(std::move(echo));
+        };
+    }};
+    server.start();
+
+    std::array<int, CLIENTS + 1> echoes {};
+    std::vector<std::unique_ptr<PeerUDP>> clients {};
+    for (int i = 0; i <= CLIENTS; ++i) {
+        clients.push_back(std::make_unique<PeerUDP>(ctx, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0},
+            [&echoes, i](std::span<const uint8_t> packet) {
+                REQUIRE(packet[0] == i);
+                ++echoes[i];
+            }));
+        clients.back()->set_handler_dispatch(HandlerDispatch::inline_io());
+        clients.back()->connect(SERVER_ENDPOINT);
+        clients.back()->open();
+    }
+
+    const auto send = [&clients](const int client, const int packets) {
+        for (int i = 0; i < packets; ++i) {
+            auto packet = BufferPool::shared().acquire(2);
+            packet.data()[0] = static_cast<uint8_t>(client);
+            packet.data()[1] = static_cast<uint8_t>(i);
+            clients[client]->send_packet(std::move(packet));
+        }
+    };
+    const auto run_until = [&ctx](const auto done) {
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (!done() && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    };
+
+    for (int i = 0; i < CLIENTS; ++i) send(i, PACKETS);
+    run_until([&echoes] { return std::accumulate(echoes.begin(), echoes.end(), 0) == CLIENTS * PACKETS; });
+
+    // Loopback does not drop this few packets
+    REQUIRE(server.session_count() == CLIENTS);
+    for (int i = 0; i < CLIENTS; ++i) REQUIRE(echoes[i] == PACKETS);
+
+    SECTION("Drops datagrams of endpoints on_session rejects") {
+        send(CLIENTS, PACKETS);
+        ctx.run_for(20ms);
+
+        REQUIRE(echoes[CLIENTS] == 0);
+        REQUIRE(server.session_count() == CLIENTS);
+    }
+
+    SECTION("A closed session is replaced on the next datagram") {
+        sessions[0]->close();
+        ctx.run_for(10ms);
+        REQUIRE(server.session_count() == CLIENTS - 1);
+
+        send(0, 1);
+        run_until([&echoes] { return echoes[0] == PACKETS + 1; });
+        REQUIRE(echoes[0] == PACKETS + 1);
+        REQUIRE(server.session_count() == CLIENTS);
+        REQUIRE(sessions.size() == CLIENTS + 1);
+        REQUIRE(sessions.back()->remote_endpoint() == sessions.front()->remote_endpoint());
+    }
+
+    server.stop();
+    ctx.run_for(10ms);
+    REQUIRE(server.session_count() == 0);
+    REQUIRE(!sessions.back()->is_open());
+    for (const auto& client : clients) client->close();
+}
+
+TEST_CASE("ServerUDP caps its sessions and closes idle ones", "[udp server]") {
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50027};
+    constexpr size_t MAX_SESSIONS = 2;
+    constexpr auto IDLE_TIMEOUT = 50ms;
+
+    boost::asio::io_context ctx {};
+    TimingWheel wheel {ctx, 5ms};
+    wheel.start();
+
+    std::vector<std::shared_ptr<SessionUDP>> sessions {};
+    size_t received {0};
+    ServerUDP server {ctx, SERVER_ENDPOINT, [&sessions, &received](const std::shared_ptr<SessionUDP>& session) {
+        sessions.push_back(session);
+        return ServerUDP::PacketHandler {[&received](std::span<const uint8_t>) { ++received; }};
+    }};
+    server.set_max_sessions(MAX_SESSIONS);
+    server.set_idle_timeout(wheel, IDLE_TIMEOUT);
+    server.start();
+
+    std::vector<std::unique_ptr<PeerUDP>> clients {};
+    for (size_t i = 0; i <= MAX_SESSIONS; ++i) {
+        clients.push_back(std::make_unique<PeerUDP>(ctx, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0},
+            [](std::span<const uint8_t>) {}));
+        clients.back()->connect(SERVER_ENDPOINT);
+        clients.back()->open();
+    }
+    const auto send = [&clients](const size_t client) {
+        auto packet = BufferPool::shared().acquire(1);
+        packet.data()[0] = static_cast<uint8_t>(client);
+        clients[client]->send_packet(std::move(packet));
+    };
+
+    // The endpoint past the cap is dropped before on_session
+    for (size_t i = 0; i <= MAX_SESSIONS; ++i) send(i);
+    ctx.run_for(20ms);
+    REQUIRE(received == MAX_SESSIONS);
+    REQUIRE(sessions.size() == MAX_SESSIONS);
+    REQUIRE(server.session_count() == MAX_SESSIONS);
+    REQUIRE(server.metrics().snapshot().dropped == (METRICS_ENABLED ? 1u : 0u));
+
+    // Only the first client keeps sending, for longer than the timeout
+    for (int i = 0; i < 10; ++i) {
+        send(0);
+        ctx.run_for(10ms);
+    }
+    REQUIRE(sessions[0]->is_open());
+    REQUIRE(!sessions[1]->is_open());
+    REQUIRE(server.session_count() == 1);
+
+    // The closed session made room for the endpoint dropped before
+    send(MAX_SESSIONS);
+    ctx.run_for(20ms);
+    REQUIRE(sessions.size() == MAX_SESSIONS + 1);
+    REQUIRE(server.session_count() == MAX_SESSIONS);
+
+    ctx.run_for(IDLE_TIMEOUT * 2);
+    REQUIRE(server.session_count() == 0);
+    REQUIRE(std::ranges::none_of(sessions, &SessionUDP::is_open));
+
+    server.stop();
+    for (const auto& client : clients) client->close();
+    ctx.run_for(10ms);
+
+    // A server destroyed while receiving is not resumed by its aborted receive
+    ctx.restart();
+    {
+        ServerUDP destroyed {ctx, SERVER_ENDPOINT, [](const std::shared_ptr<SessionUDP>&) {
+            return ServerUDP::PacketHandler {};
+        }};
+        destroyed.start();
+        ctx.run_for(10ms);
+    }
+    ctx.run_for(10ms);
+
+    // Nor by a receive or a send that had not started yet
+    ctx.restart();
+    {
+        ServerUDP destroyed {ctx, SERVER_ENDPOINT, [](const std::shared_ptr<SessionUDP>&) {
+            return ServerUDP::PacketHandler {};
+        }};
+        destroyed.start();
+    }
+    ctx.run_for(10ms);
+
+    ctx.restart();
+    {
+        std::shared_ptr<SessionUDP> session {};
+        ServerUDP destroyed {ctx, SERVER_ENDPOINT, [&session](const std::shared_ptr<SessionUDP>& new_session) {
+            session = new_session;
+            return ServerUDP::PacketHandler {[](std::span<const uint8_t>) {}};
+        }};
+        destroyed.start();
+
+        udp::socket sender {ctx, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0}};
+        sender.send_to(boost::asio::buffer("x", 1), SERVER_ENDPOINT);
+        ctx.run_for(10ms);
+        REQUIRE(session);
+
+        session->send_packet(BufferPool::shared().acquire(1));
+    }
+    ctx.run_for(10ms);
+}
+
+TEST_CASE("PeerTCP dispatches handlers in order", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50002};
+    constexpr int MESSAGES = 100;
+
+    boost::asio::io_context ctx {};
+    boost::asio::thread_pool pool {2};
+    std::vector<std::unique_ptr<PeerTCP>> clients;
+
+    std::mutex received_mutex {};
+    std::vector<std::string> received {};
+    const auto message_handler = [&received_mutex, &received](std::vector<uint8_t>&& message) {
+        std::lock_guard lock {received_mutex};
+        received.push_back(GetHello(message.data())->hello()->str());
+    };
+
+    auto dispatch = HandlerDispatch::dedicated_thread();
+    SECTION("Inline on the io_context") {
+        dispatch = HandlerDispatch::inline_io();
+    }
+    SECTION("On a shared thread pool") {
+        dispatch = HandlerDispatch::on(pool.get_executor());
+    }
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&clients, &message_handler, &dispatch](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            auto new_client = std::make_unique<PeerTCP>(ctx, std::move(socket), message_handler);
+            new_client->set_handler_dispatch(dispatch);
+            new_client->run();
+            clients.push_back(std::move(new_client));
+        }
+    };
+    listener.start();
+
+    PeerTCP client {ctx, tcp::socket {ctx}, {}};
+    co_spawn(ctx, [&client]()->boost::asio::awaitable<void> {
+        co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+        REQUIRE(client.is_connected());
+
+        for (int i = 0; i < MESSAGES; ++i) {
+            flatbuffers::FlatBufferBuilder builder {64};
+            builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(std::to_string(i))));
+            client.send_message(std::make_shared<flatbuffers::DetachedBuffer>(builder.Release()));
+        }
+    }, boost::asio::detached);
+
+    ctx.run_for(100ms);
+    pool.join();
+
+    REQUIRE(received.size() == MESSAGES);
+    for (int i = 0; i < MESSAGES; ++i) {
+        REQUIRE(received[i] == std::to_string(i));
+    }
+
+    listener.stop();
+    client.disconnect();
+    clients.clear();
+}
+
+TEST_CASE("Peers wait for the handler on their dedicated thread when destroyed", "[tcp server][udp server]") {
+    constexpr auto HANDLER_TIME = 200ms;
+
+    boost::asio::io_context ctx {};
+
+    flatbuffers::FlatBufferBuilder builder {64};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString("Hello")));
+    const auto message = std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+
+    std::atomic<bool> started {false};
+    std::atomic<bool> finished {false};
+    const auto handle = [&started, &finished, HANDLER_TIME] {
+        started = true;
+        std::this_thread::sleep_for(HANDLER_TIME);
+        finished = true;
+    };
+
+    SECTION("PeerTCP") {
+        constexpr unsigned short LISTEN_PORT {50029};
+
+        std::unique_ptr<PeerTCP> server;
+        ListenerTCP listener {
+            ctx, LISTEN_PORT,
+            [&server, &handle](boost::asio::io_context& ctx, tcp::socket&& socket) {
+                server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&handle](MessageBuffer&&) { handle(); });
+                server->run();
+            }
+        };
+        listener.start();
+
+        PeerTCP client {ctx, tcp::socket {ctx}, {}};
+        co_spawn(ctx, [&client, &message]()->boost::asio::awaitable<void> {
+            co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+            client.send_message(message);
+        }, boost::asio::detached);
+
+        ctx.run_for(100ms);
+        REQUIRE(started);
+        REQUIRE(!finished);
+
+        server.reset();
+        REQUIRE(finished);
+
+        listener.stop();
+        client.disconnect();
+    }
+
+    SECTION("PeerUDP") {
+        const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50030};
+        const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50031};
+
+        auto server = std::make_unique<PeerUDP>(ctx, SERVER_ENDPOINT,
+            [&handle](std::span<const uint8_t>) { handle(); });
+        server->open();
+
+        PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+        client.connect(SERVER_ENDPOINT);
+        client.open();
+        client.send_packet(message);
+
+        ctx.run_for(100ms);
+        REQUIRE(started);
+        REQUIRE(!finished);
+
+        server.reset();
+        REQUIRE(finished);
+
+        client.close();
+    }
+}
+
+TEST_CASE("PeerTCP hands pooled MessageBuffers to the handler", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50006};
+    constexpr int MESSAGES = 100;
+
+    boost::asio::io_context ctx {};
+    std::vector<std::unique_ptr<PeerTCP>> clients;
+
+    std::vector<std::string> received {};
+    const auto receive = [&received](std::span<const uint8_t> message) {
+        flatbuffers::Verifier verifier {message.data(), message.size()};
+        REQUIRE(VerifyHelloBuffer(verifier));
+        received.push_back(GetHello(message.data())->hello()->str());
+    };
+
+    bool vectors {false};
+    SECTION("MessageBuffer handlers") {}
+    SECTION("Vector handlers, copied into straight from the receive buffer") {
+        vectors = true;
+    }
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&clients, &receive, vectors](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            auto new_client = vectors
+                ? std::make_unique<PeerTCP>(ctx, std::move(socket),
+                    std::function<void(std::vector<uint8_t>&&)> {[&receive](std::vector<uint8_t>&& message) {
+                        receive(message);
+                    }})
+                : std::make_unique<PeerTCP>(ctx, std::move(socket), [&receive](MessageBuffer&& message) {
+                    receive(message.span());
+                });
+            new_client->set_handler_dispatch(HandlerDispatch::inline_io());
+            new_client->run();
+            clients.push_back(std::move(new_client));
+        }
+    };
+    listener.start();
+
+    const auto stats = BufferPool::shared().stats();
+
+    // Sends pooled messages too, from a pool of their own to count the receiving side alone
+    BufferPool send_pool {};
+    BuilderPool builder_pool {send_pool};
+    PeerTCP client {ctx, tcp::socket {ctx}, {}};
+    co_spawn(ctx, [&client, &builder_pool]()->boost::asio::awaitable<void> {
+        co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+        REQUIRE(client.is_connected());
+
+        for (int i = 0; i < MESSAGES; ++i) {
+            auto builder = builder_pool.acquire();
+            builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString(std::to_string(i))));
+            client.send_message(BuilderPool::release(*builder));
+        }
+    }, boost::asio::detached);
+
+    ctx.run_for(100ms);
+
+    REQUIRE(received.size() == MESSAGES);
+    for (int i = 0; i < MESSAGES; ++i) {
+        REQUIRE(received[i] == std::to_string(i));
+    }
+
+    // Handled inline, so every message after the first reuses the buffer released by the previous one
+    const auto pooled = BufferPool::shared().stats();
+    REQUIRE(pooled.misses - stats.misses <= 1);
+    if (vectors) REQUIRE(pooled.hits + pooled.misses == stats.hits + stats.misses);
+
+    listener.stop();
+    client.disconnect();
+    clients.clear();
+}
+
+TEST_CASE("BroadcastGroup sends a message to every peer", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50007};
+    constexpr int CLIENTS = 10;
+    constexpr int MESSAGES = 10;
+
+    boost::asio::io_context ctx {};
+    BroadcastGroup group {};
+    std::vector<std::unique_ptr<PeerTCP>> servers;
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&servers, &group](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            servers.push_back(std::make_unique<PeerTCP>(ctx, std::move(socket), std::function<void(std::vector<uint8_t>&&)> {}));
+            group.add(*servers.back());
+        }
+    };
+    listener.start();
+
+    std::vector<std::vector<std::string>> received(CLIENTS);
+    std::vector<std::unique_ptr<PeerTCP>> clients;
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.push_back(std::make_unique<PeerTCP>(ctx, tcp::socket {ctx}, [&received, i](MessageBuffer&& message) {
+            received[i].push_back(GetHello(message.data())->hello()->str());
+        }));
+        clients.back()->set_handler_dispatch(HandlerDispatch::inline_io());
+
+        co_spawn(ctx, [client = clients.back().get()]()->boost::asio::awaitable<void> {
+            co_await client->connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+            client->run();
+        }, boost::asio::detached);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (group.size() < CLIENTS && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(group.size() == CLIENTS);
+
+    BuilderPool builder_pool {};
+    for (int i = 0; i < MESSAGES; ++i) {
+        auto builder = builder_pool.acquire();
+        builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString(std::to_string(i))));
+        group.broadcast(BuilderPool::release(*builder));
+    }
+
+    ctx.run_for(100ms);
+
+    for (const auto& messages : received) {
+        REQUIRE(messages.size() == MESSAGES);
+        for (int i = 0; i < MESSAGES; ++i) REQUIRE(messages[i] == std::to_string(i));
+    }
+
+    // A batch posted before the peers are removed runs after they are gone without sending to them
+    auto builder = builder_pool.acquire();
+    builder->FinishSizePrefixed(CreateHello(*builder, builder->CreateString("Removed")));
+    group.broadcast(BuilderPool::release(*builder));
+    for (const auto& server : servers) group.remove(*server);
+    REQUIRE(group.size() == 0);
+    servers.clear();
+    ctx.run_for(10ms);
+
+    for (const auto& messages : received) REQUIRE(messages.size() == MESSAGES);
+
+    listener.stop();
+    for (const auto& client : clients) client->disconnect();
+}
+
+namespace {
+// A size-prefixed Hello of 1000 characters starting with the zero-padded id
+std::shared_ptr<flatbuffers::DetachedBuffer> make_numbered_hello(const int id) {
+    flatbuffers::FlatBufferBuilder builder {1100};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(std::format("{:04}{}", id, std::string(996, 'a')))));
+    return std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+}
+
+int hello_id(const std::vector<uint8_t>& message) {
+    return std::stoi(GetHello(message.data())->hello()->str().substr(0, 4));
+}
+}
+
+TEST_CASE("PeerTCP applies QueueLimits to its send queue", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50009};
+    constexpr int MESSAGES = 100;
+    constexpr size_t HIGH_WATERMARK = 8192;
+
+    boost::asio::io_context ctx {};
+    std::unique_ptr<PeerTCP> server {};
+    std::vector<int> received {};
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&server, &received](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&received](std::vector<uint8_t>&& message) {
+                received.push_back(hello_id(message));
+            });
+            server->set_handler_dispatch(HandlerDispatch::inline_io());
+            server->run();
+        }
+    };
+    listener.start();
+
+    int highs {0};
+    int lows {0};
+    QueueLimits limits {HIGH_WATERMARK, HIGH_WATERMARK / 2};
+    limits.on_high = [&highs] { ++highs; };
+    limits.on_low = [&lows] { ++lows; };
+
+    const size_t message_size = make_numbered_hello(0)->size();
+    const size_t fitting = HIGH_WATERMARK / message_size;
+
+    PeerTCP client {ctx, tcp::socket {ctx}, {}};
+    co_spawn(ctx, [&client]()->boost::asio::awaitable<void> {
+        co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+    }, boost::asio::detached);
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while ((!server || !client.is_connected()) && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(server);
+    REQUIRE(client.is_connected());
+
+    SECTION("DropNewest keeps the messages that fit") {
+        limits.overflow = QueueLimits::Overflow::DropNewest;
+        client.set_send_limits(limits);
+
+        // The io_context doesn't run while sending, so the queue only grows
+        for (int i = 0; i < MESSAGES; ++i) client.send_message(make_numbered_hello(i));
+        ctx.run_for(100ms);
+
+        REQUIRE(received.size() == fitting);
+        for (size_t i = 0; i < fitting; ++i) REQUIRE(received[i] == static_cast<int>(i));
+        REQUIRE(highs == 1);
+        REQUIRE(lows == 1);
+    }
+
+    SECTION("DropOldest keeps the latest messages") {
+        limits.overflow = QueueLimits::Overflow::DropOldest;
+        client.set_send_limits(limits);
+
+        for (int i = 0; i < MESSAGES; ++i) client.send_message(make_numbered_hello(i));
+        ctx.run_for(100ms);
+
+        REQUIRE(received.size() == fitting);
+        for (size_t i = 0; i < fitting; ++i) REQUIRE(received[i] == static_cast<int>(MESSAGES - fitting + i));
+        REQUIRE(highs == 1);
+    }
+
+    SECTION("Disconnect on overflow") {
+        limits.overflow = QueueLimits::Overflow::Disconnect;
+        client.set_send_limits(limits);
+
+        for (int i = 0; i < MESSAGES; ++i) client.send_message(make_numbered_hello(i));
+        REQUIRE(!client.is_connected());
+        REQUIRE(highs == 1);
+    }
+
+    SECTION("Block the sending thread until the queue falls to the low watermark") {
+        limits.overflow = QueueLimits::Overflow::Block;
+        client.set_send_limits(limits);
+
+        std::thread sender {[&client] {
+            for (int i = 0; i < MESSAGES; ++i) client.send_message(make_numbered_hello(i));
+        }};
+        deadline = std::chrono::steady_clock::now() + 5s;
+        while (received.size() < MESSAGES && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+        sender.join();
+
+        REQUIRE(received.size() == MESSAGES);
+        for (int i = 0; i < MESSAGES; ++i) REQUIRE(received[i] == i);
+        REQUIRE(highs >= 1);
+        REQUIRE(lows >= 1);
+    }
+
+    listener.stop();
+    client.disconnect();
+    server->disconnect();
+    ctx.run_for(10ms);
+}
+
+TEST_CASE("PeerTCP applies QueueLimits to its receive queue", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50010};
+    constexpr int MESSAGES = 100;
+    constexpr size_t HIGH_WATERMARK = 8192;
+
+    boost::asio::io_context ctx {};
+    std::unique_ptr<PeerTCP> server {};
+
+    // The handler thread holds the first message until it is released
+    std::atomic<bool> handling {false};
+    std::atomic<bool> released {false};
+    std::mutex received_mutex {};
+    std::vector<int> received {};
+    const auto received_count = [&received_mutex, &received] {
+        std::lock_guard lock {received_mutex};
+        return received.size();
+    };
+
+    std::atomic<int> highs {0};
+    std::atomic<int> lows {0};
+    QueueLimits limits {HIGH_WATERMARK, HIGH_WATERMARK / 2};
+    limits.on_high = [&highs] { ++highs; };
+    limits.on_low = [&lows] { ++lows; };
+
+    // Received messages are counted without their size prefix; the one being handled counts too
+    const size_t message_size = make_numbered_hello(0)->size() - sizeof(flatbuffers::uoffset_t);
+    const int fitting = static_cast<int>(HIGH_WATERMARK / message_size);
+    std::vector<int> expected {};
+
+    SECTION("Block stops reading the socket without dropping") {
+        limits.overflow = QueueLimits::Overflow::Block;
+        for (int i = 0; i < MESSAGES; ++i) expected.push_back(i);
+    }
+    SECTION("DropNewest keeps the messages that fit") {
+        limits.overflow = QueueLimits::Overflow::DropNewest;
+        for (int i = 0; i < fitting; ++i) expected.push_back(i);
+    }
+    SECTION("DropOldest keeps the message being handled and the latest ones") {
+        limits.overflow = QueueLimits::Overflow::DropOldest;
+        expected.push_back(0);
+        for (int i = MESSAGES - fitting + 1; i < MESSAGES; ++i) expected.push_back(i);
+    }
+    SECTION("Disconnect on overflow") {
+        limits.overflow = QueueLimits::Overflow::Disconnect;
+        expected.push_back(0);
+    }
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&](std::vector<uint8_t>&& message) {
+                handling = true;
+                released.wait(false);
+                std::lock_guard lock {received_mutex};
+                received.push_back(hello_id(message));
+            });
+            server->set_receive_limits(limits);
+            server->run();
+        }
+    };
+    listener.start();
+
+    PeerTCP client {ctx, tcp::socket {ctx}, {}};
+    co_spawn(ctx, [&client]()->boost::asio::awaitable<void> {
+        co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+        client.send_message(make_numbered_hello(0));
+    }, boost::asio::detached);
+
+    // The rest arrive while the first one is being handled, off the receive queue
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (!handling && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(handling);
+    for (int i = 1; i < MESSAGES; ++i) client.send_message(make_numbered_hello(i));
+
+    ctx.run_for(100ms);
+    REQUIRE(highs.load() == 1);
+    REQUIRE(received_count() == 0);
+    REQUIRE(server->is_connected() == (limits.overflow != QueueLimits::Overflow::Disconnect));
+
+    released = true;
+    released.notify_all();
+    while (received_count() < expected.size() && std::chrono::steady_clock::now() < deadline + 1s) ctx.run_for(1ms);
+    ctx.run_for(10ms);
+
+    {
+        std::lock_guard lock {received_mutex};
+        REQUIRE(received == expected);
+    }
+    if (limits.overflow != QueueLimits::Overflow::Disconnect) REQUIRE(lows.load() >= 1);
+
+    // The server sees the client go away
+    listener.stop();
+    client.disconnect();
+    ctx.run_for(10ms);
+    REQUIRE(!server->is_connected());
+    server->disconnect();
+    ctx.run_for(10ms);
+}
+
+TEST_CASE("PeerTCP disconnects a peer announcing a message over the max size", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50033};
+    constexpr size_t MAX_MESSAGE_SIZE = 4096;
+
+    boost::asio::io_context ctx {};
+    std::unique_ptr<PeerTCP> server {};
+    int received {0};
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&server, &received](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&received](MessageBuffer&&) { ++received; });
+            server->set_handler_dispatch(HandlerDispatch::inline_io());
+            server->set_max_message_size(MAX_MESSAGE_SIZE);
+            server->run();
+        }
+    };
+    listener.start();
+
+    tcp::socket client {ctx};
+    client.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LISTEN_PORT));
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (!server && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(server);
+
+    // A message that fits, then a prefix alone claiming nearly 4 GiB
+    const auto hello = make_numbered_hello(0);
+    REQUIRE(hello->size() <= MAX_MESSAGE_SIZE);
+    boost::asio::write(client, boost::asio::buffer(hello->data(), hello->size()));
+    const flatbuffers::uoffset_t huge {0xFFFFFF00};
+    boost::asio::write(client, boost::asio::buffer(&huge, sizeof(huge)));
+
+    deadline = std::chrono::steady_clock::now() + 1s;
+    while (server->is_connected() && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(!server->is_connected());
+    REQUIRE(received == 1);
+
+    listener.stop();
+    ctx.run_for(10ms);
+}
+
+TEST_CASE("Metrics count messages, accepts and latencies", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50008};
+    constexpr int MESSAGES = 10;
+
+    if constexpr (!METRICS_ENABLED) {
+        REQUIRE(std::is_empty_v<PeerMetrics>);
+        REQUIRE(std::is_empty_v<ListenerMetrics>);
+    }
+
+    boost::asio::io_context ctx {};
+    std::unique_ptr<PeerTCP> server {};
+    int received {0};
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        [&server, &received](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&received](MessageBuffer&&) { ++received; });
+            server->set_handler_dispatch(HandlerDispatch::inline_io());
+            server->run();
+        }
+    };
+    listener.start();
+
+    PeerTCP client {ctx, tcp::socket {ctx}, std::function<void(std::vector<uint8_t>&&)> {}};
+    co_spawn(ctx, [&client]()->boost::asio::awaitable<void> {
+        co_await client.connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+        client.run();
+    }, boost::asio::detached);
+    auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (!server && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(server);
+
+    // Latencies are shared by every peer, so only those recorded from here on are of these peers
+    const auto latencies_before = MetricsRegistry::instance().latencies_total();
+
+    flatbuffers::FlatBufferBuilder builder {64};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString("Hello")));
+    const auto message = std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+    for (int i = 0; i < MESSAGES; ++i) client.send_message(message);
+    deadline = std::chrono::steady_clock::now() + 1s;
+    while (received < MESSAGES && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(received == MESSAGES);
+
+    const auto sent = client.metrics().snapshot();
+    const auto handled = server->metrics().snapshot();
+    const auto accepted = listener.metrics().snapshot();
+    if constexpr (METRICS_ENABLED) {
+        REQUIRE(sent.messages_out == MESSAGES);
+        REQUIRE(sent.bytes_out == MESSAGES * message->size());
+        REQUIRE(sent.send_queue_depth == 0);
+        REQUIRE(handled.messages_in == MESSAGES);
+        REQUIRE(handled.bytes_in == MESSAGES * message->size());
+        REQUIRE(handled.receive_queue_depth == 0);
+        REQUIRE(handled.receive_queue_max_depth >= 1);
+        REQUIRE(accepted.accepts == 1);
+        REQUIRE(MetricsRegistry::instance().peer_count() >= 2);
+        REQUIRE(MetricsRegistry::instance().peers_total().messages_in >= MESSAGES);
+
+        const auto latencies = MetricsRegistry::instance().latencies_total();
+        REQUIRE(latencies.send.count() - latencies_before.send.count() == MESSAGES);
+        REQUIRE(latencies.queue_wait.count() - latencies_before.queue_wait.count() == MESSAGES);
+        REQUIRE(latencies.handler.count() - latencies_before.handler.count() == MESSAGES);
+        MetricsRegistry::instance().log_latencies();
+    } else {
+        REQUIRE(sent.messages_out == 0);
+        REQUIRE(handled.messages_in == 0);
+        REQUIRE(accepted.accepts == 0);
+        REQUIRE(MetricsRegistry::instance().peer_count() == 0);
+        REQUIRE(MetricsRegistry::instance().latencies_total().handler.count() == 0);
+    }
+
+    listener.stop();
+    client.disconnect();
+    server->disconnect();
+    ctx.run_for(10ms);
+}
+
+TEST_CASE("ServerRuntime spreads accepted sockets over io_contexts", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50003};
+    constexpr int CLIENTS = 8;
+
+    ServerRuntime runtime {2};
+
+    std::mutex accepted_mutex {};
+    std::map<boost::asio::io_context*, int> accepted {};
+    std::vector<tcp::socket> sockets {};
+    const auto on_acceptance = [&accepted_mutex, &accepted, &sockets](boost::asio::io_context& ctx, tcp::socket&& socket) {
+        REQUIRE(&socket.get_executor().context() == &ctx);
+
+        std::lock_guard lock {accepted_mutex};
+        ++accepted[&ctx];
+        sockets.push_back(std::move(socket));
+    };
+
+    auto mode = ServerRuntime::AcceptMode::RoundRobin;
+    SECTION("Round-robin from one acceptor") {
+        mode = ServerRuntime::AcceptMode::RoundRobin;
+    }
+    SECTION("An acceptor per io_context with SO_REUSEPORT") {
+        mode = ServerRuntime::AcceptMode::ReusePort;
+    }
+    runtime.listen_tcp(LISTEN_PORT, on_acceptance, mode);
+    runtime.start();
+
+    boost::asio::io_context ctx {};
+    std::vector<tcp::socket> clients {};
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.emplace_back(ctx).connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LISTEN_PORT));
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        std::this_thread::sleep_for(1ms);
+        std::lock_guard lock {accepted_mutex};
+        if (sockets.size() == CLIENTS) break;
+    }
+
+    runtime.stop();
+
+    REQUIRE(sockets.size() == CLIENTS);
+    if (mode == ServerRuntime::AcceptMode::RoundRobin) {
+        // SO_REUSEPORT spreads by hashing the client ports, so only round-robin splits evenly
+        REQUIRE(accepted.size() == 2);
+        for (const auto& [_, count] : accepted) REQUIRE(count == CLIENTS / 2);
+    }
+    sockets.clear();
+}
+
+TEST_CASE("ServerRuntime starts again after stop", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50032};
+
+    ServerRuntime runtime {2};
+    std::atomic<int> accepted {0};
+    const auto on_acceptance = [&accepted](boost::asio::io_context&, tcp::socket&&) { ++accepted; };
+
+    boost::asio::io_context ctx {};
+    for (int run = 1; run <= 2; ++run) {
+        // stop() dropped the listener of the previous run
+        runtime.listen_tcp(LISTEN_PORT, on_acceptance, ServerRuntime::AcceptMode::ReusePort);
+        runtime.start();
+
+        tcp::socket client {ctx};
+        client.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LISTEN_PORT));
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (accepted < run && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(1ms);
+
+        runtime.stop();
+        REQUIRE(accepted == run);
+    }
+}
+
+TEST_CASE("ServerRuntime stops from a handler on its own io_context", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50039};
+
+    ServerRuntime runtime {2};
+    std::atomic<int> accepted {0};
+    const auto on_acceptance = [&accepted](boost::asio::io_context&, tcp::socket&&) { ++accepted; };
+
+    runtime.listen_tcp(LISTEN_PORT, on_acceptance, ServerRuntime::AcceptMode::ReusePort);
+    runtime.start();
+
+    std::promise<void> stopped {};
+    boost::asio::post(runtime.context(1), [&runtime, &stopped] {
+        runtime.stop();
+        stopped.set_value();
+    });
+    REQUIRE(stopped.get_future().wait_for(1s) == std::future_status::ready);
+
+    // Joins the thread that stopped it before running again
+    runtime.listen_tcp(LISTEN_PORT, on_acceptance, ServerRuntime::AcceptMode::ReusePort);
+    runtime.start();
+
+    boost::asio::io_context ctx {};
+    tcp::socket client {ctx};
+    client.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LISTEN_PORT));
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (accepted < 1 && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(1ms);
+    REQUIRE(accepted == 1);
+
+    runtime.stop();
+}
+
+TEST_CASE("ServerRuntime binds a ServerUDP per io_context with SO_REUSEPORT", "[udp server]") {
+    constexpr unsigned short LISTEN_PORT {50015};
+    constexpr int CLIENTS = 8;
+
+    ServerRuntime runtime {2};
+
+    // Sessions by the runtime thread of the socket that received from the client
+    std::mutex sessions_mutex {};
+    std::map<std::thread::id, int> sessions {};
+    std::atomic<int> received {0};
+    runtime.listen_udp(LISTEN_PORT, [&sessions_mutex, &sessions, &received](const std::shared_ptr<SessionUDP>&) {
+        std::lock_guard lock {sessions_mutex};
+        ++sessions[std::this_thread::get_id()];
+        return ServerUDP::PacketHandler {[&received](std::span<const uint8_t>) { ++received; }};
+    });
+    runtime.start();
+
+    boost::asio::io_context ctx {};
+    std::vector<std::unique_ptr<PeerUDP>> clients {};
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.push_back(std::make_unique<PeerUDP>(ctx, udp::endpoint {boost::asio::ip::address_v4::loopback(), 0},
+            [](std::span<const uint8_t>) {}));
+        clients.back()->connect(udp::endpoint {boost::asio::ip::address_v4::loopback(), LISTEN_PORT});
+        clients.back()->open();
+        clients.back()->send_packet(BufferPool::shared().acquire(1));
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (received < CLIENTS && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+
+    runtime.stop();
+    REQUIRE(received == CLIENTS);
+    REQUIRE(!sessions.contains(std::this_thread::get_id()));
+    REQUIRE(std::accumulate(sessions.begin(), sessions.end(), 0,
+        [](const int sum, const auto& entry) { return sum + entry.second; }) == CLIENTS);
+    for (const auto& client : clients) client->close();
+}
+
+TEST_CASE("Peers close after an idle timeout on a TimingWheel", "[tcp server][udp server]") {
+    constexpr auto IDLE_TIMEOUT = 50ms;
+
+    boost::asio::io_context ctx {};
+    TimingWheel wheel {ctx, 5ms};
+    wheel.start();
+
+    flatbuffers::FlatBufferBuilder builder {64};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString("Hello")));
+    const auto message = std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+
+    SECTION("PeerTCP") {
+        constexpr unsigned short LISTEN_PORT {50019};
+
+        std::vector<std::unique_ptr<PeerTCP>> servers;
+        ListenerTCP listener {
+            ctx, LISTEN_PORT,
+            [&servers, &wheel, IDLE_TIMEOUT](boost::asio::io_context& ctx, tcp::socket&& socket) {
+                auto server = std::make_unique<PeerTCP>(ctx, std::move(socket), [](MessageBuffer&&) {});
+                server->set_handler_dispatch(HandlerDispatch::inline_io());
+                server->set_idle_timeout(wheel, IDLE_TIMEOUT);
+                server->run();
+                servers.push_back(std::move(server));
+            }
+        };
+        listener.start();
+
+        PeerTCP active {ctx, tcp::socket {ctx}, {}};
+        PeerTCP idle {ctx, tcp::socket {ctx}, {}};
+        for (PeerTCP* client : {&active, &idle}) {
+            co_spawn(ctx, [client]()->boost::asio::awaitable<void> {
+                co_await client->connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+            }, boost::asio::detached);
+        }
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (servers.size() < 2 && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+        REQUIRE(servers.size() == 2);
+
+        // Only the active client keeps sending, for longer than the timeout
+        for (int i = 0; i < 15; ++i) {
+            active.send_message(message);
+            ctx.run_for(10ms);
+        }
+
+        const auto connected = std::ranges::count_if(servers, [](const auto& server) { return server->is_connected(); });
+        REQUIRE(connected == 1);
+        REQUIRE(wheel.size() == 1);
+
+        ctx.run_for(IDLE_TIMEOUT * 2);
+        REQUIRE(std::ranges::none_of(servers, [](const auto& server) { return server->is_connected(); }));
+
+        listener.stop();
+        active.disconnect();
+        idle.disconnect();
+        servers.clear();
+    }
+
+    SECTION("PeerUDP") {
+        const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50020};
+        const udp::endpoint CLIENT_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50021};
+
+        PeerUDP server {ctx, SERVER_ENDPOINT, [](std::span<const uint8_t>) {}};
+        server.set_handler_dispatch(HandlerDispatch::inline_io());
+        server.set_idle_timeout(wheel, IDLE_TIMEOUT);
+        server.open();
+
+        PeerUDP client {ctx, CLIENT_ENDPOINT, {}};
+        client.connect(SERVER_ENDPOINT);
+        client.open();
+
+        for (int i = 0; i < 15; ++i) {
+            client.send_packet(message);
+            ctx.run_for(10ms);
+        }
+        REQUIRE(server.is_open());
+
+        ctx.run_for(IDLE_TIMEOUT * 2);
+        REQUIRE(!server.is_open());
+        REQUIRE(wheel.size() == 0);
+
+        client.close();
+    }
+
+    wheel.stop();
+}
+
+TEST_CASE("ListenerTCP registers accepted peers in a SessionRegistry", "[tcp server]") {
+    constexpr unsigned short LISTEN_PORT {50022};
+    constexpr int CLIENTS = 3;
+
+    boost::asio::io_context ctx {};
+    SessionRegistry<PeerTCP> registry {};
+    std::vector<SessionHandle> handles {};
+
+    ListenerTCP listener {
+        ctx, LISTEN_PORT,
+        registry.on_acceptance([&handles](boost::asio::io_context& ctx, tcp::socket&& socket, const SessionHandle handle) {
+            auto server = std::make_unique<PeerTCP>(ctx, std::move(socket), [](MessageBuffer&&) {});
+            server->run();
+            handles.push_back(handle);
+            return server;
+        })
+    };
+    listener.start();
+
+    std::atomic<int> received {0};
+    std::vector<std::unique_ptr<PeerTCP>> clients;
+    for (int i = 0; i < CLIENTS; ++i) {
+        clients.push_back(std::make_unique<PeerTCP>(ctx, tcp::socket {ctx}, [&received](MessageBuffer&&) { ++received; }));
+        clients.back()->set_handler_dispatch(HandlerDispatch::inline_io());
+
+        co_spawn(ctx, [client = clients.back().get()]()->boost::asio::awaitable<void> {
+            co_await client->connect(tcp::endpoint(tcp::v4(), LISTEN_PORT));
+            client->run();
+        }, boost::asio::detached);
+    }
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (registry.size() < CLIENTS && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+    REQUIRE(registry.size() == CLIENTS);
+    REQUIRE(std::ranges::all_of(handles, [&registry](const SessionHandle handle) { return registry.contains(handle); }));
+
+    flatbuffers::FlatBufferBuilder builder {64};
+    builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString("Hello")));
+    const auto message = std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+
+    // A tick sending to every session, then a session leaving whose handle goes stale
+    registry.apply_all([&message](PeerTCP& server) { server.send_message(message); });
+    ctx.run_for(50ms);
+    REQUIRE(received == CLIENTS);
+
+    std::unique_ptr<PeerTCP> left = registry.erase(handles[0]);
+    REQUIRE(left != nullptr);
+    left->disconnect();
+    REQUIRE(!registry.apply(handles[0], [](PeerTCP&) { FAIL("Applied to a session that left"); }));
+
+    registry.apply_all([&message](PeerTCP& server) { server.send_message(message); });
+    ctx.run_for(50ms);
+    REQUIRE(received == CLIENTS * 2 - 1);
+
+    listener.stop();
+    for (const auto& client : clients) client->disconnect();
+    registry.apply_all([](PeerTCP& server) { server.disconnect(); });
+}
+
+TEST_CASE("Captured traffic replays to other peers", "[tcp server][udp server]") {
+    constexpr int MESSAGES = 10;
+    const std::string path = (std::filesystem::temp_directory_path() / "sanhok_replay.test").string();
+
+    boost::asio::io_context ctx {};
+    const auto make_hello = [](const int i) {
+        flatbuffers::FlatBufferBuilder builder {64};
+        builder.FinishSizePrefixed(CreateHello(builder, builder.CreateString(std::to_string(i))));
+        return std::make_shared<flatbuffers::DetachedBuffer>(builder.Release());
+    };
+
+    // Received by the servers: TCP messages without their size prefix and UDP packets
+    struct Received {
+        std::vector<std::string> tcp {};
+        std::vector<std::string> udp {};
+    };
+    const auto serve = [&ctx](const unsigned short port, Received& received, CaptureFile* capture,
+        std::vector<std::unique_ptr<PeerTCP>>& tcp_servers) {
+        auto listener = std::make_unique<ListenerTCP>(ctx, port,
+            [&received, &tcp_servers, capture](boost::asio::io_context& ctx, tcp::socket&& socket) {
+                auto server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&received](MessageBuffer&& message) {
+                    received.tcp.push_back(GetHello(message.data())->hello()->str());
+                });
+                server->set_handler_dispatch(HandlerDispatch::inline_io());
+                if (capture) server->set_capture(*capture, 1);
+                server->run();
+                tcp_servers.push_back(std::move(server));
+            });
+        listener->start();
+
+        auto udp_server = std::make_unique<PeerUDP>(ctx, udp::endpoint {boost::asio::ip::address_v4::loopback(), port},
+            [&received](std::span<const uint8_t> packet) {
+                received.udp.push_back(GetSizePrefixedHello(packet.data())->hello()->str());
+            });
+        udp_server->set_handler_dispatch(HandlerDispatch::inline_io());
+        if (capture) udp_server->set_capture(*capture, 2);
+        udp_server->open();
+
+        return std::pair {std::move(listener), std::move(udp_server)};
+    };
+
+    Received captured {};
+    {
+        constexpr unsigned short CAPTURE_PORT {50023};
+
+        CaptureFile capture {};
+        REQUIRE(capture.open(path, 1 << 20));
+        std::vector<std::unique_ptr<PeerTCP>> tcp_servers {};
+        auto [listener, udp_server] = serve(CAPTURE_PORT, captured, &capture, tcp_servers);
+
+        PeerTCP tcp_client {ctx, tcp::socket {ctx}, {}};
+        PeerUDP udp_client {ctx, udp::endpoint {udp::v4(), 0}, {}};
+        udp_client.connect(udp::endpoint {boost::asio::ip::address_v4::loopback(), CAPTURE_PORT});
+        udp_client.open();
+        co_spawn(ctx, [&]()->boost::asio::awaitable<void> {
+            co_await tcp_client.connect(tcp::endpoint(tcp::v4(), CAPTURE_PORT));
+            for (int i = 0; i < MESSAGES; ++i) {
+                tcp_client.send_message(make_hello(i));
+                udp_client.send_packet(make_hello(i));
+            }
+        }, boost::asio::detached);
+        ctx.run_for(100ms);
+
+        listener->stop();
+        tcp_client.disconnect();
+        udp_client.close();
+        udp_server->close();
+        for (const auto& server : tcp_servers) server->disconnect();
+        ctx.run_for(10ms);
+        tcp_servers.clear();
+        udp_server.reset();
+        capture.close();
+    }
+    // Ran out of work with everything closed
+    ctx.restart();
+    REQUIRE(captured.tcp.size() == MESSAGES);
+    REQUIRE(captured.udp.size() == MESSAGES);
+
+    constexpr unsigned short REPLAY_PORT {50024};
+    const auto loopback = boost::asio::ip::address_v4::loopback();
+
+    Received replayed {};
+    std::vector<std::unique_ptr<PeerTCP>> tcp_servers {};
+    auto [listener, udp_server] = serve(REPLAY_PORT, replayed, nullptr, tcp_servers);
+
+    CaptureReader reader {};
+    REQUIRE(reader.open(path));
+    {
+        CaptureReplay replay {ctx, reader, CaptureReplay::Pace::AsFastAsPossible};
+        co_spawn(ctx, replay.replay(tcp::endpoint {loopback, REPLAY_PORT}, udp::endpoint {loopback, REPLAY_PORT}),
+            boost::asio::detached);
+        ctx.run_for(100ms);
+
+        REQUIRE(replay.frames() == MESSAGES * 2);
+        REQUIRE(replay.skipped() == 0);
+    }
+    REQUIRE(replayed.tcp == captured.tcp);
+    REQUIRE(replayed.udp == captured.udp);
+
+    listener->stop();
+    udp_server->close();
+    for (const auto& server : tcp_servers) server->disconnect();
+    reader.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Captured traffic replays at the recorded pace from its first frame", "[udp server]") {
+    constexpr auto IDLE_BEFORE_TRAFFIC = 500ms;
+    constexpr auto FRAME_INTERVAL = 20ms;
+    constexpr int FRAMES = 3;
+    const udp::endpoint SERVER_ENDPOINT {boost::asio::ip::address_v4::loopback(), 50034};
+    const std::string path = (std::filesystem::temp_directory_path() / "sanhok_replay_pace.test").string();
+
+    // The capture sits idle before the first frame, as if opened long before any client came
+    {
+        CaptureFile capture {};
+        REQUIRE(capture.open(path, 1 << 16));
+        std::this_thread::sleep_for(IDLE_BEFORE_TRAFFIC);
+        const std::array<uint8_t, 1> frame {42};
+        for (int i = 0; i < FRAMES; ++i) {
+            capture.append(1, CaptureProtocol::UDP, frame);
+            std::this_thread::sleep_for(FRAME_INTERVAL);
+        }
+        capture.close();
+    }
+
+    boost::asio::io_context ctx {};
+    int received {0};
+    PeerUDP server {ctx, SERVER_ENDPOINT, [&received](std::span<const uint8_t>) { ++received; }};
+    server.set_handler_dispatch(HandlerDispatch::inline_io());
+    server.open();
+
+    CaptureReader reader {};
+    REQUIRE(reader.open(path));
+    {
+        CaptureReplay replay {ctx, reader, CaptureReplay::Pace::Recorded};
+        co_spawn(ctx, replay.replay(tcp::endpoint {}, SERVER_ENDPOINT), boost::asio::detached);
+
+        // Well before the idle time of the capture has passed
+        const auto deadline = std::chrono::steady_clock::now() + IDLE_BEFORE_TRAFFIC / 2;
+        while (received < FRAMES && std::chrono::steady_clock::now() < deadline) ctx.run_for(1ms);
+        REQUIRE(replay.frames() == FRAMES);
+        REQUIRE(received == FRAMES);
+    }
+
+    server.close();
+    reader.close();
+    std::filesystem::remove(path);
 }
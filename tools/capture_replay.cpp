@@ -0,0 +1,156 @@
+// Replays a capture written by PeerTCP/PeerUDP::set_capture
+//
+//   capture_replay <capture> [--as-fast-as-possible] [--tcp host:port] [--udp host:port] [--port port]
+//
+// Without --tcp and --udp the frames go to a loopback ListenerTCP and PeerUDP on --port (47000 by default)
+// whose handlers count what they receive; put the handlers to benchmark in their place.
+
+#include <sanhok/net/capture_replay.hpp>
+#include <sanhok/net/listener_tcp.hpp>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace sanhok;
+using namespace sanhok::net;
+using namespace std::chrono_literals;
+
+namespace {
+// A port from 1 to 65535, the whole text
+std::optional<unsigned short> parse_port(const std::string_view text) {
+    unsigned int port {0};
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), port);
+    if (ec != std::errc {} || end != text.data() + text.size() || port == 0 || port > 65535) return std::nullopt;
+    return static_cast<unsigned short>(port);
+}
+
+template <typename Endpoint>
+std::optional<Endpoint> parse_endpoint(const std::string_view text) {
+    const auto colon = text.rfind(':');
+    if (colon == std::string_view::npos) return std::nullopt;
+
+    boost::system::error_code ec;
+    const auto address = boost::asio::ip::make_address(std::string {text.substr(0, colon)}, ec);
+    if (ec) return std::nullopt;
+    const auto port = parse_port(text.substr(colon + 1));
+    if (!port) return std::nullopt;
+    return Endpoint {address, *port};
+}
+
+int usage() {
+    spdlog::error("Usage: capture_replay <capture> [--as-fast-as-possible] [--tcp host:port] [--udp host:port] "
+        "[--port port], with ports from 1 to 65535");
+    return 1;
+}
+}
+
+int main(const int argc, char* argv[]) {
+    if (argc < 2) return usage();
+
+    const std::string path {argv[1]};
+    auto pace = CaptureReplay::Pace::Recorded;
+    std::optional<tcp::endpoint> tcp_endpoint {};
+    std::optional<udp::endpoint> udp_endpoint {};
+    unsigned short port {47000};
+    for (int i = 2; i < argc; ++i) {
+        const std::string_view arg {argv[i]};
+        if (arg == "--as-fast-as-possible") {
+            pace = CaptureReplay::Pace::AsFastAsPossible;
+        } else if (arg == "--tcp" && i + 1 < argc) {
+            tcp_endpoint = parse_endpoint<tcp::endpoint>(argv[++i]);
+            if (!tcp_endpoint) return usage();
+        } else if (arg == "--udp" && i + 1 < argc) {
+            udp_endpoint = parse_endpoint<udp::endpoint>(argv[++i]);
+            if (!udp_endpoint) return usage();
+        } else if (arg == "--port" && i + 1 < argc) {
+            const auto parsed = parse_port(argv[++i]);
+            if (!parsed) return usage();
+            port = *parsed;
+        } else {
+            return usage();
+        }
+    }
+
+    CaptureReader reader {};
+    if (!reader.open(path)) return 1;
+
+    boost::asio::io_context ctx {};
+
+    // The loopback servers, unless the frames go elsewhere
+    std::atomic<size_t> handled {0};
+    std::vector<std::unique_ptr<PeerTCP>> servers {};
+    std::optional<ListenerTCP> listener {};
+    std::optional<PeerUDP> udp_server {};
+    const bool loopback = !tcp_endpoint && !udp_endpoint;
+    if (loopback) {
+        const auto address = boost::asio::ip::address_v4::loopback();
+        tcp_endpoint = tcp::endpoint {address, port};
+        udp_endpoint = udp::endpoint {address, port};
+
+        listener.emplace(ctx, port, [&servers, &handled](boost::asio::io_context& ctx, tcp::socket&& socket) {
+            auto server = std::make_unique<PeerTCP>(ctx, std::move(socket), [&handled](MessageBuffer&&) { ++handled; });
+            server->set_handler_dispatch(HandlerDispatch::inline_io());
+            server->run();
+            servers.push_back(std::move(server));
+        });
+        listener->start();
+
+        udp_server.emplace(ctx, *udp_endpoint, [&handled](std::span<const uint8_t>) { ++handled; });
+        udp_server->set_handler_dispatch(HandlerDispatch::inline_io());
+        udp_server->open();
+    }
+    if (!tcp_endpoint) tcp_endpoint = tcp::endpoint {boost::asio::ip::address_v4::loopback(), port};
+    if (!udp_endpoint) udp_endpoint = udp::endpoint {boost::asio::ip::address_v4::loopback(), port};
+
+    CaptureReplay replay {ctx, reader, pace};
+    bool replayed {false};
+    bool failed {false};
+    const auto started_at = std::chrono::steady_clock::now();
+    co_spawn(ctx, replay.replay(*tcp_endpoint, *udp_endpoint), [&replayed, &failed](const std::exception_ptr& e) {
+        replayed = true;
+        if (!e) return;
+
+        failed = true;
+        try {
+            std::rethrow_exception(e);
+        } catch (const std::exception& exception) {
+            spdlog::error("Replay failed: {}", exception.what());
+        } catch (...) {
+            spdlog::error("Replay failed");
+        }
+    });
+    while (!replayed) ctx.run_for(10ms);
+
+    // Lets the last frames reach the loopback servers, until they stop coming for 100ms
+    auto finished_at = std::chrono::steady_clock::now();
+    for (size_t last = handled; loopback && last < replay.frames();) {
+        ctx.run_for(1ms);
+        const auto now = std::chrono::steady_clock::now();
+        if (handled != last) {
+            last = handled;
+            finished_at = now;
+        } else if (now - finished_at > 100ms) {
+            break;
+        }
+    }
+    const std::chrono::duration<double> elapsed = finished_at - started_at;
+
+    spdlog::info("Replayed {} frames, {} bytes in {:.3f}s: {:.0f} frames/s, {:.1f} MB/s", replay.frames(),
+        replay.bytes(), elapsed.count(), replay.frames() / elapsed.count(), replay.bytes() / elapsed.count() / 1e6);
+    if (replay.skipped() > 0) spdlog::warn("Skipped {} frames of peers that failed to connect", replay.skipped());
+    // UDP packets sent faster than the server reads them overflow its socket buffer
+    if (loopback) spdlog::info("Loopback servers handled {} of the frames", handled.load());
+
+    if (listener) listener->stop();
+    for (const auto& server : servers) server->disconnect();
+    if (udp_server) udp_server->close();
+    return failed ? 1 : 0;
+}